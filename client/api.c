@@ -4,22 +4,34 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <time.h>
 #include "api.h"
+#include "common/constants.h"
+#include "common/io.h"
+#include "common/trace.h"
 
 #define BUFFER_SIZE 1024
 #define ERROR -1
+#define SETUP_MAX_ATTEMPTS 10
+#define SETUP_BACKOFF_MIN_MS 50
+#define SETUP_BACKOFF_MAX_MS 5000
 
 int session_number = 0;
 int req_fd;
 int res_fd;
 char* req_pipe;
 char* resp_pipe;
+static char pending[BUFFER_SIZE];  // Bytes read from the response pipe past the last reply
+static size_t pending_len = 0;
 
 void send_msg(int tx, char const *str) {
     size_t len = strlen(str);
     size_t written = 0;
 
+    if (tx == req_fd) TRACE_EVENT(TRACE_SEND, (unsigned int)atoi(str), 0);
+
     while (written < len) {
         ssize_t ret = write(tx, str + written, len - written);
         if (ret < 0) {
@@ -66,8 +78,70 @@ void closePipes() {
   }
 }
 
+/// Prints the whole subscription notification lines at the start of what was read past the last reply.
+/// @note A notification may land anywhere between replies, a partial one stays pending for the next read.
+static void strip_notifications() {
+    size_t start = 0;
+
+    while (start < pending_len && (pending[start] == 'N' || pending[start] == 'R')) {
+        char *end = memchr(pending + start, '\n', pending_len - start);
+        if (end == NULL) break;
+
+        size_t line_len = (size_t)(end - (pending + start)) + 1;
+        fwrite(pending + start, 1, line_len, stdout);
+        start += line_len;
+    }
+
+    memmove(pending, pending + start, pending_len - start);
+    pending_len -= start;
+}
+
+/// Reads the next reply line, skipping notifications pushed by subscriptions.
+/// @note Bytes read past the reply stay pending for the next read.
+/// @param rx File descriptor of the response pipe.
+/// @param buffer Buffer of size BUFFER_SIZE to store the reply in.
+/// @return Number of bytes read, 0 on EOF, -1 on error.
+static ssize_t read_reply(int rx, char *buffer) {
+    while (1) {
+        strip_notifications();
+
+        // Replies start with a digit, a leading N or R is a notification still being read
+        int notifying = pending_len > 0 && (pending[0] == 'N' || pending[0] == 'R');
+        char *end = notifying ? NULL : memchr(pending, '\n', pending_len);
+        if (end != NULL || pending_len == BUFFER_SIZE - 1) {
+            size_t len = end != NULL ? (size_t)(end - pending) + 1 : pending_len;
+            memcpy(buffer, pending, len);
+            buffer[len] = 0;
+            memmove(pending, pending + len, pending_len - len);
+            pending_len -= len;
+
+            TRACE_EVENT(TRACE_RECEIVE, 0, (uint64_t)atoi(buffer));
+            return (ssize_t)len;
+        }
+
+        ssize_t ret = read(rx, pending + pending_len, BUFFER_SIZE - 1 - pending_len);
+        if (ret <= 0) return ret;
+        pending_len += (size_t)ret;
+    }
+}
+
+/// Reads raw bytes of a reply, those already read past its first line first.
+/// @param rx File descriptor of the response pipe.
+/// @param buffer Buffer to store the bytes in.
+/// @param size Number of bytes wanted at most.
+/// @return Number of bytes read, 0 on EOF, -1 on error.
+static ssize_t read_body(int rx, char *buffer, size_t size) {
+    if (pending_len == 0) return read(rx, buffer, size);
+
+    size_t len = pending_len < size ? pending_len : size;
+    memcpy(buffer, pending, len);
+    memmove(pending, pending + len, pending_len - len);
+    pending_len -= len;
+    return (ssize_t)len;
+}
+
 void read_msg(int rx, char *buffer) {
-    ssize_t ret = read(rx, buffer, BUFFER_SIZE - 1);
+    ssize_t ret = read_reply(rx, buffer);
 
     if (ret == 0) {
         // ret == 0 indicates EOF
@@ -84,8 +158,48 @@ void read_msg(int rx, char *buffer) {
     fputs(buffer, stdout);
 }
 
+/// Waits for the server to answer a registration.
+/// @param rx Response pipe, opened without blocking.
+/// @param buffer Buffer of size BUFFER_SIZE to store the answer in.
+/// @return Number of bytes read, 0 if the server closed the pipe without answering, -1 on error.
+static ssize_t read_registration(int rx, char *buffer) {
+  struct pollfd pfd = {rx, POLLIN, 0};
+
+  while (1) {
+    int ready = poll(&pfd, 1, -1);
+    if (ready == -1 && errno == EINTR) continue;
+    if (ready == -1) return -1;
+
+    ssize_t ret = read(rx, buffer, BUFFER_SIZE - 1);
+    if (ret == -1 && (errno == EAGAIN || errno == EINTR)) continue;
+    if (ret > 0) buffer[ret] = 0;
+    return ret;
+  }
+}
+
+/// Waits before registering again after the server turned the client away.
+/// @param attempt Number of attempts so far, starting at 0.
+/// @param hint_ms Wait suggested by the server.
+/// @param seed State of the jitter generator.
+static void backoff(unsigned int attempt, unsigned int hint_ms, unsigned int *seed) {
+  unsigned int ms = SETUP_BACKOFF_MIN_MS << (attempt < 16 ? attempt : 16);
+  if (ms < hint_ms) ms = hint_ms;
+  if (ms > SETUP_BACKOFF_MAX_MS) ms = SETUP_BACKOFF_MAX_MS;
+
+  // Full jitter between half and all of the wait, so rejected clients do not come back together
+  ms = ms / 2 + (unsigned int)rand_r(seed) % (ms / 2 + 1);
+
+  struct timespec delay = {ms / 1000, (long)(ms % 1000) * 1000000L};
+  while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {
+  }
+}
+
 int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path) {
-  //TODO: create pipes and connect to the server
+  return ems_setup_priority(req_pipe_path, resp_pipe_path, server_pipe_path, PRIORITY_HIGH);
+}
+
+int ems_setup_priority(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path,
+                       unsigned int priority) {
   req_pipe = req_pipe_path;
   resp_pipe = resp_pipe_path;
 
@@ -102,56 +216,69 @@ int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const*
 
   createPipes();
   
+  char registration[BUFFER_SIZE];
+  snprintf(registration, sizeof(registration), "%s %s %u\n", req_pipe_path, resp_pipe_path, priority);
+
   char buffer[BUFFER_SIZE];
-  strcpy(buffer, req_pipe_path);
-  strcat(buffer, " ");
-  strcat(buffer, resp_pipe_path);
-  strcat(buffer, " \n");
-  send_msg(tx, buffer);
-
-  //Open pipe to receive session id
-  int rx = open(server_pipe, O_RDONLY);
-  if (rx == -1) {
+  unsigned int seed = (unsigned int)getpid() ^ (unsigned int)time(NULL);
+  for (unsigned int attempt = 0;; attempt++) {
+    // The server answers on the response pipe, which must have a reader before it registers
+    res_fd = open(resp_pipe, O_RDONLY | O_NONBLOCK);
+    if (res_fd == -1) {
       fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
+      close(tx);
       return 1;
-  }
-
-  memset(buffer, 0, sizeof(buffer));
-  ssize_t ret = read(rx, buffer, BUFFER_SIZE - 1);
+    }
 
-  if (ret == 0) {
-      // ret == 0 indicates EOF
-      fprintf(stderr, "[INFO]: pipe closed\n");
-      return 1;
-  } else if (ret == -1) {
-      // ret == -1 indicates error
+    send_msg(tx, registration);
+    ssize_t ret = read_registration(res_fd, buffer);
+    if (ret == -1) {
       fprintf(stderr, "[ERR]: read failed: %s\n", strerror(errno));
+      close(res_fd);
+      close(tx);
       return 1;
+    }
+
+    fprintf(stderr, "[INFO]: received %zd B\n", ret);
+    if (ret > 0 && strncmp(buffer, "BUSY|", 5) != 0) break;
+
+    close(res_fd);
+    if (attempt + 1 == SETUP_MAX_ATTEMPTS) {
+      fprintf(stderr, "Server busy, giving up\n");
+      close(tx);
+      return 1;
+    }
+
+    fprintf(stderr, "[INFO]: server busy, retrying\n");
+    backoff(attempt, ret > 0 ? (unsigned int)atoi(buffer + 5) : 0, &seed);
   }
+  close(tx);
 
-  fprintf(stderr, "[INFO]: received %zd B\n", ret);
-  buffer[ret] = 0;
   fputs(buffer, stdout);
-
   session_number = atoi(buffer);
-  close(rx);
 
-  req_fd = open(req_pipe, O_WRONLY);
-  if (req_fd == -1) {
-    fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
+  // Replies are read blocking from here on
+  int flags = fcntl(res_fd, F_GETFL);
+  if (flags == -1 || fcntl(res_fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+    fprintf(stderr, "[ERR]: fcntl failed: %s\n", strerror(errno));
     return 1;
   }
 
-  res_fd = open(resp_pipe, O_RDONLY);
-  if (res_fd == -1) {
+  req_fd = open(req_pipe, O_WRONLY);
+  if (req_fd == -1) {
     fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
     return 1;
   }
 
+  TRACE_EVENT(TRACE_SESSION, 0, (uint64_t)session_number);
   return 0;
 }
 
 int ems_quit(void) { 
+  // Closing the pipes ends the session, freeing the worker for the next client
+  close(req_fd);
+  close(res_fd);
+
   if (unlink(req_pipe) != 0) {
       fprintf(stderr, "[ERR]: unlink failed: %s\n", strerror(errno));
       return 1;
@@ -184,6 +311,84 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   return 0;
 }
 
+int ems_create_template(unsigned int template_id, size_t num_rows, size_t num_cols, size_t num_blocked, size_t* xs,
+                        size_t* ys) {
+  char buffer[BUFFER_SIZE];
+  int len = snprintf(buffer, sizeof(buffer), "9|%u|%zu|%zu|%zu", template_id, num_rows, num_cols, num_blocked);
+
+  for (size_t i = 0; i < num_blocked && len > 0 && (size_t)len < sizeof(buffer); i++) {
+    len += snprintf(buffer + len, sizeof(buffer) - (size_t)len, "|%zu|%zu", xs[i], ys[i]);
+  }
+
+  if (len < 0 || (size_t)len + 1 >= sizeof(buffer)) {
+    fprintf(stderr, "Template request too large\n");
+    return 1;
+  }
+  strcat(buffer, "\n");
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0) {
+    fprintf(stdout, "Template not created\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_create_bulk(unsigned int template_id, unsigned int first_id, size_t count) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "10|%u|%u|%zu\n", template_id, first_id, count);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0) {
+    fprintf(stdout, "Events not created\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_fork(unsigned int event_id, unsigned int new_id) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "11|%u|%u\n", event_id, new_id);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0) {
+    fprintf(stdout, "Event not forked\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_wait(unsigned int delay_ms) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "16|%u\n", delay_ms);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  return atoi(buffer) != 0;
+}
+
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
   //TODO: send reserve request to the server (through the request pipe) and wait for the response (through the response pipe)
   char buffer[BUFFER_SIZE];
@@ -210,6 +415,151 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
   return 0;
 }
 
+int ems_reserve_multi(size_t num_events, const unsigned int* event_ids, const size_t* num_seats, size_t* xs,
+                      size_t* ys, unsigned int* reservation_ids) {
+  char buffer[BUFFER_SIZE];
+  int len = snprintf(buffer, sizeof(buffer), "22|%zu", num_events);
+  for (size_t i = 0, seat = 0; i < num_events && len < (int)sizeof(buffer); i++) {
+    len += snprintf(buffer + len, sizeof(buffer) - (size_t)len, "|%u|%zu", event_ids[i], num_seats[i]);
+    for (size_t j = 0; j < num_seats[i] && len < (int)sizeof(buffer); j++, seat++) {
+      len += snprintf(buffer + len, sizeof(buffer) - (size_t)len, "|%zu|%zu", xs[seat], ys[seat]);
+    }
+  }
+  if (len >= (int)sizeof(buffer) - 1) {
+    fprintf(stderr, "Package too large\n");
+    return 1;
+  }
+  strcat(buffer, "\n");
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  char* cursor = buffer;
+  if (strtol(cursor, &cursor, 10) != 0) {
+    fprintf(stdout, "Package not reserved\n");
+    return 1;
+  }
+
+  for (size_t i = 0; i < num_events; i++) {
+    if (*cursor != '|') {
+      fprintf(stdout, "Package not reserved\n");
+      return 1;
+    }
+    reservation_ids[i] = (unsigned int)strtoul(cursor + 1, &cursor, 10);
+  }
+
+  return 0;
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* row, size_t* col) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "8|%u|%zu\n", event_id, num_seats);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0 || sscanf(buffer, "%*d|%zu|%zu", row, col) != 2) {
+    fprintf(stdout, "Seats not reserved\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_hold(unsigned int event_id, unsigned int ttl_ms, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id) {
+  char buffer[BUFFER_SIZE];
+  int len = snprintf(buffer, sizeof(buffer), "17|%u|%u|%zu", event_id, ttl_ms, num_seats);
+  for (size_t i = 0; i < num_seats && len < (int)sizeof(buffer); i++) {
+    len += snprintf(buffer + len, sizeof(buffer) - (size_t)len, "|%zu|%zu", xs[i], ys[i]);
+  }
+  if (len >= (int)sizeof(buffer) - 1) {
+    fprintf(stderr, "Hold too large\n");
+    return 1;
+  }
+  strcat(buffer, "\n");
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0 || sscanf(buffer, "%*d|%u", hold_id) != 1) {
+    fprintf(stdout, "Seats not held\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/// Sends a request ending a hold or a reservation.
+/// @param code Operation code of the request.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation, holds share their ids with reservations.
+/// @return 0 if the reservation was ended successfully, 1 otherwise.
+static int end_reservation(unsigned int code, unsigned int event_id, unsigned int reservation_id) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "%u|%u|%u\n", code, event_id, reservation_id);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0) {
+    fprintf(stdout, "Reservation not ended\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_confirm(unsigned int event_id, unsigned int hold_id) { return end_reservation(18, event_id, hold_id); }
+
+int ems_release(unsigned int event_id, unsigned int hold_id) { return end_reservation(19, event_id, hold_id); }
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  return end_reservation(21, event_id, reservation_id);
+}
+
+int ems_get_reservation(int out_fd, unsigned int event_id, unsigned int reservation_id) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "20|%u|%u\n", event_id, reservation_id);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  // Reply: "0|<count>|<row>|<col>|<row>|<col>...", printed like the coordinates of a RESERVE
+  char* cursor;
+  if (strtol(buffer, &cursor, 10) != 0 || *cursor != '|') {
+    fprintf(stdout, "Reservation not found\n");
+    return 1;
+  }
+
+  size_t count = strtoul(cursor + 1, &cursor, 10);
+  if (print_str(out_fd, "[")) return 1;
+  for (size_t i = 0; i < count; i++) {
+    unsigned long row = strtoul(cursor + 1, &cursor, 10);
+    unsigned long col = strtoul(cursor + 1, &cursor, 10);
+    if (print_str(out_fd, i == 0 ? "(" : " (") || print_uint(out_fd, (unsigned int)row) || print_str(out_fd, ",") ||
+        print_uint(out_fd, (unsigned int)col) || print_str(out_fd, ")"))
+      return 1;
+  }
+
+  return print_str(out_fd, "]\n");
+}
+
 int ems_show(int out_fd, unsigned int event_id) {
   //TODO: send show request to the server (through the request pipe) and wait for the response (through the response pipe)
    char buffer[BUFFER_SIZE];
@@ -218,7 +568,7 @@ int ems_show(int out_fd, unsigned int event_id) {
   fprintf(stdout, "sent: %s\n", buffer);
 
   memset(buffer, 0, sizeof(buffer));
-  ssize_t command = read(res_fd, buffer, BUFFER_SIZE - 1);
+  ssize_t command = read_reply(res_fd, buffer);
   if (command == 0) {
       fprintf(stderr, "[INFO]: pipe closed\n");
       return 1;
@@ -244,7 +594,7 @@ int ems_list_events(int out_fd) {
   fprintf(stdout, "sent: %s\n", buffer);
 
    memset(buffer, 0, sizeof(buffer));
-  ssize_t command = read(res_fd, buffer, BUFFER_SIZE - 1);
+  ssize_t command = read_reply(res_fd, buffer);
   if (command == 0) {
       fprintf(stderr, "[INFO]: pipe closed\n");
       return 1;
@@ -261,3 +611,132 @@ int ems_list_events(int out_fd) {
   }
   return 0;
 }
+
+int ems_list_events_page(int out_fd, const unsigned int* after_id, size_t limit, size_t min_free, size_t min_capacity,
+                         unsigned int* next_id, int* more) {
+  char buffer[BUFFER_SIZE];
+  char cursor[16] = "-";
+  if (after_id != NULL) snprintf(cursor, sizeof(cursor), "%u", *after_id);
+  snprintf(buffer, sizeof(buffer), "12|%s|%zu|%zu|%zu\n", cursor, limit, min_free, min_capacity);
+  send_msg(req_fd, buffer);
+  fprintf(stdout, "sent: %s\n", buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  ssize_t command = read_reply(res_fd, buffer);
+  if (command == 0) {
+      fprintf(stderr, "[INFO]: pipe closed\n");
+      return 1;
+  } else if (command == -1) {
+      fprintf(stderr, "[ERR]: read failed: %s\n", strerror(errno));
+      return 1;
+  }
+
+  if (atoi(buffer) != 0) {
+    fprintf(stdout, "Events not listed\n");
+    return 1;
+  }
+
+  // Reply: "0|count|id id ... |cursor", the cursor being "-" after the last page
+  char* last = strrchr(buffer, '|');
+  *more = last != NULL && last[1] != '-';
+  if (*more) *next_id = (unsigned int)strtoul(last + 1, NULL, 10);
+
+  ssize_t ret = write(out_fd, buffer, strlen(buffer));
+  if (ret < 0) {
+    fprintf(stderr, "[ERR]: write failed: %s\n", strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+int ems_availability(unsigned int event_id, size_t row, size_t* free_seats, size_t* capacity) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "13|%u|%zu\n", event_id, row);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0 || sscanf(buffer, "%*d|%zu|%zu", free_seats, capacity) != 2) {
+    fprintf(stdout, "Availability not read\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_sold_out(unsigned int event_id, int* sold_out) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "14|%u\n", event_id);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0 || sscanf(buffer, "%*d|%d", sold_out) != 1) {
+    fprintf(stdout, "Availability not read\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_stats(int out_fd) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "15\n");
+  send_msg(req_fd, buffer);
+  fprintf(stdout, "sent: %s\n", buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  ssize_t command = read_reply(res_fd, buffer);
+  if (command <= 0) {
+      fprintf(stderr, "[ERR]: read failed: %s\n", command == 0 ? "pipe closed" : strerror(errno));
+      return 1;
+  }
+
+  // Reply: "0|<length>\n" followed by length bytes of stats, possibly across several reads. The server writes it
+  // whole, so no notification lands inside the table
+  size_t length;
+  if (atoi(buffer) != 0 || sscanf(buffer, "%*d|%zu", &length) != 1) {
+    fprintf(stdout, "Stats not read\n");
+    return 1;
+  }
+
+  while (length > 0) {
+    command = read_body(res_fd, buffer, length < sizeof(buffer) ? length : sizeof(buffer));
+    if (command <= 0) {
+      fprintf(stderr, "[ERR]: read failed: %s\n", command == 0 ? "pipe closed" : strerror(errno));
+      return 1;
+    }
+
+    if (write(out_fd, buffer, (size_t)command) < 0) {
+      fprintf(stderr, "[ERR]: write failed: %s\n", strerror(errno));
+      return 1;
+    }
+    length -= (size_t)command;
+  }
+
+  return 0;
+}
+
+int ems_subscribe(unsigned int event_id) {
+  char buffer[BUFFER_SIZE];
+  snprintf(buffer, sizeof(buffer), "7|%u\n", event_id);
+
+  fprintf(stdout, "sent: %s\n", buffer);
+  send_msg(req_fd, buffer);
+
+  memset(buffer, 0, sizeof(buffer));
+  read_msg(res_fd, buffer);
+
+  if (atoi(buffer) != 0) {
+    fprintf(stdout, "Not subscribed\n");
+    return 1;
+  }
+
+  return 0;
+}
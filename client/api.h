@@ -10,6 +10,15 @@
 /// @return 0 if the connection was established successfully, 1 otherwise.
 int ems_setup(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path);
 
+/// Connects to an EMS server with a priority for the requests of the session.
+/// @param req_pipe_path Path to the name pipe to be created for requests.
+/// @param resp_pipe_path Path to the name pipe to be created for responses.
+/// @param server_pipe_path Path to the name pipe where the server is listening.
+/// @param priority Highest priority the requests may run at, from PRIORITY_HIGH (the ems_setup default) to PRIORITY_LOW.
+/// @return 0 if the connection was established successfully, 1 otherwise.
+int ems_setup_priority(char const* req_pipe_path, char const* resp_pipe_path, char const* server_pipe_path,
+                       unsigned int priority);
+
 /// Disconnects from an EMS server.
 /// @return 0 in case of success, 1 otherwise.
 int ems_quit(void);
@@ -21,6 +30,36 @@ int ems_quit(void);
 /// @return 0 if the event was created successfully, 1 otherwise.
 int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 
+/// Creates a venue template that events can be created from.
+/// @param template_id Id of the template to be created.
+/// @param num_rows Number of rows of the venue.
+/// @param num_cols Number of columns of the venue.
+/// @param num_blocked Number of seats blocked in every event created from the template.
+/// @param xs Array of rows of the blocked seats.
+/// @param ys Array of columns of the blocked seats.
+/// @return 0 if the template was created successfully, 1 otherwise.
+int ems_create_template(unsigned int template_id, size_t num_rows, size_t num_cols, size_t num_blocked, size_t* xs,
+                        size_t* ys);
+
+/// Creates the events first_id .. first_id + count - 1 from a template in a single request.
+/// @param template_id Id of the template the events are created from.
+/// @param first_id Id of the first event to be created.
+/// @param count Number of events to be created.
+/// @return 0 if the events were created successfully, 1 otherwise.
+int ems_create_bulk(unsigned int template_id, unsigned int first_id, size_t count);
+
+/// Clones an event into a new event id that evolves independently from then on.
+/// @param event_id Id of the event to be cloned.
+/// @param new_id Id of the clone.
+/// @return 0 if the clone was created successfully, 1 otherwise.
+int ems_fork(unsigned int event_id, unsigned int new_id);
+
+/// Pauses the request stream of the session on the server.
+/// @note The server holds no worker while it waits, the reply comes once the delay expired.
+/// @param delay_ms Delay in milliseconds.
+/// @return 0 once the delay expired, 1 otherwise.
+int ems_wait(unsigned int delay_ms);
+
 /// Creates a new reservation for the given event.
 /// @param event_id Id of the event to create a reservation for.
 /// @param num_seats Number of seats to reserve.
@@ -29,6 +68,62 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
+/// Reserves seats in several events at once, all or none of them.
+/// @param num_events Number of events, at most MAX_PACKAGE_EVENTS, each listed once.
+/// @param event_ids Array of the ids of the events.
+/// @param num_seats Array of the number of seats to reserve in each event.
+/// @param xs Array of rows of the seats to reserve, those of each event after those of the previous one.
+/// @param ys Array of columns of the seats to reserve, in the same order.
+/// @param reservation_ids Array to store the id of the reservation in each event in.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_events, const unsigned int* event_ids, const size_t* num_seats, size_t* xs,
+                      size_t* ys, unsigned int* reservation_ids);
+
+/// Reserves the best block of contiguous free seats in a single row.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param row Pointer to the variable to store the row of the block in.
+/// @param col Pointer to the variable to store the first column of the block in.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* row, size_t* col);
+
+/// Holds seats of an event for a limited time, to be confirmed or released.
+/// @note Held seats conflict with reservations until the hold ends or expires.
+/// @param event_id Id of the event to hold seats of.
+/// @param ttl_ms Milliseconds until the hold expires.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param hold_id Pointer to the variable to store the id of the hold in.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int ttl_ms, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id);
+
+/// Turns a hold into a reservation with the same id, if it did not expire.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return 0 if the hold was confirmed successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int hold_id);
+
+/// Frees the seats of a hold.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return 0 if the hold was released successfully, 1 otherwise.
+int ems_release(unsigned int event_id, unsigned int hold_id);
+
+/// Prints the seats of a reservation to the given file, as "[(<x1>,<y1>) ...]".
+/// @param out_fd File descriptor to print the seats to.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the reservation was printed successfully, 1 otherwise.
+int ems_get_reservation(int out_fd, unsigned int event_id, unsigned int reservation_id);
+
+/// Cancels a reservation, freeing its seats.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
 /// Prints the given event to the given file.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
@@ -40,4 +135,42 @@ int ems_show(int out_fd, unsigned int event_id);
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int out_fd);
 
+/// Prints a page of the events matching the given filters to the given file.
+/// @param out_fd File descriptor to print the page to.
+/// @param after_id Only events with a larger id are listed, NULL to start from the first one.
+/// @param limit Maximum number of events in the page.
+/// @param min_free Only events with at least this many free seats are listed.
+/// @param min_capacity Only events with at least this many seats are listed.
+/// @param next_id Pointer to the variable to store the cursor of the next page in.
+/// @param more Pointer to the variable set to 1 if there are more pages, 0 otherwise.
+/// @return 0 if the page was printed successfully, 1 otherwise.
+int ems_list_events_page(int out_fd, const unsigned int* after_id, size_t limit, size_t min_free, size_t min_capacity,
+                         unsigned int* next_id, int* more);
+
+/// Gets the number of free seats of an event or of one of its rows.
+/// @param event_id Id of the event.
+/// @param row Row to be queried, starting at 1, or 0 for the whole event.
+/// @param free_seats Pointer to the variable to store the number of free seats in.
+/// @param capacity Pointer to the variable to store the number of seats in.
+/// @return 0 if the availability was read successfully, 1 otherwise.
+int ems_availability(unsigned int event_id, size_t row, size_t* free_seats, size_t* capacity);
+
+/// Checks whether every seat of an event is taken.
+/// @param event_id Id of the event.
+/// @param sold_out Pointer to the variable set to 1 if the event is sold out, 0 otherwise.
+/// @return 0 if the event was checked successfully, 1 otherwise.
+int ems_sold_out(unsigned int event_id, int* sold_out);
+
+/// Prints the request latency stats of the server.
+/// @param out_fd File descriptor to print the stats to.
+/// @return 0 if the stats were printed successfully, 1 otherwise.
+int ems_stats(int out_fd);
+
+/// Subscribes the session to the reservations of the given event.
+/// @note Notifications ("N|event|reservation|seats" and "R" for a resync) are
+///       interleaved with the replies and printed to stdout as they arrive.
+/// @param event_id Id of the event to subscribe to.
+/// @return 0 if the subscription was created successfully, 1 otherwise.
+int ems_subscribe(unsigned int event_id);
+
 #endif  // CLIENT_API_H
@@ -1,20 +1,35 @@
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "api.h"
 #include "common/constants.h"
+#include "common/io.h"
 #include "parser.h"
 
 int main(int argc, char* argv[]) {
-  if (argc < 5) {
-    fprintf(stderr, "Usage: %s <request pipe path> <response pipe path> <server pipe path> <.jobs file path>\n",
+  if (argc < 5 || argc > 6) {
+    fprintf(stderr,
+            "Usage: %s <request pipe path> <response pipe path> <server pipe path> <.jobs file path> [priority]\n"
+            "  priority: 0 (interactive, default), 1 (reporting) or 2 (batch)\n",
             argv[0]);
     return 1;
   }
 
-  if (ems_setup(argv[1], argv[2], argv[3])) {
+  unsigned int priority = PRIORITY_HIGH;
+  if (argc == 6) {
+    char* endptr;
+    unsigned long value = strtoul(argv[5], &endptr, 10);
+    if (*endptr != '\0' || value >= NUM_PRIORITIES) {
+      fprintf(stderr, "Invalid priority: %s\n", argv[5]);
+      return 1;
+    }
+    priority = (unsigned int)value;
+  }
+
+  if (ems_setup_priority(argv[1], argv[2], argv[3], priority)) {
     fprintf(stderr, "Failed to set up EMS\n");
     return 1;
   }
@@ -43,10 +58,12 @@ int main(int argc, char* argv[]) {
   }
 
   while (1) {
-    unsigned int event_id;
+    unsigned int event_id, new_id;
     size_t num_rows, num_columns, num_coords;
     unsigned int delay = 0;
     size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    unsigned int event_ids[MAX_PACKAGE_EVENTS], reservation_ids[MAX_PACKAGE_EVENTS];
+    size_t num_events, num_seats[MAX_PACKAGE_EVENTS];
 
     switch (get_next(in_fd)) {
       case CMD_CREATE:
@@ -58,6 +75,34 @@ int main(int argc, char* argv[]) {
         if (ems_create(event_id, num_rows, num_columns)) fprintf(stderr, "Failed to create event\n");
         break;
 
+      case CMD_TEMPLATE:
+        if (parse_template(in_fd, MAX_RESERVATION_SIZE, &event_id, &num_rows, &num_columns, &num_coords, xs, ys) != 0) {
+          fprintf(stderr, "(template) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_create_template(event_id, num_rows, num_columns, num_coords, xs, ys))
+          fprintf(stderr, "Failed to create template\n");
+        break;
+
+      case CMD_CREATE_BULK:
+        if (parse_create(in_fd, &event_id, &num_rows, &num_columns) != 0) {
+          fprintf(stderr, "(create_bulk) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_create_bulk(event_id, (unsigned int)num_rows, num_columns)) fprintf(stderr, "Failed to create events\n");
+        break;
+
+      case CMD_FORK:
+        if (parse_fork(in_fd, &event_id, &new_id) != 0) {
+          fprintf(stderr, "(fork) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_fork(event_id, new_id)) fprintf(stderr, "Failed to fork event\n");
+        break;
+
       case CMD_RESERVE:
         num_coords = parse_reserve(in_fd, MAX_RESERVATION_SIZE, &event_id, xs, ys);
 
@@ -69,6 +114,89 @@ int main(int argc, char* argv[]) {
         if (ems_reserve(event_id, num_coords, xs, ys)) fprintf(stderr, "Failed to reserve seats\n");
         break;
 
+      case CMD_RESERVE_BEST:
+        if (parse_reserve_best(in_fd, &event_id, &num_coords) != 0) {
+          fprintf(stderr, "(reserve_best) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_best(event_id, num_coords, &num_rows, &num_columns))
+          fprintf(stderr, "Failed to reserve seats\n");
+        break;
+
+      case CMD_RESERVE_MULTI:
+        num_events = parse_reserve_multi(in_fd, MAX_PACKAGE_EVENTS, MAX_RESERVATION_SIZE, event_ids, num_seats, xs, ys);
+
+        if (num_events == 0) {
+          fprintf(stderr, "(reserve_multi) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_multi(num_events, event_ids, num_seats, xs, ys, reservation_ids)) {
+          fprintf(stderr, "Failed to reserve package\n");
+          break;
+        }
+
+        int failed = print_str(out_fd, "Package");
+        for (size_t i = 0; i < num_events && !failed; i++) {
+          failed = print_str(out_fd, " ") || print_uint(out_fd, reservation_ids[i]);
+        }
+        if (failed || print_str(out_fd, "\n")) fprintf(stderr, "Failed to write package\n");
+        break;
+
+      case CMD_HOLD:
+        num_coords = parse_hold(in_fd, MAX_RESERVATION_SIZE, &event_id, &delay, xs, ys);
+
+        if (num_coords == 0) {
+          fprintf(stderr, "(hold) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_hold(event_id, delay, num_coords, xs, ys, &new_id)) {
+          fprintf(stderr, "Failed to hold seats\n");
+          break;
+        }
+
+        if (print_str(out_fd, "Hold ") || print_uint(out_fd, new_id) || print_str(out_fd, "\n"))
+          fprintf(stderr, "Failed to write hold\n");
+        break;
+
+      case CMD_CONFIRM:
+        if (parse_reservation_id(in_fd, &event_id, &new_id) != 0) {
+          fprintf(stderr, "(confirm) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_confirm(event_id, new_id)) fprintf(stderr, "Failed to confirm hold\n");
+        break;
+
+      case CMD_RELEASE:
+        if (parse_reservation_id(in_fd, &event_id, &new_id) != 0) {
+          fprintf(stderr, "(release) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_release(event_id, new_id)) fprintf(stderr, "Failed to release hold\n");
+        break;
+
+      case CMD_GET_RESERVATION:
+        if (parse_reservation_id(in_fd, &event_id, &new_id) != 0) {
+          fprintf(stderr, "(get_reservation) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_get_reservation(out_fd, event_id, new_id)) fprintf(stderr, "Failed to get reservation\n");
+        break;
+
+      case CMD_CANCEL:
+        if (parse_reservation_id(in_fd, &event_id, &new_id) != 0) {
+          fprintf(stderr, "(cancel) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_cancel(event_id, new_id)) fprintf(stderr, "Failed to cancel reservation\n");
+        break;
+
       case CMD_SHOW:
         if (parse_show(in_fd, &event_id) != 0) {
           fprintf(stderr, "(show) Invalid command. See HELP for usage\n");
@@ -78,10 +206,69 @@ int main(int argc, char* argv[]) {
         if (ems_show(out_fd, event_id)) fprintf(stderr, "Failed to show event\n");
         break;
 
+      case CMD_SUBSCRIBE:
+        if (parse_subscribe(in_fd, &event_id) != 0) {
+          fprintf(stderr, "(subscribe) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_subscribe(event_id)) fprintf(stderr, "Failed to subscribe to event\n");
+        break;
+
+      case CMD_AVAILABILITY:
+        if (parse_availability(in_fd, &event_id, &num_rows) != 0) {
+          fprintf(stderr, "(availability) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_availability(event_id, num_rows, &num_coords, &num_columns)) {
+          fprintf(stderr, "Failed to get availability\n");
+          break;
+        }
+
+        if (print_uint(out_fd, (unsigned int)num_coords) || print_str(out_fd, "/") ||
+            print_uint(out_fd, (unsigned int)num_columns) || print_str(out_fd, "\n"))
+          fprintf(stderr, "Failed to write availability\n");
+        break;
+
+      case CMD_SOLD_OUT:
+        if (parse_show(in_fd, &event_id) != 0) {
+          fprintf(stderr, "(sold_out) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        int sold_out;
+        if (ems_sold_out(event_id, &sold_out)) {
+          fprintf(stderr, "Failed to get availability\n");
+          break;
+        }
+
+        if (print_str(out_fd, sold_out ? "Sold out\n" : "Available\n")) fprintf(stderr, "Failed to write availability\n");
+        break;
+
+      case CMD_STATS:
+        if (ems_stats(out_fd)) fprintf(stderr, "Failed to get stats\n");
+        break;
+
       case CMD_LIST_EVENTS:
         if (ems_list_events(out_fd)) fprintf(stderr, "Failed to list events\n");
         break;
 
+      case CMD_LIST_PAGE:
+        if (parse_list_page(in_fd, &num_coords, &num_rows, &num_columns) != 0) {
+          fprintf(stderr, "(list_page) Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        // Walks every page of the filtered listing
+        for (int more = 1, first = 1; more; first = 0) {
+          if (ems_list_events_page(out_fd, first ? NULL : &new_id, num_coords, num_rows, num_columns, &new_id, &more)) {
+            fprintf(stderr, "Failed to list events\n");
+            break;
+          }
+        }
+        break;
+
       case CMD_WAIT:
         if (parse_wait(in_fd, &delay, NULL) == -1) {
             fprintf(stderr, "(wait) Invalid command. See HELP for usage\n");
@@ -90,7 +277,7 @@ int main(int argc, char* argv[]) {
 
         if (delay > 0) {
             printf("Waiting...\n");
-            sleep(delay);
+            if (ems_wait(delay)) fprintf(stderr, "Failed to wait\n");
         }
         break;
 
@@ -102,11 +289,27 @@ int main(int argc, char* argv[]) {
         printf(
             "Available commands:\n"
             "  CREATE <event_id> <num_rows> <num_columns>\n"
+            "  TEMPLATE <template_id> <num_rows> <num_columns> [(<x1>,<y1>) ...]\n"
+            "  CREATE_BULK <template_id> <first_event_id> <num_events>  (at most %d events)\n"
             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  FORK <event_id> <new_event_id>\n"
+            "  RESERVE_BEST <event_id> <num_seats>\n"
+            "  RESERVE_MULTI <event_id> [(<x1>,<y1>) ...] <event_id> [(<x1>,<y1>) ...] ...\n"
+            "  HOLD <event_id> <ttl_ms> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  CONFIRM <event_id> <hold_id>\n"
+            "  RELEASE <event_id> <hold_id>\n"
+            "  GET_RESERVATION <event_id> <reservation_id>\n"
+            "  CANCEL <event_id> <reservation_id>\n"
             "  SHOW <event_id>\n"
+            "  AVAILABILITY <event_id> [row]\n"
+            "  SOLD_OUT <event_id>\n"
             "  LIST\n"
+            "  LIST_PAGE <page_size> <min_free_seats> <min_capacity>\n"
             "  WAIT <delay_ms>\n"
-            "  HELP\n");
+            "  SUBSCRIBE <event_id>\n"
+            "  STATS\n"
+            "  HELP\n",
+            MAX_BULK_EVENTS);
 
         break;
 
@@ -21,16 +21,94 @@ enum Command get_next(int fd) {
   }
 
   switch (buf[0]) {
+    case 'A':
+      if (read(fd, buf + 1, 12) != 12 || strncmp(buf, "AVAILABILITY ", 13) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_AVAILABILITY;
+
     case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
+      if (read(fd, buf + 1, 6) != 6) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "CREATE_", 7) == 0) {
+        if (read(fd, buf + 7, 5) != 5 || strncmp(buf, "CREATE_BULK ", 12) != 0) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_CREATE_BULK;
+      }
+
+      if (strncmp(buf, "CANCEL ", 7) == 0) {
+        return CMD_CANCEL;
+      }
+
+      if (strncmp(buf, "CONFIRM", 7) == 0) {
+        if (read(fd, buf + 7, 1) != 1 || buf[7] != ' ') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_CONFIRM;
+      }
+
+      if (strncmp(buf, "CREATE ", 7) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
       return CMD_CREATE;
 
+    case 'T':
+      if (read(fd, buf + 1, 8) != 8 || strncmp(buf, "TEMPLATE ", 9) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_TEMPLATE;
+
+    case 'F':
+      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "FORK ", 5) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_FORK;
+
     case 'R':
-      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
+      if (read(fd, buf + 1, 7) != 7) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "RESERVE_", 8) == 0) {
+        if (read(fd, buf + 8, 5) != 5) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        if (strncmp(buf, "RESERVE_BEST ", 13) == 0) {
+          return CMD_RESERVE_BEST;
+        }
+
+        if (strncmp(buf, "RESERVE_MULTI", 13) != 0 || read(fd, buf + 13, 1) != 1 || buf[13] != ' ') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_RESERVE_MULTI;
+      }
+
+      if (strncmp(buf, "RELEASE ", 8) == 0) {
+        return CMD_RELEASE;
+      }
+
+      if (strncmp(buf, "RESERVE ", 8) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
@@ -38,7 +116,39 @@ enum Command get_next(int fd) {
       return CMD_RESERVE;
 
     case 'S':
-      if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
+      if (read(fd, buf + 1, 4) != 4) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "SOLD_", 5) == 0) {
+        if (read(fd, buf + 5, 4) != 4 || strncmp(buf, "SOLD_OUT ", 9) != 0) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_SOLD_OUT;
+      }
+
+      if (strncmp(buf, "SUBSC", 5) == 0) {
+        if (read(fd, buf + 5, 5) != 5 || strncmp(buf, "SUBSCRIBE ", 10) != 0) {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_SUBSCRIBE;
+      }
+
+      if (strncmp(buf, "STATS", 5) == 0) {
+        if (read(fd, buf + 5, 1) != 0 && buf[5] != '\n') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_STATS;
+      }
+
+      if (strncmp(buf, "SHOW ", 5) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
@@ -52,12 +162,24 @@ enum Command get_next(int fd) {
       }
 
       if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
+        if (buf[4] == '_' && read(fd, buf + 5, 5) == 5 && strncmp(buf, "LIST_PAGE ", 10) == 0) {
+          return CMD_LIST_PAGE;
+        }
+
         cleanup(fd);
         return CMD_INVALID;
       }
 
       return CMD_LIST_EVENTS;
 
+    case 'G':
+      if (read(fd, buf + 1, 15) != 15 || strncmp(buf, "GET_RESERVATION ", 16) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_GET_RESERVATION;
+
     case 'W':
       if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "WAIT ", 5) != 0) {
         cleanup(fd);
@@ -67,7 +189,21 @@ enum Command get_next(int fd) {
       return CMD_WAIT;
 
     case 'H':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
+      if (read(fd, buf + 1, 3) != 3) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "HOLD", 4) == 0) {
+        if (read(fd, buf + 4, 1) != 1 || buf[4] != ' ') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_HOLD;
+      }
+
+      if (strncmp(buf, "HELP", 4) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
@@ -117,14 +253,32 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+int parse_fork(int fd, unsigned int *event_id, unsigned int *new_id) {
   char ch;
 
   if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
     cleanup(fd);
-    return 0;
+    return 1;
   }
 
+  if (parse_uint(fd, new_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
+/// Parses a list of coordinates "[(<x1>,<y1>) (<x2>,<y2>) ...]" and the character after it.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @param next Pointer to the variable to store the character after the list in.
+/// @return Number of coordinates read. 0 on failure.
+static size_t parse_coord_list(int fd, size_t max, size_t *xs, size_t *ys, char *next) {
+  char ch;
+
   if (read(fd, &ch, 1) != 1 || ch != '[') {
     cleanup(fd);
     return 0;
@@ -168,7 +322,7 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
     return 0;
   }
 
-  if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+  if (read(fd, next, 1) != 1) {
     cleanup(fd);
     return 0;
   }
@@ -176,6 +330,149 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   return num_coords;
 }
 
+/// Parses a list of coordinates "[(<x1>,<y1>) (<x2>,<y2>) ...]" up to the end of the line.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @return Number of coordinates read. 0 on failure.
+static size_t parse_coords(int fd, size_t max, size_t *xs, size_t *ys) {
+  char ch;
+
+  size_t num_coords = parse_coord_list(fd, max, xs, ys, &ch);
+  if (num_coords == 0) return 0;
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_coords;
+}
+
+size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return parse_coords(fd, max, xs, ys);
+}
+
+size_t parse_reserve_multi(int fd, size_t max_events, size_t max_seats, unsigned int *event_ids, size_t *num_seats,
+                           size_t *xs, size_t *ys) {
+  char ch = ' ';
+  size_t num_events = 0, total = 0;
+
+  while (ch == ' ') {
+    if (num_events == max_events) {
+      cleanup(fd);
+      return 0;
+    }
+
+    if (parse_uint(fd, &event_ids[num_events], &ch) != 0 || ch != ' ') {
+      cleanup(fd);
+      return 0;
+    }
+
+    num_seats[num_events] = parse_coord_list(fd, max_seats - total, xs + total, ys + total, &ch);
+    if (num_seats[num_events] == 0) return 0;
+
+    total += num_seats[num_events++];
+  }
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_events;
+}
+
+int parse_template(int fd, size_t max, unsigned int *template_id, size_t *num_rows, size_t *num_cols,
+                   size_t *num_blocked, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, template_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  unsigned int u_num_rows;
+  if (parse_uint(fd, &u_num_rows, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+  *num_rows = (size_t)u_num_rows;
+
+  unsigned int u_num_cols;
+  if (parse_uint(fd, &u_num_cols, &ch) != 0 || (ch != ' ' && ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+  *num_cols = (size_t)u_num_cols;
+
+  *num_blocked = 0;
+  if (ch == ' ') {
+    *num_blocked = parse_coords(fd, max, xs, ys);
+    if (*num_blocked == 0) return 1;
+  }
+
+  return 0;
+}
+
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  unsigned int u_num_seats;
+  if (parse_uint(fd, &u_num_seats, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+  *num_seats = (size_t)u_num_seats;
+
+  return 0;
+}
+
+size_t parse_hold(int fd, size_t max, unsigned int *event_id, unsigned int *ttl_ms, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  if (parse_uint(fd, ttl_ms, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return parse_coords(fd, max, xs, ys);
+}
+
+int parse_reservation_id(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  if (parse_uint(fd, reservation_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
 int parse_show(int fd, unsigned int *event_id) {
   char ch;
 
@@ -187,6 +484,54 @@ int parse_show(int fd, unsigned int *event_id) {
   return 0;
 }
 
+int parse_availability(int fd, unsigned int *event_id, size_t *row) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || (ch != ' ' && ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  *row = 0;
+  if (ch == ' ') {
+    unsigned int u_row;
+    if (parse_uint(fd, &u_row, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+      cleanup(fd);
+      return 1;
+    }
+    *row = (size_t)u_row;
+  }
+
+  return 0;
+}
+
+int parse_subscribe(int fd, unsigned int *event_id) { return parse_show(fd, event_id); }
+
+int parse_list_page(int fd, size_t *limit, size_t *min_free, size_t *min_capacity) {
+  char ch;
+  unsigned int value;
+
+  if (parse_uint(fd, &value, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+  *limit = (size_t)value;
+
+  if (parse_uint(fd, &value, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+  *min_free = (size_t)value;
+
+  if (parse_uint(fd, &value, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+  *min_capacity = (size_t)value;
+
+  return 0;
+}
+
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
   char ch;
 
@@ -5,10 +5,25 @@
 
 enum Command {
   CMD_CREATE,
+  CMD_CREATE_BULK,
+  CMD_TEMPLATE,
+  CMD_FORK,
   CMD_RESERVE,
+  CMD_RESERVE_BEST,
+  CMD_RESERVE_MULTI,
+  CMD_HOLD,
+  CMD_CONFIRM,
+  CMD_RELEASE,
+  CMD_GET_RESERVATION,
+  CMD_CANCEL,
   CMD_SHOW,
+  CMD_AVAILABILITY,
+  CMD_SOLD_OUT,
   CMD_LIST_EVENTS,
+  CMD_LIST_PAGE,
   CMD_WAIT,
+  CMD_SUBSCRIBE,
+  CMD_STATS,
   CMD_HELP,
   CMD_EMPTY,
   CMD_INVALID,
@@ -28,6 +43,26 @@ enum Command get_next(int fd);
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
 
+/// Parses a TEMPLATE command.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of blocked seats to read.
+/// @param template_id Pointer to the variable to store the template ID in.
+/// @param num_rows Pointer to the variable to store the number of rows in.
+/// @param num_cols Pointer to the variable to store the number of columns in.
+/// @param num_blocked Pointer to the variable to store the number of blocked seats in.
+/// @param xs Pointer to the array to store the X coordinates of the blocked seats in.
+/// @param ys Pointer to the array to store the Y coordinates of the blocked seats in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_template(int fd, size_t max, unsigned int *template_id, size_t *num_rows, size_t *num_cols,
+                   size_t *num_blocked, size_t *xs, size_t *ys);
+
+/// Parses a FORK command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the ID of the event to be cloned in.
+/// @param new_id Pointer to the variable to store the ID of the clone in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_fork(int fd, unsigned int *event_id, unsigned int *new_id);
+
 /// Parses a RESERVE command.
 /// @param fd File descriptor to read from.
 /// @param max Maximum number of coordinates to read.
@@ -37,12 +72,69 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
 /// @return Number of coordinates read. 0 on failure.
 size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
 
+/// Parses a RESERVE_MULTI command, "<event_id> [(<x1>,<y1>) ...] <event_id> [(<x1>,<y1>) ...] ...".
+/// @param fd File descriptor to read from.
+/// @param max_events Maximum number of events to read.
+/// @param max_seats Maximum number of coordinates to read, across every event.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @param num_seats Pointer to the array to store the number of coordinates of each event in.
+/// @param xs Pointer to the array to store the X coordinates in, those of each event after the previous ones.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @return Number of events read. 0 on failure.
+size_t parse_reserve_multi(int fd, size_t max_events, size_t max_seats, unsigned int *event_ids, size_t *num_seats,
+                           size_t *xs, size_t *ys);
+
+/// Parses a RESERVE_BEST command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param num_seats Pointer to the variable to store the number of seats in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats);
+
+/// Parses a HOLD command.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param ttl_ms Pointer to the variable to store the duration of the hold in.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @return Number of coordinates read. 0 on failure.
+size_t parse_hold(int fd, size_t max, unsigned int *event_id, unsigned int *ttl_ms, size_t *xs, size_t *ys);
+
+/// Parses a CONFIRM, RELEASE, GET_RESERVATION or CANCEL command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation or hold ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reservation_id(int fd, unsigned int *event_id, unsigned int *reservation_id);
+
 /// Parses a SHOW command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_show(int fd, unsigned int *event_id);
 
+/// Parses an AVAILABILITY command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param row Pointer to the variable to store the row in, 0 for the whole event.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_availability(int fd, unsigned int *event_id, size_t *row);
+
+/// Parses a SUBSCRIBE command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_subscribe(int fd, unsigned int *event_id);
+
+/// Parses a LIST_PAGE command.
+/// @param fd File descriptor to read from.
+/// @param limit Pointer to the variable to store the page size in.
+/// @param min_free Pointer to the variable to store the minimum number of free seats in.
+/// @param min_capacity Pointer to the variable to store the minimum number of seats in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_list_page(int fd, size_t *limit, size_t *min_free, size_t *min_capacity);
+
 /// Parses a WAIT command.
 /// @param fd File descriptor to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
@@ -1,4 +1,12 @@
 #define MAX_RESERVATION_SIZE 256
+#define MAX_PACKAGE_EVENTS 16  // Events reserved together by a single package
+#define MAX_BULK_EVENTS 4096   // Events created by a single bulk creation
 #define STATE_ACCESS_DELAY_US 500000  // 500ms
 #define MAX_JOB_FILE_NAME_SIZE 256
 #define MAX_SESSION_COUNT 8
+
+// Priorities a session declares at setup, requests never run above the priority of their session
+#define PRIORITY_HIGH 0    // Reservations, subscriptions and availability checks
+#define PRIORITY_NORMAL 1  // Shows, listings and single event creation
+#define PRIORITY_LOW 2     // Templates, bulk creation, forks, stats and waits
+#define NUM_PRIORITIES 3
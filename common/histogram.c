@@ -0,0 +1,71 @@
+#include "histogram.h"
+
+#include <string.h>
+
+/// Gets the bucket of a value.
+/// @param value Value to be recorded.
+/// @return Index of the bucket.
+static unsigned int bucket_of(uint64_t value) {
+  if (value < 2 * HISTOGRAM_SUB_BUCKETS) return (unsigned int)value;
+
+  unsigned int shift = (unsigned int)(63 - __builtin_clzll(value)) - HISTOGRAM_SUB_BITS;
+  return shift * HISTOGRAM_SUB_BUCKETS + (unsigned int)(value >> shift);
+}
+
+/// Gets the largest value of a bucket.
+/// @param bucket Index of the bucket.
+/// @return Largest value recorded in the bucket.
+static uint64_t bucket_max(unsigned int bucket) {
+  if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) return bucket;
+
+  unsigned int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+  uint64_t mantissa = bucket - shift * HISTOGRAM_SUB_BUCKETS;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void histogram_init(struct Histogram *histogram) { memset(histogram, 0, sizeof(struct Histogram)); }
+
+void histogram_record(struct Histogram *histogram, uint64_t value) {
+  unsigned int bucket = bucket_of(value);
+
+  // Single writer: plain increments published with relaxed stores are enough
+  __atomic_store_n(&histogram->buckets[bucket], histogram->buckets[bucket] + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+  if (value > histogram->max) __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+  __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+}
+
+void histogram_merge(struct Histogram *into, const struct Histogram *from) {
+  uint64_t count = 0;
+
+  for (unsigned int i = 0; i < HISTOGRAM_SIZE; i++) {
+    uint64_t bucket = __atomic_load_n(&from->buckets[i], __ATOMIC_RELAXED);
+    into->buckets[i] += bucket;
+    count += bucket;
+  }
+
+  // Recount so the total always matches the buckets that were read
+  into->count += count;
+  into->sum += __atomic_load_n(&from->sum, __ATOMIC_RELAXED);
+
+  uint64_t max = __atomic_load_n(&from->max, __ATOMIC_RELAXED);
+  if (max > into->max) into->max = max;
+}
+
+uint64_t histogram_percentile(const struct Histogram *histogram, double fraction) {
+  if (histogram->count == 0) return 0;
+
+  uint64_t rank = (uint64_t)(fraction * (double)histogram->count);
+  if (rank >= histogram->count) rank = histogram->count - 1;
+
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < HISTOGRAM_SIZE; i++) {
+    seen += histogram->buckets[i];
+    if (seen > rank) {
+      uint64_t value = bucket_max(i);
+      return value < histogram->max ? value : histogram->max;
+    }
+  }
+
+  return histogram->max;
+}
@@ -0,0 +1,40 @@
+#ifndef COMMON_HISTOGRAM_H
+#define COMMON_HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BITS 5                                   // 32 buckets per power of two, ~3% precision
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_SIZE ((65 - HISTOGRAM_SUB_BITS) * HISTOGRAM_SUB_BUCKETS)
+
+/// Log-linear histogram of 64-bit values (typically latencies in nanoseconds).
+/// @note Has a single writer. Other threads may read or merge it at any time and
+///       see every record either fully or not at all per bucket.
+struct Histogram {
+  uint64_t count;                   /// Number of recorded values.
+  uint64_t sum;                     /// Sum of the recorded values.
+  uint64_t max;                     /// Largest recorded value.
+  uint64_t buckets[HISTOGRAM_SIZE]; /// Number of values recorded in each bucket.
+};
+
+/// Empties a histogram.
+/// @param histogram Histogram to be reset.
+void histogram_init(struct Histogram *histogram);
+
+/// Records a value.
+/// @param histogram Histogram to record into, only ever written by one thread.
+/// @param value Value to be recorded.
+void histogram_record(struct Histogram *histogram, uint64_t value);
+
+/// Adds every value of a histogram to another one.
+/// @param into Histogram to add to.
+/// @param from Histogram to add, may be written concurrently.
+void histogram_merge(struct Histogram *into, const struct Histogram *from);
+
+/// Gets the value below which the given fraction of the values fall.
+/// @param histogram Histogram to be read.
+/// @param fraction Fraction between 0 and 1 (0.99 for the p99).
+/// @return Upper bound of the bucket holding the percentile, 0 if the histogram is empty.
+uint64_t histogram_percentile(const struct Histogram *histogram, double fraction);
+
+#endif  // COMMON_HISTOGRAM_H
@@ -0,0 +1,187 @@
+#include "trace.h"
+
+#ifdef TRACE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_RING_SIZE (1u << 14)  // Records per thread, a power of two
+#define TRACE_FLUSH_INTERVAL_NS 50000000L
+
+/// Records of a thread, a single-producer single-consumer ring.
+struct TraceRing {
+  uint64_t head;      /// Records written, only advanced by the owner thread.
+  uint64_t tail;      /// Records flushed, only advanced by the flusher.
+  uint64_t dropped;   /// Records dropped because the ring was full, only written by the owner thread.
+  uint64_t reported;  /// Dropped records already written to the file, only used by the flusher.
+  uint32_t thread;    /// Number of the owner thread.
+  struct TraceRing *next;
+  struct TraceRecord records[TRACE_RING_SIZE];
+};
+
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static int trace_fd = -1;
+static pthread_t flusher;
+static int stopping = 0;
+
+static struct TraceRing *all_rings = NULL;
+static uint32_t num_threads = 0;
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct TraceRing *local = NULL;
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// Writes a whole buffer to the trace file.
+/// @return 0 if everything was written, 1 otherwise.
+static int write_all(const void *data, size_t size) {
+  const char *bytes = data;
+
+  while (size > 0) {
+    ssize_t ret = write(trace_fd, bytes, size);
+    if (ret == -1 && errno == EINTR) continue;
+    if (ret == -1) {
+      fprintf(stderr, "[ERR]: write trace failed: %s\n", strerror(errno));
+      return 1;
+    }
+
+    bytes += ret;
+    size -= (size_t)ret;
+  }
+
+  return 0;
+}
+
+/// Writes the records of a ring that were not flushed yet, then frees their slots.
+/// @note Only called by one thread at a time, under rings_mutex.
+static void drain(struct TraceRing *ring) {
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t tail = ring->tail;
+
+  while (tail < head) {
+    size_t start = (size_t)(tail & (TRACE_RING_SIZE - 1));
+    size_t count = (size_t)(head - tail);
+    if (count > TRACE_RING_SIZE - start) count = TRACE_RING_SIZE - start;
+
+    // A failed write loses the records, keeping the ring moving is more important
+    write_all(&ring->records[start], count * sizeof(struct TraceRecord));
+    tail += count;
+  }
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+  uint64_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+  if (dropped != ring->reported) {
+    struct TraceRecord record = {now_ns(), ring->thread, TRACE_DROPPED, 0, dropped - ring->reported};
+    write_all(&record, sizeof(record));
+    ring->reported = dropped;
+  }
+}
+
+static void flush_all() {
+  pthread_mutex_lock(&rings_mutex);
+  for (struct TraceRing *ring = all_rings; ring != NULL; ring = ring->next) drain(ring);
+  pthread_mutex_unlock(&rings_mutex);
+}
+
+static void *run_flusher(void *arg) {
+  (void)arg;
+  struct timespec interval = {0, TRACE_FLUSH_INTERVAL_NS};
+
+  while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+    nanosleep(&interval, NULL);
+    flush_all();
+  }
+
+  return NULL;
+}
+
+/// Flushes what is left when the process exits.
+static void stop() {
+  __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+  pthread_join(flusher, NULL);
+  flush_all();
+  close(trace_fd);
+}
+
+/// Opens the trace file named by EMS_TRACE and starts the flusher.
+static void start() {
+  const char *prefix = getenv("EMS_TRACE");
+  if (prefix == NULL || prefix[0] == '\0') return;
+
+  char path[4096];
+  if ((size_t)snprintf(path, sizeof(path), "%s.%ld", prefix, (long)getpid()) >= sizeof(path)) {
+    fprintf(stderr, "Trace file path too long\n");
+    return;
+  }
+
+  trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (trace_fd == -1) {
+    fprintf(stderr, "[ERR]: open trace file failed: %s\n", strerror(errno));
+    return;
+  }
+
+  struct TraceHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.version = TRACE_VERSION;
+  header.pid = (uint32_t)getpid();
+
+  if (write_all(&header, sizeof(header)) != 0 || pthread_create(&flusher, NULL, run_flusher, NULL) != 0) {
+    close(trace_fd);
+    trace_fd = -1;
+    return;
+  }
+
+  atexit(stop);
+}
+
+/// Gets the ring of the calling thread, registering it on first use.
+/// @return Ring of the thread, NULL on allocation failure.
+static struct TraceRing *thread_ring() {
+  if (local != NULL) return local;
+
+  struct TraceRing *ring = calloc(1, sizeof(struct TraceRing));
+  if (ring == NULL) return NULL;
+
+  pthread_mutex_lock(&rings_mutex);
+  ring->thread = num_threads++;
+  ring->next = all_rings;
+  all_rings = ring;
+  pthread_mutex_unlock(&rings_mutex);
+
+  local = ring;
+  return ring;
+}
+
+void trace_record(enum TraceType type, unsigned int code, uint64_t arg) {
+  pthread_once(&trace_once, start);
+  if (trace_fd == -1) return;
+
+  struct TraceRing *ring = thread_ring();
+  if (ring == NULL) return;
+
+  uint64_t head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == TRACE_RING_SIZE) {
+    __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  struct TraceRecord *record = &ring->records[head & (TRACE_RING_SIZE - 1)];
+  record->timestamp = now_ns();
+  record->thread = ring->thread;
+  record->type = (uint16_t)type;
+  record->code = (uint16_t)code;
+  record->arg = arg;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+#endif  // TRACE
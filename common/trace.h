@@ -0,0 +1,58 @@
+#ifndef COMMON_TRACE_H
+#define COMMON_TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "EMSTRACE"
+#define TRACE_VERSION 1
+
+/// Points of a request that are traced.
+enum TraceType {
+  TRACE_SESSION,       /// A session was set up. Code: unused. Arg: session number.
+  TRACE_REQUEST,       /// A worker started a request. Code: unused. Arg: time it waited in its queue, in ns.
+  TRACE_LOOKUP_BEGIN,  /// The server started looking up an event. Code: unused. Arg: event id.
+  TRACE_LOOKUP_END,    /// The lookup finished. Code: whether the event was found. Arg: event id.
+  TRACE_LOCK,          /// The server acquired a lock. Code: 0 for the event list, 1 for an event. Arg: event id.
+  TRACE_REPLY,         /// The server replied. Code: operation code. Arg: return value.
+  TRACE_SEND,          /// The client sent a request. Code: operation code. Arg: unused.
+  TRACE_RECEIVE,       /// The client got the reply. Code: unused. Arg: return value.
+  TRACE_DROPPED,       /// Records lost because the ring was full. Code: unused. Arg: number lost.
+  NUM_TRACE_TYPES
+};
+
+/// Header at the start of a trace file.
+struct TraceHeader {
+  char magic[8];     /// TRACE_MAGIC, without the terminator.
+  uint32_t version;  /// TRACE_VERSION.
+  uint32_t pid;      /// Process that wrote the file.
+};
+
+/// Record of a trace file, written in the byte order of the machine.
+struct TraceRecord {
+  uint64_t timestamp;  /// CLOCK_MONOTONIC in nanoseconds, shared by every process of the machine.
+  uint32_t thread;     /// Thread of the process, numbered from 0 in the order they first traced.
+  uint16_t type;       /// enum TraceType.
+  uint16_t code;
+  uint64_t arg;
+};
+
+#ifdef TRACE
+
+/// Appends a record to the ring of the calling thread. Never blocks: the record is dropped if the ring is full.
+/// @note The first record of the process opens "$EMS_TRACE.<pid>" and starts the thread that flushes the rings to it.
+///       Nothing is recorded if EMS_TRACE is not set.
+/// @param type enum TraceType of the record.
+/// @param code Meaning depends on the type.
+/// @param arg Meaning depends on the type.
+void trace_record(enum TraceType type, unsigned int code, uint64_t arg);
+
+#define TRACE_EVENT(type, code, arg) trace_record(type, code, arg)
+
+#else
+
+// Compiled out: the hooks cost nothing
+#define TRACE_EVENT(type, code, arg) ((void)0)
+
+#endif  // TRACE
+
+#endif  // COMMON_TRACE_H
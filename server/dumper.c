@@ -0,0 +1,119 @@
+#include "dumper.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include "lockstats.h"
+#include "operations.h"
+#include "opstats.h"
+
+#define DUMP_BUFFER_SIZE (1 << 20)
+#define STATS_BUFFER_SIZE 65536
+
+static const char* dump_path = NULL;
+static const char* const* dump_op_names = NULL;
+static size_t dump_num_ops = 0;
+static int signal_fd = -1;
+
+/// Writes the state and the stats.
+/// @param out Stream to write to.
+/// @param dump Number of the dump.
+/// @return 0 if the dump was written successfully, 1 otherwise.
+static int write_dump(FILE* out, unsigned long dump) {
+  fprintf(out, "Dump %lu:\n", dump);
+  int ret = ems_dump(out);
+
+  char* stats = malloc(STATS_BUFFER_SIZE);
+  if (stats != NULL) {
+    op_stats_format(dump_op_names, dump_num_ops, stats, STATS_BUFFER_SIZE);
+    fputs(stats, out);
+    free(stats);
+  }
+
+  // Lock stats are written straight to the descriptor
+  if (fflush(out) != 0) return 1;
+  lock_stats_dump(fileno(out));
+
+  return ret;
+}
+
+/// Writes a dump to the configured file, through a temporary file so readers never see half a dump.
+/// @param dump Number of the dump.
+/// @return 0 if the dump was written successfully, 1 otherwise.
+static int dump_to_file(unsigned long dump) {
+  char tmp_path[4096];
+  if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", dump_path) >= sizeof(tmp_path)) {
+    fprintf(stderr, "Dump file path too long\n");
+    return 1;
+  }
+
+  FILE* out = fopen(tmp_path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "[ERR]: open dump file failed: %s\n", strerror(errno));
+    return 1;
+  }
+  setvbuf(out, NULL, _IOFBF, DUMP_BUFFER_SIZE);
+
+  int ret = write_dump(out, dump);
+  if (fclose(out) != 0) ret = 1;
+
+  if (ret == 0 && rename(tmp_path, dump_path) != 0) {
+    fprintf(stderr, "[ERR]: rename dump file failed: %s\n", strerror(errno));
+    ret = 1;
+  }
+
+  return ret;
+}
+
+static void* run_dumper(void* arg) {
+  (void)arg;
+  struct signalfd_siginfo info;
+  unsigned long dump = 0;
+
+  while (1) {
+    ssize_t ret = read(signal_fd, &info, sizeof(info));
+    if (ret == -1 && errno == EINTR) continue;
+    if (ret != sizeof(info)) {
+      fprintf(stderr, "[ERR]: read signalfd failed: %s\n", strerror(errno));
+      return NULL;
+    }
+
+    dump++;
+    if (dump_path != NULL) {
+      if (dump_to_file(dump) != 0) fprintf(stderr, "Failed to write dump\n");
+    } else if (write_dump(stdout, dump) != 0) {
+      fprintf(stderr, "Failed to write dump\n");
+    }
+  }
+}
+
+int dumper_start(const char* path, const char* const* op_names, size_t num_ops) {
+  dump_path = path;
+  dump_op_names = op_names;
+  dump_num_ops = num_ops;
+
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+
+  signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+  if (signal_fd == -1) {
+    fprintf(stderr, "[ERR]: signalfd failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, run_dumper, NULL) != 0) {
+    close(signal_fd);
+    return 1;
+  }
+
+  pthread_detach(thread);
+  return 0;
+}
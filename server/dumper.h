@@ -0,0 +1,14 @@
+#ifndef SERVER_DUMPER_H
+#define SERVER_DUMPER_H
+
+#include <stddef.h>
+
+/// Starts the thread that dumps the state and the stats on every SIGUSR1.
+/// @note SIGUSR1 must already be blocked in every thread, the dumper takes it through a signalfd.
+/// @param path File the dumps are written to, replaced atomically on each dump. NULL for stdout.
+/// @param op_names Names of the operations, for the latency stats.
+/// @param num_ops Number of operations.
+/// @return 0 if the thread was started successfully, 1 otherwise.
+int dumper_start(const char* path, const char* const* op_names, size_t num_ops);
+
+#endif  // SERVER_DUMPER_H
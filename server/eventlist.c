@@ -1,7 +1,87 @@
 #include "eventlist.h"
 
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKETS 64
+
+/// Gets the hash bucket of an event id.
+/// @param partition Partition owning the buckets.
+/// @param event_id Event id.
+/// @return Index of the bucket.
+static size_t bucket_of(struct EventPartition* partition, unsigned int event_id) {
+  uint32_t h = event_id;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h & (partition->num_buckets - 1);
+}
+
+/// Doubles the number of buckets once the index is full.
+/// @note Keeps the current buckets if memory runs out, lookups only get slower.
+/// @param partition Partition to be resized.
+static void grow_buckets(struct EventPartition* partition) {
+  size_t num_buckets = partition->num_buckets * 2;
+  struct ListNode** buckets = calloc(num_buckets, sizeof(struct ListNode*));
+  if (!buckets) return;
+
+  struct ListNode** old = partition->buckets;
+  size_t old_size = partition->num_buckets;
+  partition->buckets = buckets;
+  partition->num_buckets = num_buckets;
+
+  for (size_t i = 0; i < old_size; i++) {
+    struct ListNode* current = old[i];
+    while (current) {
+      struct ListNode* next = current->bucket_next;
+      size_t b = bucket_of(partition, current->event->id);
+      current->bucket_next = buckets[b];
+      buckets[b] = current;
+      current = next;
+    }
+  }
+
+  free(old);
+}
+
+/// Initializes an empty partition.
+/// @return 0 if the partition was initialized, 1 otherwise.
+static int init_partition(struct EventPartition* partition) {
+  partition->buckets = calloc(INITIAL_BUCKETS, sizeof(struct ListNode*));
+  if (!partition->buckets) return 1;
+  if (pthread_rwlock_init(&partition->rwl, NULL) != 0) {
+    free(partition->buckets);
+    return 1;
+  }
+  partition->head = NULL;
+  partition->tail = NULL;
+  partition->by_id = NULL;
+  partition->by_id_capacity = 0;
+  partition->num_buckets = INITIAL_BUCKETS;
+  partition->size = 0;
+  return 0;
+}
+
+/// Frees the nodes and events of a partition.
+/// @param partition Partition to be freed.
+static void free_partition(struct EventPartition* partition) {
+  struct ListNode* current = partition->head;
+  while (current) {
+    struct ListNode* temp = current;
+    current = current->next;
+
+    free_event(temp->event);
+    free(temp);
+  }
+
+  pthread_rwlock_destroy(&partition->rwl);
+  free(partition->by_id);
+  free(partition->buckets);
+}
 
 struct EventList* create_list() {
   struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
@@ -10,65 +90,191 @@ struct EventList* create_list() {
     free(list);
     return NULL;
   }
-  list->head = NULL;
-  list->tail = NULL;
+
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    if (init_partition(&list->partitions[i]) != 0) {
+      while (i > 0) free_partition(&list->partitions[--i]);
+      pthread_rwlock_destroy(&list->rwl);
+      free(list);
+      return NULL;
+    }
+  }
+
+  list->created = 0;
+  list->templates = NULL;
   return list;
 }
 
+struct EventPartition* list_partition(struct EventList* list, unsigned int event_id) {
+  // Consecutive ids land in different partitions, so creating them in a row does not contend
+  return &list->partitions[event_id % EVENT_LIST_PARTITIONS];
+}
+
 int append_to_list(struct EventList* list, struct Event* event) {
   if (!list) return 1;
+  if (reserve_partition(list_partition(list, event->id), 1) != 0) return 1;
 
   struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode));
   if (!new_node) return 1;
 
+  append_node(list, new_node, event);
+  return 0;
+}
+
+int reserve_partition(struct EventPartition* partition, size_t count) {
+  size_t needed = partition->size + count;
+  if (needed > partition->by_id_capacity) {
+    size_t capacity = partition->by_id_capacity == 0 ? INITIAL_BUCKETS : partition->by_id_capacity;
+    while (capacity < needed) capacity *= 2;
+    struct Event** by_id = realloc(partition->by_id, capacity * sizeof(struct Event*));
+    if (!by_id) return 1;
+    partition->by_id = by_id;
+    partition->by_id_capacity = capacity;
+  }
+
+  // Buckets that cannot grow only make lookups slower
+  while (partition->num_buckets < needed) {
+    size_t num_buckets = partition->num_buckets;
+    grow_buckets(partition);
+    if (partition->num_buckets == num_buckets) break;
+  }
+
+  return 0;
+}
+
+void append_node(struct EventList* list, struct ListNode* new_node, struct Event* event) {
+  struct EventPartition* partition = list_partition(list, event->id);
+
+  // Ids mostly grow, so the shifted tail is usually empty
+  size_t position = events_after(partition, event->id);
+  memmove(partition->by_id + position + 1, partition->by_id + position,
+          (partition->size - position) * sizeof(struct Event*));
+  partition->by_id[position] = event;
+
   new_node->event = event;
   new_node->next = NULL;
+  new_node->created = __atomic_fetch_add(&list->created, 1, __ATOMIC_RELAXED);
 
-  if (list->head == NULL) {
-    list->head = new_node;
-    list->tail = new_node;
+  if (partition->head == NULL) {
+    partition->head = new_node;
+    partition->tail = new_node;
   } else {
-    list->tail->next = new_node;
-    list->tail = new_node;
+    partition->tail->next = new_node;
+    partition->tail = new_node;
   }
 
-  return 0;
+  if (partition->size >= partition->num_buckets) grow_buckets(partition);
+  size_t b = bucket_of(partition, event->id);
+  new_node->bucket_next = partition->buckets[b];
+  partition->buckets[b] = new_node;
+  partition->size++;
 }
 
-static void free_event(struct Event* event) {
+void free_event(struct Event* event) {
   if (!event) return;
-  free(event->data);
+  subscription_free_list(&event->subscribers);
+  while (event->holds != NULL) {
+    struct Hold* next = event->holds->next;
+    free(event->holds);
+    event->holds = next;
+  }
+  free_runs_free(event->free_runs);
+  reservation_index_free(event->by_reservation);
+  seat_map_destroy(&event->data);
+  free(event->row_free);
+  pthread_mutex_destroy(&event->mutex);
   free(event);
 }
 
 void free_list(struct EventList* list) {
   if (!list) return;
 
-  struct ListNode* current = list->head;
-  while (current) {
-    struct ListNode* temp = current;
-    current = current->next;
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) free_partition(&list->partitions[i]);
 
-    free_event(temp->event);
-    free(temp);
+  struct Template* template = list->templates;
+  while (template) {
+    struct Template* next = template->next;
+    seat_map_destroy(&template->data);
+    free(template->row_free);
+    free(template);
+    template = next;
   }
 
   free(list);
 }
 
-struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to) {
-  if (!list || !from || !to) return NULL;
-  struct ListNode* current = from;
+struct Event* find_event(struct EventList* list, unsigned int event_id) {
+  if (!list) return NULL;
+  struct EventPartition* partition = list_partition(list, event_id);
 
-  while (1) {
+  for (struct ListNode* current = partition->buckets[bucket_of(partition, event_id)]; current;
+       current = current->bucket_next) {
     if (current->event->id == event_id) {
       return current->event;
     }
+  }
 
-    if (current == to) {
-      return NULL;
+  return NULL;
+}
+
+size_t events_after(struct EventPartition* partition, unsigned int event_id) {
+  size_t low = 0, high = partition->size;
+
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (partition->by_id[mid]->id <= event_id) {
+      low = mid + 1;
+    } else {
+      high = mid;
     }
+  }
 
-    current = current->next;
+  return low;
+}
+
+struct Event* next_by_id(struct EventList* list, size_t* positions) {
+  struct Event* next = NULL;
+  size_t taken = 0;
+
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    struct EventPartition* partition = &list->partitions[i];
+    if (positions[i] >= partition->size) continue;
+
+    struct Event* event = partition->by_id[positions[i]];
+    if (next == NULL || event->id < next->id) {
+      next = event;
+      taken = i;
+    }
   }
+
+  if (next != NULL) positions[taken]++;
+  return next;
+}
+
+struct ListNode* next_created(struct EventList* list, struct ListNode** nodes) {
+  (void)list;
+  struct ListNode* next = NULL;
+  size_t taken = 0;
+
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    if (nodes[i] != NULL && (next == NULL || nodes[i]->created < next->created)) {
+      next = nodes[i];
+      taken = i;
+    }
+  }
+
+  if (next != NULL) nodes[taken] = next->next;
+  return next;
+}
+
+struct Template* find_template(struct EventList* list, unsigned int template_id) {
+  if (!list) return NULL;
+
+  for (struct Template* current = list->templates; current; current = current->next) {
+    if (current->id == template_id) {
+      return current;
+    }
+  }
+
+  return NULL;
 }
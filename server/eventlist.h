@@ -3,51 +3,149 @@
 
 #include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#include "freeruns.h"
+#include "reservations.h"
+#include "seats.h"
+#include "subscriptions.h"
+
+/// Seats held for a limited time under a reservation id of their own, until confirmed, released or expired.
+struct Hold {
+  unsigned int id;     /// Reservation id written in the held seats.
+  uint64_t expires;    /// When the seats are released, CLOCK_MONOTONIC in nanoseconds.
+  struct Hold* next;   /// Next hold of the event.
+  size_t num_seats;    /// Number of distinct seats.
+  size_t seats[];      /// Indices of the seats.
+};
 
 struct Event {
   unsigned int id;            /// Event id
   unsigned int reservations;  /// Number of reservations for the event.
+  unsigned int blocked;       /// Reservation of the seats blocked by its template, never cancelled. 0 if none.
+
+  size_t cols;        /// Number of columns.
+  size_t rows;        /// Number of rows.
+  size_t free_seats;  /// Number of free seats, written under the mutex and read atomically.
+  size_t* row_free;   /// Number of free seats of each row, same rules as free_seats.
+
+  struct SeatMap data;               /// rows * cols reservations for each seat, copy-on-write.
+  struct FreeRuns* free_runs;        /// Free seat runs per row, built on the first best-seat search.
+  struct ReservationIndex* by_reservation;  /// Seats of each reservation, NULL until the first lookup needs it.
+  struct Subscription* subscribers;  /// Sessions notified of every reservation.
+  struct Hold* holds;                /// Active holds, NULL for the events that never had any.
+  uint64_t holds_expire;             /// Earliest expiry of the holds, UINT64_MAX if none. Written atomically.
+  pthread_mutex_t mutex;             // Mutex to protect the event
+};
 
-  size_t cols;  /// Number of columns.
-  size_t rows;  /// Number of rows.
+/// Prebuilt venue that events can be created from.
+struct Template {
+  unsigned int id;            /// Template id
+  unsigned int reservations;  /// Number of reservations of the blocked seats.
 
-  unsigned int* data;     /// Array of size rows * cols with the reservations for each seat.
-  pthread_mutex_t mutex;  // Mutex to protect the event
+  size_t cols;        /// Number of columns.
+  size_t rows;        /// Number of rows.
+  size_t free_seats;  /// Number of seats that are not blocked.
+  size_t* row_free;   /// Number of seats of each row that are not blocked.
+
+  struct SeatMap data;    /// Seat layout shared copy-on-write by the events created from it.
+  struct Template* next;  /// Next template of the list.
 };
 
+#define EVENT_LIST_PARTITIONS 16  // Partitions of the event list by id, each locked on its own
+
 struct ListNode {
   struct Event* event;
-  struct ListNode* next;
+  uint64_t created;              // Number of events appended to the whole list before this one
+  struct ListNode* next;         // Next node of the same partition, in creation order
+  struct ListNode* bucket_next;  // Next node in the same hash bucket
+};
+
+// Events whose ids fall in the same partition
+struct EventPartition {
+  struct ListNode* head;       // Head of the list
+  struct ListNode* tail;       // Tail of the list
+  struct ListNode** buckets;   // Hash index of the nodes by event id
+  size_t num_buckets;          // Number of buckets, a power of two
+  size_t size;                 // Number of events
+  struct Event** by_id;        // Events sorted by id
+  size_t by_id_capacity;       // Capacity of by_id
+  pthread_rwlock_t rwl;        // Lock protecting the partition
 };
 
 // Linked list structure
 struct EventList {
-  struct ListNode* head;  // Head of the list
-  struct ListNode* tail;  // Tail of the list
-  pthread_rwlock_t rwl;   // Mutex to protect the list
+  struct EventPartition partitions[EVENT_LIST_PARTITIONS];  // Events, split by id
+  uint64_t created;            // Number of events appended, updated atomically
+  struct Template* templates;  // Venue templates
+  pthread_rwlock_t rwl;        // Lock protecting the templates
 };
 
 /// Creates a new event list.
 /// @return Newly created event list, NULL on failure
 struct EventList* create_list();
 
-/// Appends a new node to the list.
-/// @param list Event list to be modified.
+/// Gets the partition an event id falls in.
+/// @param list Event list holding the partition.
+/// @param event_id Event id.
+/// @return Partition of the id.
+struct EventPartition* list_partition(struct EventList* list, unsigned int event_id);
+
+/// Appends a new node to the partition of its event.
+/// @param list Event list to be modified, with the partition of the event locked for writing.
 /// @param data Event to be stored in the new node.
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList* list, struct Event* data);
 
+/// Makes room for events about to be appended to a partition, so that appending them with append_node cannot fail.
+/// @param partition Partition to be grown, locked for writing.
+/// @param count Number of events to make room for.
+/// @return 0 if there is room, 1 otherwise.
+int reserve_partition(struct EventPartition* partition, size_t count);
+
+/// Appends a node allocated beforehand to the partition of its event.
+/// @param list Event list to be modified, with the partition of the event locked for writing and room reserved.
+/// @param new_node Node to be appended, owned by the list afterwards.
+/// @param event Event to be stored in the node.
+void append_node(struct EventList* list, struct ListNode* new_node, struct Event* event);
+
 /// Removes a node from the list.
 /// @param list Event list to be modified.
 /// @return 0 if the node was removed successfully, 1 otherwise.
 void free_list(struct EventList* list);
 
-/// Retrieves an event in the list.
-/// @param list Event list to be searched
+/// Retrieves an event through the hash index of its partition.
+/// @param list Event list to be searched, with the partition of the id locked.
 /// @param event_id Event id.
-/// @param from First node to be searched.
-/// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
-struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to);
+struct Event* find_event(struct EventList* list, unsigned int event_id);
+
+/// Finds the position of the first event with an id larger than the given one.
+/// @param partition Partition to be searched
+/// @param event_id Event id.
+/// @return Index in partition->by_id of the first larger event, partition->size if there is none.
+size_t events_after(struct EventPartition* partition, unsigned int event_id);
+
+/// Takes the next event in id order across the partitions.
+/// @param list Event list to be walked, with every partition locked.
+/// @param positions Position reached in the by_id array of each partition, advanced past the event taken.
+/// @return Event with the smallest id left, NULL once every partition was walked.
+struct Event* next_by_id(struct EventList* list, size_t* positions);
+
+/// Takes the next node in creation order across the partitions.
+/// @param list Event list to be walked, with every partition locked.
+/// @param nodes Next node of each partition, starting from the heads, advanced past the node taken.
+/// @return Oldest node left, NULL once every partition was walked.
+struct ListNode* next_created(struct EventList* list, struct ListNode** nodes);
+
+/// Retrieves a template of the list.
+/// @param list Event list to be searched
+/// @param template_id Template id.
+/// @return Pointer to the template if found, NULL otherwise.
+struct Template* find_template(struct EventList* list, unsigned int template_id);
+
+/// Frees an event and everything it owns.
+/// @param event Event to be freed.
+void free_event(struct Event* event);
 
 #endif  // SERVER_EVENT_LIST_H
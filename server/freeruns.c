@@ -0,0 +1,169 @@
+#include "freeruns.h"
+
+#include <stdlib.h>
+
+/// Combines the summaries of two adjacent ranges of the same length.
+/// @param left Summary of the left range.
+/// @param right Summary of the right range.
+/// @param len Length of each range.
+/// @return Summary of the joined range.
+static struct RunNode combine(struct RunNode left, struct RunNode right, unsigned int len) {
+  struct RunNode node;
+  node.prefix = left.prefix == len ? len + right.prefix : left.prefix;
+  node.suffix = right.suffix == len ? len + left.suffix : right.suffix;
+  node.best = left.suffix + right.prefix;
+  if (left.best > node.best) node.best = left.best;
+  if (right.best > node.best) node.best = right.best;
+  return node;
+}
+
+/// Gets the tree of a row.
+/// @param runs Index to get the tree from.
+/// @param row Row of the tree, starting at 1.
+/// @return Pointer to the nodes of the row tree.
+static struct RunNode* row_tree(const struct FreeRuns* runs, size_t row) {
+  return runs->nodes + (row - 1) * 2 * runs->leaves;
+}
+
+struct FreeRuns* free_runs_create(size_t rows, size_t cols, const struct SeatMap* data) {
+  struct FreeRuns* runs = malloc(sizeof(struct FreeRuns));
+  if (runs == NULL) return NULL;
+
+  runs->rows = rows;
+  runs->cols = cols;
+  runs->leaves = 1;
+  while (runs->leaves < cols) runs->leaves *= 2;
+
+  runs->nodes = calloc(rows * 2 * runs->leaves, sizeof(struct RunNode));
+  if (runs->nodes == NULL) {
+    free(runs);
+    return NULL;
+  }
+
+  for (size_t row = 1; row <= rows; row++) {
+    struct RunNode* tree = row_tree(runs, row);
+
+    // Padding leaves past the last column stay taken so runs never cross them
+    for (size_t col = 0; col < cols; col++) {
+      unsigned int is_free = seat_map_get(data, (row - 1) * cols + col) == 0;
+      tree[runs->leaves + col] = (struct RunNode){is_free, is_free, is_free};
+    }
+
+    unsigned int len = 1;
+    for (size_t level = runs->leaves / 2; level >= 1; level /= 2, len *= 2) {
+      for (size_t i = level; i < 2 * level; i++) {
+        tree[i] = combine(tree[2 * i], tree[2 * i + 1], len);
+      }
+    }
+  }
+
+  return runs;
+}
+
+void free_runs_free(struct FreeRuns* runs) {
+  if (runs == NULL) return;
+  free(runs->nodes);
+  free(runs);
+}
+
+void free_runs_set(struct FreeRuns* runs, size_t row, size_t col, int is_free) {
+  struct RunNode* tree = row_tree(runs, row);
+  size_t i = runs->leaves + col - 1;
+  unsigned int leaf = is_free != 0;
+  tree[i] = (struct RunNode){leaf, leaf, leaf};
+
+  for (unsigned int len = 1; i > 1; len *= 2) {
+    i /= 2;
+    tree[i] = combine(tree[2 * i], tree[2 * i + 1], len);
+  }
+}
+
+/// Finds the leftmost block of free seats starting at or after a column.
+/// @param tree Row tree to be searched.
+/// @param node Current node.
+/// @param first First column (from 0) covered by the node.
+/// @param len Number of columns covered by the node.
+/// @param from First column (from 0) the block may start at.
+/// @param num_seats Number of seats in the block.
+/// @param carry Free seats, at or after from, right before the node.
+/// @return First column (from 0) of the block, -1 if there is none.
+static long first_fit(const struct RunNode* tree, size_t node, size_t first, size_t len, size_t from,
+                      size_t num_seats, size_t* carry) {
+  if (first + len <= from) return -1;
+
+  if (first >= from) {
+    if (*carry + tree[node].prefix >= num_seats) return (long)(first - *carry);
+
+    if (tree[node].best < num_seats) {
+      *carry = tree[node].prefix == len ? *carry + len : tree[node].suffix;
+      return -1;
+    }
+  }
+
+  long found = first_fit(tree, 2 * node, first, len / 2, from, num_seats, carry);
+  if (found >= 0) return found;
+  return first_fit(tree, 2 * node + 1, first + len / 2, len / 2, from, num_seats, carry);
+}
+
+/// Finds the rightmost block of free seats ending at or before a column.
+/// @param tree Row tree to be searched.
+/// @param node Current node.
+/// @param first First column (from 0) covered by the node.
+/// @param len Number of columns covered by the node.
+/// @param limit Last column (from 0) the block may end at.
+/// @param num_seats Number of seats in the block.
+/// @param carry Free seats, at or before limit, right after the node.
+/// @return First column (from 0) of the block, -1 if there is none.
+static long last_fit(const struct RunNode* tree, size_t node, size_t first, size_t len, size_t limit,
+                     size_t num_seats, size_t* carry) {
+  if (first > limit) return -1;
+
+  size_t last = first + len - 1;
+  if (last <= limit) {
+    if (*carry + tree[node].suffix >= num_seats) return (long)(last + *carry + 1 - num_seats);
+
+    if (tree[node].best < num_seats) {
+      *carry = tree[node].suffix == len ? *carry + len : tree[node].prefix;
+      return -1;
+    }
+  }
+
+  long found = last_fit(tree, 2 * node + 1, first + len / 2, len / 2, limit, num_seats, carry);
+  if (found >= 0) return found;
+  return last_fit(tree, 2 * node, first, len / 2, limit, num_seats, carry);
+}
+
+int free_runs_find_best(const struct FreeRuns* runs, size_t num_seats, size_t* row, size_t* col) {
+  if (num_seats == 0 || num_seats > runs->cols) return 1;
+
+  size_t center = (runs->cols - num_seats) / 2;
+  size_t middle = (runs->rows + 1) / 2;
+
+  // Visit rows outwards from the middle one: middle, middle - 1, middle + 1, ...
+  for (size_t offset = 0; offset < runs->rows; offset++) {
+    size_t candidates[2] = {middle - offset, middle + offset};
+
+    for (size_t i = 0; i < (offset == 0 ? 1u : 2u); i++) {
+      size_t candidate = candidates[i];
+      if (candidate < 1 || candidate > runs->rows) continue;
+
+      const struct RunNode* tree = row_tree(runs, candidate);
+      if (tree[1].best < num_seats) continue;
+
+      // The row has a fit, so at least one side of the center finds it
+      size_t carry = 0;
+      long right = first_fit(tree, 1, 0, runs->leaves, center, num_seats, &carry);
+      carry = 0;
+      long left = last_fit(tree, 1, 0, runs->leaves, center + num_seats - 1, num_seats, &carry);
+
+      long start = left;
+      if (left < 0 || (right >= 0 && (size_t)right - center < center - (size_t)left)) start = right;
+
+      *row = candidate;
+      *col = (size_t)start + 1;
+      return 0;
+    }
+  }
+
+  return 1;
+}
@@ -0,0 +1,51 @@
+#ifndef SERVER_FREE_RUNS_H
+#define SERVER_FREE_RUNS_H
+
+#include <stddef.h>
+
+#include "seats.h"
+
+/// Segment tree node summarizing the free seats of a range of columns.
+struct RunNode {
+  unsigned int prefix;  /// Free seats at the start of the range.
+  unsigned int suffix;  /// Free seats at the end of the range.
+  unsigned int best;    /// Longest run of free seats inside the range.
+};
+
+/// Per-row index of the longest runs of free seats of an event.
+struct FreeRuns {
+  size_t rows;             /// Number of rows.
+  size_t cols;             /// Number of columns.
+  size_t leaves;           /// Leaves per row tree, cols rounded up to a power of two.
+  struct RunNode* nodes;   /// rows trees of 2 * leaves nodes, root at index 1.
+};
+
+/// Builds the index from the reservations of an event.
+/// @param rows Number of rows.
+/// @param cols Number of columns.
+/// @param data rows * cols reservations for each seat.
+/// @return Newly created index, NULL on failure.
+struct FreeRuns* free_runs_create(size_t rows, size_t cols, const struct SeatMap* data);
+
+/// Frees an index.
+/// @param runs Index to be freed.
+void free_runs_free(struct FreeRuns* runs);
+
+/// Marks a seat as free or taken.
+/// @param runs Index to be updated.
+/// @param row Row of the seat, starting at 1.
+/// @param col Column of the seat, starting at 1.
+/// @param is_free Whether the seat is now free.
+void free_runs_set(struct FreeRuns* runs, size_t row, size_t col, int is_free);
+
+/// Finds the best block of contiguous free seats in a single row.
+/// @note Rows closer to the middle of the venue are preferred, then the block
+///       closest to the middle of the row. Costs O(rows + log cols).
+/// @param runs Index to be searched.
+/// @param num_seats Number of seats in the block.
+/// @param row Pointer to the variable to store the row of the block in, starting at 1.
+/// @param col Pointer to the variable to store the first column of the block in, starting at 1.
+/// @return 0 if a block was found, 1 otherwise.
+int free_runs_find_best(const struct FreeRuns* runs, size_t num_seats, size_t* row, size_t* col);
+
+#endif  // SERVER_FREE_RUNS_H
@@ -0,0 +1,376 @@
+#define _GNU_SOURCE  // syscall and the io_uring mmap flags
+#include "ioloop.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/// What an io_uring submission does, kept in the low bits of its user data.
+enum UringKind { URING_READ, URING_WRITE, URING_POLL, URING_CANCEL };
+
+/// State of the read or the write of a tag.
+enum SlotState {
+  SLOT_IDLE,        /// Nothing in flight.
+  SLOT_BUSY,        /// In flight, reported once done.
+  SLOT_CANCELLING   /// Dropped by io_loop_forget, its completion is swallowed.
+};
+
+/// Operations of a tag.
+struct IoSlot {
+  int fd;                   /// Pipe of the read.
+  enum SlotState reading;   /// State of the read.
+  int registered;           /// Whether fd is in the epoll set.
+  char* buffer;             /// Destination of the read.
+  int write_fd;             /// Pipe of the write.
+  enum SlotState writing;   /// State of the write.
+  char* out;                /// Copy of the data being written.
+  size_t out_size;          /// Size of out.
+  size_t out_len;           /// Number of bytes to write.
+  size_t out_done;          /// Number of bytes already written.
+};
+
+/// Shared rings of an io_uring, as mapped from the kernel.
+struct Uring {
+  int fd;
+  unsigned* sq_head;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  struct io_uring_sqe* sqes;
+  unsigned sq_entries;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_cqe* cqes;
+  unsigned tail;     /// Next submission to be filled.
+  unsigned flushed;  /// Submissions handed to the kernel.
+};
+
+static enum IoBackend io_backend;
+static struct IoSlot* slots = NULL;
+static size_t num_slots = 0;
+static size_t slot_read_size = 0;
+static int epoll_fd = -1;
+static struct Uring ring;
+
+/// Sets up an io_uring with room for every operation of every tag.
+/// @param entries Number of submissions.
+/// @return 0 if the ring was set up, 1 otherwise.
+static int uring_setup(unsigned entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  long fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) return 1;
+  ring.fd = (int)fd;
+
+  // Waiting with a timeout needs the extended enter arguments, and a single mapping keeps the setup simple
+  if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+    close(ring.fd);
+    return 1;
+  }
+
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  size_t size = sq_size > cq_size ? sq_size : cq_size;
+  char* rings = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+  if (rings == MAP_FAILED) {
+    close(ring.fd);
+    return 1;
+  }
+
+  ring.sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+  if (ring.sqes == MAP_FAILED) {
+    munmap(rings, size);
+    close(ring.fd);
+    return 1;
+  }
+
+  ring.sq_head = (unsigned*)(void*)(rings + params.sq_off.head);
+  ring.sq_tail = (unsigned*)(void*)(rings + params.sq_off.tail);
+  ring.sq_mask = (unsigned*)(void*)(rings + params.sq_off.ring_mask);
+  ring.sq_array = (unsigned*)(void*)(rings + params.sq_off.array);
+  ring.sq_entries = params.sq_entries;
+  ring.cq_head = (unsigned*)(void*)(rings + params.cq_off.head);
+  ring.cq_tail = (unsigned*)(void*)(rings + params.cq_off.tail);
+  ring.cq_mask = (unsigned*)(void*)(rings + params.cq_off.ring_mask);
+  ring.cqes = (struct io_uring_cqe*)(void*)(rings + params.cq_off.cqes);
+  ring.tail = *ring.sq_tail;
+  ring.flushed = ring.tail;
+  return 0;
+}
+
+/// Hands the filled submissions to the kernel, optionally waiting for a completion.
+/// @param wait Whether to wait for a completion.
+/// @param timeout_ms Milliseconds to wait at most, -1 to wait forever.
+/// @return 0 on success or timeout, 1 on error.
+static int uring_enter(int wait, int timeout_ms) {
+  __atomic_store_n(ring.sq_tail, ring.tail, __ATOMIC_RELEASE);
+
+  struct __kernel_timespec ts = {timeout_ms / 1000, (long long)(timeout_ms % 1000) * 1000000};
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = timeout_ms < 0 ? 0 : (uint64_t)(uintptr_t)&ts;
+  unsigned flags = wait ? IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG : 0;
+
+  long ret = syscall(__NR_io_uring_enter, ring.fd, ring.tail - ring.flushed, wait ? 1 : 0, flags,
+                     wait ? &arg : NULL, wait ? sizeof(arg) : 0);
+  if (ret >= 0) {
+    ring.flushed += (unsigned)ret;
+    return 0;
+  }
+  return errno == ETIME || errno == EINTR || errno == EBUSY ? 0 : 1;
+}
+
+/// Takes the next free submission, handing the filled ones to the kernel first if the ring is full.
+/// @return Zeroed submission.
+static struct io_uring_sqe* uring_sqe() {
+  if (ring.tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) == ring.sq_entries) uring_enter(0, 0);
+
+  unsigned index = ring.tail & *ring.sq_mask;
+  ring.sq_array[index] = index;
+  ring.tail++;
+
+  struct io_uring_sqe* sqe = &ring.sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+/// Builds the user data of a submission.
+static uint64_t uring_data(size_t tag, enum UringKind kind) { return (uint64_t)tag << 2 | (uint64_t)kind; }
+
+/// Queues a read of a tag, behind a poll so that pipes without a writer yet are waited on instead of read as ended.
+/// @param tag Tag of the read.
+static void uring_queue_read(size_t tag) {
+  struct IoSlot* slot = &slots[tag];
+
+  // The link only holds within a single submission
+  if (ring.sq_entries - (ring.tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE)) < 2) uring_enter(0, 0);
+
+  struct io_uring_sqe* poll = uring_sqe();
+  poll->opcode = IORING_OP_POLL_ADD;
+  poll->fd = slot->fd;
+  poll->poll32_events = POLLIN;
+  poll->flags = IOSQE_IO_LINK;
+  poll->user_data = uring_data(tag, URING_POLL);
+
+  struct io_uring_sqe* read = uring_sqe();
+  read->opcode = IORING_OP_READ;
+  read->fd = slot->fd;
+  read->addr = (uint64_t)(uintptr_t)slot->buffer;
+  read->len = (unsigned)slot_read_size;
+  read->off = (uint64_t)-1;  // Pipes have no offset
+  read->user_data = uring_data(tag, URING_READ);
+}
+
+/// Queues the rest of the write of a tag.
+/// @param tag Tag of the write.
+static void uring_queue_write(size_t tag) {
+  struct IoSlot* slot = &slots[tag];
+  struct io_uring_sqe* write = uring_sqe();
+  write->opcode = IORING_OP_WRITE;
+  write->fd = slot->write_fd;
+  write->addr = (uint64_t)(uintptr_t)(slot->out + slot->out_done);
+  write->len = (unsigned)(slot->out_len - slot->out_done);
+  write->off = (uint64_t)-1;
+  write->user_data = uring_data(tag, URING_WRITE);
+}
+
+/// Queues the cancellation of a submission.
+/// @param target User data of the submission.
+static void uring_queue_cancel(uint64_t target) {
+  struct io_uring_sqe* cancel = uring_sqe();
+  cancel->opcode = IORING_OP_ASYNC_CANCEL;
+  cancel->addr = target;
+  cancel->user_data = uring_data(0, URING_CANCEL);
+}
+
+/// Turns a completion of the ring into the completion of a tag.
+/// @param cqe Completion of the ring.
+/// @param completion Completion to be filled.
+/// @return 1 if the completion is reported, 0 if it is swallowed.
+static int uring_complete(const struct io_uring_cqe* cqe, struct IoCompletion* completion) {
+  enum UringKind kind = (enum UringKind)(cqe->user_data & 3);
+  size_t tag = (size_t)(cqe->user_data >> 2);
+  if (kind == URING_POLL || kind == URING_CANCEL || tag >= num_slots) return 0;
+  struct IoSlot* slot = &slots[tag];
+
+  if (kind == URING_READ) {
+    if (slot->reading == SLOT_CANCELLING) {
+      slot->reading = SLOT_IDLE;
+      return 0;
+    }
+
+    // The poll saw data that was gone by the time of the read: just wait again
+    if (cqe->res == -EAGAIN || cqe->res == -EINTR) {
+      uring_queue_read(tag);
+      return 0;
+    }
+
+    slot->reading = SLOT_IDLE;
+    *completion = (struct IoCompletion){tag, 0, cqe->res, slot->buffer};
+    return 1;
+  }
+
+  if (slot->writing == SLOT_CANCELLING) {
+    slot->writing = SLOT_IDLE;
+    return 0;
+  }
+
+  if (cqe->res > 0 && slot->out_done + (size_t)cqe->res < slot->out_len) {
+    slot->out_done += (size_t)cqe->res;
+    uring_queue_write(tag);
+    return 0;
+  }
+
+  slot->writing = SLOT_IDLE;
+  *completion = (struct IoCompletion){tag, 1, cqe->res > 0 ? (ssize_t)(slot->out_done + (size_t)cqe->res) : cqe->res,
+                                      NULL};
+  return 1;
+}
+
+int io_loop_init(enum IoBackend* backend, size_t num_tags, size_t read_size) {
+  slots = calloc(num_tags, sizeof(struct IoSlot));
+  if (slots == NULL) return 1;
+  num_slots = num_tags;
+  slot_read_size = read_size;
+
+  for (size_t i = 0; i < num_tags; i++) {
+    slots[i].buffer = malloc(read_size);
+    if (slots[i].buffer == NULL) return 1;
+  }
+
+  // A poll, a read, a write and two cancellations per tag at most
+  if (*backend == IO_BACKEND_URING && uring_setup((unsigned)(num_tags * 5)) != 0) {
+    fprintf(stderr, "[INFO]: io_uring unavailable, falling back to epoll\n");
+    *backend = IO_BACKEND_EPOLL;
+  }
+
+  if (*backend == IO_BACKEND_EPOLL) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) return 1;
+  }
+
+  io_backend = *backend;
+  return 0;
+}
+
+int io_loop_read(size_t tag, int fd) {
+  struct IoSlot* slot = &slots[tag];
+  if (slot->reading != SLOT_IDLE) return 1;
+  slot->fd = fd;
+
+  if (io_backend == IO_BACKEND_URING) {
+    uring_queue_read(tag);
+    slot->reading = SLOT_BUSY;
+    return 0;
+  }
+
+  // One-shot, so a pipe is only reported once per armed read
+  struct epoll_event event = {EPOLLIN | EPOLLONESHOT, {.u64 = tag}};
+  if (epoll_ctl(epoll_fd, slot->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) != 0) {
+    fprintf(stderr, "[ERR]: epoll_ctl failed: %s\n", strerror(errno));
+    return 1;
+  }
+  slot->registered = 1;
+  slot->reading = SLOT_BUSY;
+  return 0;
+}
+
+int io_loop_write(size_t tag, int fd, const char* data, size_t len) {
+  struct IoSlot* slot = &slots[tag];
+  if (io_backend != IO_BACKEND_URING || slot->writing != SLOT_IDLE) return 1;
+
+  if (len > slot->out_size) {
+    char* out = realloc(slot->out, len);
+    if (out == NULL) return 1;
+    slot->out = out;
+    slot->out_size = len;
+  }
+
+  memcpy(slot->out, data, len);
+  slot->write_fd = fd;
+  slot->out_len = len;
+  slot->out_done = 0;
+  slot->writing = SLOT_BUSY;
+  uring_queue_write(tag);
+  return 0;
+}
+
+void io_loop_forget(size_t tag) {
+  struct IoSlot* slot = &slots[tag];
+
+  if (io_backend == IO_BACKEND_EPOLL) {
+    if (slot->registered) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, slot->fd, NULL);
+    slot->registered = 0;
+    slot->reading = SLOT_IDLE;
+    return;
+  }
+
+  // The kernel keeps its own reference to the pipes, so they can be closed right away
+  if (slot->reading == SLOT_BUSY) {
+    uring_queue_cancel(uring_data(tag, URING_POLL));
+    uring_queue_cancel(uring_data(tag, URING_READ));
+    slot->reading = SLOT_CANCELLING;
+  }
+  if (slot->writing == SLOT_BUSY) {
+    uring_queue_cancel(uring_data(tag, URING_WRITE));
+    slot->writing = SLOT_CANCELLING;
+  }
+}
+
+int io_loop_wait(int timeout_ms, struct IoCompletion* completions, size_t max) {
+  if (io_backend == IO_BACKEND_URING) {
+    // Only waits when nothing is left from the last call
+    int ready = *ring.cq_head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    if (uring_enter(!ready, timeout_ms) != 0) {
+      fprintf(stderr, "[ERR]: io_uring_enter failed: %s\n", strerror(errno));
+      return -1;
+    }
+
+    size_t count = 0;
+    unsigned head = *ring.cq_head;
+    while (count < max && head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+      count += (size_t)uring_complete(&ring.cqes[head & *ring.cq_mask], &completions[count]);
+      head++;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    return (int)count;
+  }
+
+  struct epoll_event events[64];
+  int num_events = epoll_wait(epoll_fd, events, (int)(max < 64 ? max : 64), timeout_ms);
+  if (num_events == -1) {
+    if (errno == EINTR) return 0;
+    fprintf(stderr, "[ERR]: epoll_wait failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  size_t count = 0;
+  for (int i = 0; i < num_events; i++) {
+    size_t tag = (size_t)events[i].data.u64;
+    struct IoSlot* slot = &slots[tag];
+    if (slot->reading != SLOT_BUSY) continue;
+
+    ssize_t len = read(slot->fd, slot->buffer, slot_read_size);
+    if (len == -1 && (errno == EAGAIN || errno == EINTR)) {
+      slot->reading = SLOT_IDLE;
+      io_loop_read(tag, slot->fd);
+      continue;
+    }
+
+    slot->reading = SLOT_IDLE;
+    completions[count++] = (struct IoCompletion){tag, 0, len == -1 ? -errno : len, slot->buffer};
+  }
+
+  return (int)count;
+}
@@ -0,0 +1,55 @@
+#ifndef SERVER_IO_LOOP_H
+#define SERVER_IO_LOOP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/// How the host thread waits on the pipes.
+enum IoBackend {
+  IO_BACKEND_EPOLL,  /// Readiness from epoll, then a read per ready pipe.
+  IO_BACKEND_URING   /// Reads and writes submitted to an io_uring in batches, a single syscall per loop.
+};
+
+/// Outcome of a read or write armed on the loop.
+struct IoCompletion {
+  size_t tag;        /// Tag the operation was armed with.
+  int write;         /// Whether the operation was a write.
+  ssize_t len;       /// Bytes transferred, 0 at end of file, -errno on error.
+  const char* data;  /// Bytes read, owned by the loop until the tag is armed again.
+};
+
+/// Sets up the loop.
+/// @note io_uring falls back to epoll when the kernel does not have it, lacks a needed feature or forbids it.
+/// @param backend Backend wanted, updated to the backend in use.
+/// @param num_tags Number of tags, each with at most one read and one write in flight.
+/// @param read_size Largest number of bytes taken by a read.
+/// @return 0 if the loop was set up successfully, 1 otherwise.
+int io_loop_init(enum IoBackend* backend, size_t num_tags, size_t read_size);
+
+/// Arms a single read of a pipe, reported by io_loop_wait once data or the end of file is there.
+/// @param tag Tag of the read.
+/// @param fd Pipe to be read.
+/// @return 0 if the read was armed, 1 if the previous one of the tag is still being cancelled or on error.
+int io_loop_read(size_t tag, int fd);
+
+/// Writes a whole buffer to a pipe without blocking the caller, only with IO_BACKEND_URING.
+/// @note The data is copied, short writes are continued by the loop and only the final outcome is reported.
+/// @param tag Tag of the write.
+/// @param fd Pipe to be written.
+/// @param data Bytes to be written.
+/// @param len Number of bytes.
+/// @return 0 if the write was submitted, 1 if the previous one of the tag is still in flight or on error.
+int io_loop_write(size_t tag, int fd, const char* data, size_t len);
+
+/// Drops whatever is armed for a tag, so its pipes can be closed. Nothing more is reported for it.
+/// @param tag Tag to be dropped.
+void io_loop_forget(size_t tag);
+
+/// Submits what was armed and waits for completions.
+/// @param timeout_ms Milliseconds to wait at most, -1 to wait forever.
+/// @param completions Array to store the completions in.
+/// @param max Size of the array.
+/// @return Number of completions stored, 0 on timeout, -1 on error.
+int io_loop_wait(int timeout_ms, struct IoCompletion* completions, size_t max);
+
+#endif  // SERVER_IO_LOOP_H
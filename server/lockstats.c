@@ -0,0 +1,282 @@
+#include "lockstats.h"
+
+#ifdef LOCK_STATS
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common/histogram.h"
+
+#define MAX_HELD 16          // Locks a thread may hold at once
+#define HOT_EVENT_SLOTS 256  // Events tracked individually, the rest are reported as "other"
+#define HOT_EVENTS_SHOWN 10
+
+static const char* class_names[NUM_LOCK_CLASSES] = {"list", "event", "queue"};
+
+/// Statistics of a lock class, written by a single thread.
+struct ClassStats {
+  uint64_t acquisitions;  /// Number of acquisitions.
+  uint64_t contended;     /// Acquisitions that had to wait.
+  struct Histogram wait;  /// Time waited for each acquisition, in nanoseconds.
+  struct Histogram hold;  /// Time each acquisition was held, in nanoseconds.
+};
+
+/// Lock currently held by a thread.
+struct HeldLock {
+  const void* lock;   /// Address of the lock.
+  uint64_t since;     /// When it was acquired.
+};
+
+/// Statistics of a thread, merged on dump.
+struct ThreadStats {
+  struct ClassStats classes[NUM_LOCK_CLASSES];
+  struct HeldLock held[MAX_HELD];
+  size_t num_held;
+  struct ThreadStats* next;
+};
+
+/// Totals of a single event mutex, shared by every thread.
+struct EventStats {
+  unsigned int id;        /// Event id plus one, 0 for a free slot.
+  uint64_t acquisitions;
+  uint64_t contended;
+  uint64_t wait_ns;
+  uint64_t hold_ns;
+};
+
+static struct ThreadStats* all_threads = NULL;
+static pthread_mutex_t all_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct ThreadStats* local = NULL;
+static struct EventStats events[HOT_EVENT_SLOTS + 1];  // Last slot collects the overflow
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// Gets the statistics of the calling thread, registering them on first use.
+/// @return Statistics of the thread, NULL on allocation failure.
+static struct ThreadStats* thread_stats() {
+  if (local != NULL) return local;
+
+  local = calloc(1, sizeof(struct ThreadStats));
+  if (local == NULL) return NULL;
+
+  pthread_mutex_lock(&all_threads_mutex);
+  local->next = all_threads;
+  all_threads = local;
+  pthread_mutex_unlock(&all_threads_mutex);
+
+  return local;
+}
+
+/// Finds or claims the slot of an event.
+/// @param event_id Id of the event.
+/// @return Slot of the event, the overflow slot if the table is full.
+static struct EventStats* event_stats(unsigned int event_id) {
+  unsigned int key = event_id + 1;
+  size_t slot = (key * 2654435761u) % HOT_EVENT_SLOTS;
+
+  for (size_t probe = 0; probe < HOT_EVENT_SLOTS; probe++) {
+    struct EventStats* stats = &events[(slot + probe) % HOT_EVENT_SLOTS];
+    unsigned int id = __atomic_load_n(&stats->id, __ATOMIC_ACQUIRE);
+    if (id == key) return stats;
+    if (id == 0 &&
+        (__atomic_compare_exchange_n(&stats->id, &id, key, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) || id == key))
+      return stats;
+  }
+
+  return &events[HOT_EVENT_SLOTS];
+}
+
+/// Records an acquisition.
+/// @param lock Lock that was acquired.
+/// @param contended Whether the first attempt failed.
+/// @param start When the acquisition started.
+static void acquired(const void* lock, enum LockClass lock_class, unsigned int event_id, int contended,
+                     uint64_t start) {
+  struct ThreadStats* stats = thread_stats();
+  if (stats == NULL) return;
+
+  uint64_t now = contended ? now_ns() : start;
+  struct ClassStats* class_stats = &stats->classes[lock_class];
+  __atomic_store_n(&class_stats->acquisitions, class_stats->acquisitions + 1, __ATOMIC_RELAXED);
+  if (contended) __atomic_store_n(&class_stats->contended, class_stats->contended + 1, __ATOMIC_RELAXED);
+  histogram_record(&class_stats->wait, now - start);
+
+  if (lock_class == LOCK_CLASS_EVENT) {
+    struct EventStats* event = event_stats(event_id);
+    __atomic_add_fetch(&event->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended) __atomic_add_fetch(&event->contended, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&event->wait_ns, now - start, __ATOMIC_RELAXED);
+  }
+
+  if (stats->num_held < MAX_HELD) {
+    stats->held[stats->num_held].lock = lock;
+    stats->held[stats->num_held].since = now;
+    stats->num_held++;
+  }
+}
+
+/// Records a release.
+/// @param lock Lock that is about to be released.
+static void released(const void* lock, enum LockClass lock_class, unsigned int event_id) {
+  struct ThreadStats* stats = local;
+  if (stats == NULL) return;
+
+  // Locks are usually released in reverse order, so search from the top
+  for (size_t i = stats->num_held; i > 0; i--) {
+    if (stats->held[i - 1].lock != lock) continue;
+
+    uint64_t held = now_ns() - stats->held[i - 1].since;
+    histogram_record(&stats->classes[lock_class].hold, held);
+    if (lock_class == LOCK_CLASS_EVENT) __atomic_add_fetch(&event_stats(event_id)->hold_ns, held, __ATOMIC_RELAXED);
+
+    stats->held[i - 1] = stats->held[--stats->num_held];
+    return;
+  }
+}
+
+int lock_stats_mutex_lock(pthread_mutex_t* mutex, enum LockClass lock_class, unsigned int event_id) {
+  uint64_t start = now_ns();
+  int contended = 0;
+
+  int ret = pthread_mutex_trylock(mutex);
+  if (ret == EBUSY) {
+    contended = 1;
+    ret = pthread_mutex_lock(mutex);
+  }
+
+  if (ret == 0) acquired(mutex, lock_class, event_id, contended, start);
+  return ret;
+}
+
+int lock_stats_mutex_unlock(pthread_mutex_t* mutex, enum LockClass lock_class, unsigned int event_id) {
+  released(mutex, lock_class, event_id);
+  return pthread_mutex_unlock(mutex);
+}
+
+int lock_stats_rdlock(pthread_rwlock_t* rwl, enum LockClass lock_class) {
+  uint64_t start = now_ns();
+  int contended = 0;
+
+  int ret = pthread_rwlock_tryrdlock(rwl);
+  if (ret == EBUSY) {
+    contended = 1;
+    ret = pthread_rwlock_rdlock(rwl);
+  }
+
+  if (ret == 0) acquired(rwl, lock_class, 0, contended, start);
+  return ret;
+}
+
+int lock_stats_wrlock(pthread_rwlock_t* rwl, enum LockClass lock_class) {
+  uint64_t start = now_ns();
+  int contended = 0;
+
+  int ret = pthread_rwlock_trywrlock(rwl);
+  if (ret == EBUSY) {
+    contended = 1;
+    ret = pthread_rwlock_wrlock(rwl);
+  }
+
+  if (ret == 0) acquired(rwl, lock_class, 0, contended, start);
+  return ret;
+}
+
+int lock_stats_rwunlock(pthread_rwlock_t* rwl, enum LockClass lock_class) {
+  released(rwl, lock_class, 0);
+  return pthread_rwlock_unlock(rwl);
+}
+
+int lock_stats_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, enum LockClass lock_class) {
+  released(mutex, lock_class, 0);
+  int ret = pthread_cond_wait(cond, mutex);
+
+  // Waking up is not contention on the mutex, only a new hold starts
+  struct ThreadStats* stats = thread_stats();
+  if (stats != NULL && stats->num_held < MAX_HELD) {
+    stats->held[stats->num_held].lock = mutex;
+    stats->held[stats->num_held].since = now_ns();
+    stats->num_held++;
+  }
+
+  return ret;
+}
+
+/// Orders events by decreasing total wait.
+static int compare_wait(const void* a, const void* b) {
+  uint64_t wait_a = ((const struct EventStats*)a)->wait_ns;
+  uint64_t wait_b = ((const struct EventStats*)b)->wait_ns;
+  return wait_a < wait_b ? 1 : wait_a > wait_b ? -1 : 0;
+}
+
+void lock_stats_dump(int fd) {
+  static struct ClassStats totals[NUM_LOCK_CLASSES];
+
+  for (int i = 0; i < NUM_LOCK_CLASSES; i++) {
+    totals[i].acquisitions = 0;
+    totals[i].contended = 0;
+    histogram_init(&totals[i].wait);
+    histogram_init(&totals[i].hold);
+  }
+
+  pthread_mutex_lock(&all_threads_mutex);
+  for (struct ThreadStats* stats = all_threads; stats != NULL; stats = stats->next) {
+    for (int i = 0; i < NUM_LOCK_CLASSES; i++) {
+      totals[i].acquisitions += __atomic_load_n(&stats->classes[i].acquisitions, __ATOMIC_RELAXED);
+      totals[i].contended += __atomic_load_n(&stats->classes[i].contended, __ATOMIC_RELAXED);
+      histogram_merge(&totals[i].wait, &stats->classes[i].wait);
+      histogram_merge(&totals[i].hold, &stats->classes[i].hold);
+    }
+  }
+  pthread_mutex_unlock(&all_threads_mutex);
+
+  dprintf(fd, "Lock stats (ns):\n%-6s %12s %12s %10s %10s %10s %10s %10s %10s\n", "class", "acquired", "contended",
+          "wait_p50", "wait_p99", "wait_max", "hold_p50", "hold_p99", "hold_max");
+  for (int i = 0; i < NUM_LOCK_CLASSES; i++) {
+    struct ClassStats* stats = &totals[i];
+    dprintf(fd, "%-6s %12llu %12llu %10llu %10llu %10llu %10llu %10llu %10llu\n", class_names[i],
+            (unsigned long long)stats->acquisitions, (unsigned long long)stats->contended,
+            (unsigned long long)histogram_percentile(&stats->wait, 0.5),
+            (unsigned long long)histogram_percentile(&stats->wait, 0.99), (unsigned long long)stats->wait.max,
+            (unsigned long long)histogram_percentile(&stats->hold, 0.5),
+            (unsigned long long)histogram_percentile(&stats->hold, 0.99), (unsigned long long)stats->hold.max);
+  }
+
+  // Snapshot the event table so it can be sorted by total wait
+  static struct EventStats snapshot[HOT_EVENT_SLOTS + 1];
+  size_t count = 0;
+  for (size_t i = 0; i <= HOT_EVENT_SLOTS; i++) {
+    snapshot[count].acquisitions = __atomic_load_n(&events[i].acquisitions, __ATOMIC_RELAXED);
+    if (snapshot[count].acquisitions == 0) continue;
+
+    snapshot[count].id = i == HOT_EVENT_SLOTS ? 0 : __atomic_load_n(&events[i].id, __ATOMIC_RELAXED);
+    snapshot[count].contended = __atomic_load_n(&events[i].contended, __ATOMIC_RELAXED);
+    snapshot[count].wait_ns = __atomic_load_n(&events[i].wait_ns, __ATOMIC_RELAXED);
+    snapshot[count].hold_ns = __atomic_load_n(&events[i].hold_ns, __ATOMIC_RELAXED);
+    count++;
+  }
+  qsort(snapshot, count, sizeof(struct EventStats), compare_wait);
+
+  dprintf(fd, "Hot events (ns):\n%-6s %12s %12s %14s %14s\n", "event", "acquired", "contended", "wait_total",
+          "hold_total");
+  for (size_t i = 0; i < count && i < HOT_EVENTS_SHOWN; i++) {
+    char name[16];
+    if (snapshot[i].id == 0) {
+      snprintf(name, sizeof(name), "other");
+    } else {
+      snprintf(name, sizeof(name), "%u", snapshot[i].id - 1);
+    }
+
+    dprintf(fd, "%-6s %12llu %12llu %14llu %14llu\n", name, (unsigned long long)snapshot[i].acquisitions,
+            (unsigned long long)snapshot[i].contended, (unsigned long long)snapshot[i].wait_ns,
+            (unsigned long long)snapshot[i].hold_ns);
+  }
+}
+
+#endif  // LOCK_STATS
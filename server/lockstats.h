@@ -0,0 +1,68 @@
+#ifndef SERVER_LOCK_STATS_H
+#define SERVER_LOCK_STATS_H
+
+#include <pthread.h>
+
+/// Groups of locks whose contention is reported together.
+enum LockClass {
+  LOCK_CLASS_LIST,   /// event_list->rwl and the locks of its partitions.
+  LOCK_CLASS_EVENT,  /// struct Event mutexes, also reported per event.
+  LOCK_CLASS_QUEUE,  /// Mutex of the worker task queues.
+  NUM_LOCK_CLASSES
+};
+
+#ifdef LOCK_STATS
+
+/// Locks a mutex, recording the wait and the start of the hold.
+/// @param mutex Mutex to be locked.
+/// @param lock_class Class the mutex is reported under.
+/// @param event_id Event owning the mutex, only used by LOCK_CLASS_EVENT.
+/// @return Result of pthread_mutex_lock.
+int lock_stats_mutex_lock(pthread_mutex_t* mutex, enum LockClass lock_class, unsigned int event_id);
+
+/// Unlocks a mutex, recording how long it was held.
+/// @return Result of pthread_mutex_unlock.
+int lock_stats_mutex_unlock(pthread_mutex_t* mutex, enum LockClass lock_class, unsigned int event_id);
+
+/// Read-locks a rwlock, recording the wait and the start of the hold.
+/// @return Result of pthread_rwlock_rdlock.
+int lock_stats_rdlock(pthread_rwlock_t* rwl, enum LockClass lock_class);
+
+/// Write-locks a rwlock, recording the wait and the start of the hold.
+/// @return Result of pthread_rwlock_wrlock.
+int lock_stats_wrlock(pthread_rwlock_t* rwl, enum LockClass lock_class);
+
+/// Unlocks a rwlock, recording how long it was held.
+/// @return Result of pthread_rwlock_unlock.
+int lock_stats_rwunlock(pthread_rwlock_t* rwl, enum LockClass lock_class);
+
+/// Waits on a condition. The time spent waiting is not counted as held.
+/// @return Result of pthread_cond_wait.
+int lock_stats_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, enum LockClass lock_class);
+
+/// Writes the acquisitions, contended acquisitions and wait and hold times of
+/// every lock class, followed by the most contended events.
+/// @param fd File descriptor to write to.
+void lock_stats_dump(int fd);
+
+#define STAT_MUTEX_LOCK(mutex, lock_class, event_id) lock_stats_mutex_lock(mutex, lock_class, event_id)
+#define STAT_MUTEX_UNLOCK(mutex, lock_class, event_id) lock_stats_mutex_unlock(mutex, lock_class, event_id)
+#define STAT_RDLOCK(rwl, lock_class) lock_stats_rdlock(rwl, lock_class)
+#define STAT_WRLOCK(rwl, lock_class) lock_stats_wrlock(rwl, lock_class)
+#define STAT_RWUNLOCK(rwl, lock_class) lock_stats_rwunlock(rwl, lock_class)
+#define STAT_COND_WAIT(cond, mutex, lock_class) lock_stats_cond_wait(cond, mutex, lock_class)
+
+#else
+
+// Compiled out: the wrappers are the plain pthread calls
+#define STAT_MUTEX_LOCK(mutex, lock_class, event_id) pthread_mutex_lock(mutex)
+#define STAT_MUTEX_UNLOCK(mutex, lock_class, event_id) pthread_mutex_unlock(mutex)
+#define STAT_RDLOCK(rwl, lock_class) pthread_rwlock_rdlock(rwl)
+#define STAT_WRLOCK(rwl, lock_class) pthread_rwlock_wrlock(rwl)
+#define STAT_RWUNLOCK(rwl, lock_class) pthread_rwlock_unlock(rwl)
+#define STAT_COND_WAIT(cond, mutex, lock_class) pthread_cond_wait(cond, mutex)
+#define lock_stats_dump(fd) ((void)(fd))
+
+#endif  // LOCK_STATS
+
+#endif  // SERVER_LOCK_STATS_H
@@ -11,34 +11,47 @@
 
 #include "common/constants.h"
 #include "common/io.h"
+#include "common/trace.h"
+#include "dumper.h"
+#include "ioloop.h"
+#include "lockstats.h"
 #include "operations.h"
+#include "opstats.h"
+#include "placement.h"
+#include "registration.h"
+#include "scheduler.h"
+#include "subscriptions.h"
+#include "timerwheel.h"
 
 #define BUFFER_SIZE 1024
-#define MAX_SESSIONS 10
-
-int active_events[MAX_SESSIONS];
-int _index = 0;
-
-//SIG
-volatile sig_atomic_t sigurs1_detected = 0;
-int open_in_progress = 0;
-
-
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
-
+#define MAX_SESSIONS 32
+#define NUM_WORKERS 8
+#define ACCEPT_QUEUE_SIZE MAX_SESSIONS
+#define BUSY_RETRY_MS 100  // How long rejected clients are told to wait before registering again
+#define STATS_BUFFER_SIZE 65536
+#define STATS_HEADER_SIZE 32  // Room left before the stats table for its "0|<length>\n" header
+#define SESSION_IDLE_TIMEOUT_MS 300000  // Sessions without requests for this long are closed to free their slot
+#define REQUEST_DEADLINE_MS 10000       // Requests still queued after this long are failed instead of run
+#define TAG_REGISTER MAX_SESSIONS        // I/O tag of the register pipe, sessions use their slot
+#define TAG_WAKE (MAX_SESSIONS + 1)      // I/O tag of the wake pipe
+
+
+// Registrations waiting for a session slot, only touched by the host thread. Past this the host answers BUSY
 typedef struct {
-  char queue[MAX_SESSIONS][514];
+  char queue[ACCEPT_QUEUE_SIZE][514];
   int front, rear, count;
 } Queue;
 
 Queue producer_consumer; 
 char pipe_name[BUFFER_SIZE];
-
-void signal_handler(int signum){
-  sigurs1_detected = 1;
-  while (open_in_progress) sleep(1000);
-}
+unsigned int next_session = 0;
+int wake_pipe[2];  // Written by the workers when a session can be polled again
+int wake_pending = 0;  // Set by the worker that wrote the wake pipe, cleared by the host before it scans the sessions
+struct Session* sessions[MAX_SESSIONS] = {NULL};
+size_t num_sessions = 0;
+struct TimerWheel timers;  // Ticks are milliseconds, only touched by the host thread
+int pin_workers = 0;       // Workers are pinned and requests sent to the home node of their event
+enum IoBackend io_backend = IO_BACKEND_EPOLL;  // With io_uring, replies are written by the host in batches
 
 void initializeQueue() {
   producer_consumer.front = 0;
@@ -46,30 +59,29 @@ void initializeQueue() {
   producer_consumer.count = 0;
 }
 
-void enqueue(char *buf) {
-  pthread_mutex_lock(&mutex);
-  while (producer_consumer.count == MAX_SESSIONS) {
-      pthread_cond_wait(&cond, &mutex);
-  }
-  producer_consumer.rear = (producer_consumer.rear + 1) % MAX_SESSIONS;
-  strcpy(producer_consumer.queue[producer_consumer.rear], buf);
+/// Queues a registration.
+/// @param buf Registration, "<request pipe> <response pipe> [priority]".
+/// @return 0 if the registration was queued, 1 if the queue is full.
+int tryEnqueue(const char *buf) {
+  if (producer_consumer.count == ACCEPT_QUEUE_SIZE) return 1;
+
+  producer_consumer.rear = (producer_consumer.rear + 1) % ACCEPT_QUEUE_SIZE;
+  strncpy(producer_consumer.queue[producer_consumer.rear], buf, sizeof(producer_consumer.queue[0]) - 1);
+  producer_consumer.queue[producer_consumer.rear][sizeof(producer_consumer.queue[0]) - 1] = '\0';
   producer_consumer.count++;
-  pthread_cond_signal(&cond);
-  pthread_mutex_unlock(&mutex);
+  return 0;
 }
 
+/// Takes the oldest registration.
+/// @param buf Buffer of BUFFER_SIZE to copy the registration to.
+/// @return 0 if a registration was taken, 1 if the queue is empty.
+int dequeue(char *buf) {
+  if (producer_consumer.count == 0) return 1;
 
-char* dequeue() {
-  pthread_mutex_lock(&mutex);
-  while (producer_consumer.count == 0) {
-      pthread_cond_wait(&cond, &mutex);
-  }
-  char* msg = producer_consumer.queue[producer_consumer.front];
-  producer_consumer.front = (producer_consumer.front + 1) % MAX_SESSIONS;
+  strcpy(buf, producer_consumer.queue[producer_consumer.front]);
+  producer_consumer.front = (producer_consumer.front + 1) % ACCEPT_QUEUE_SIZE;
   producer_consumer.count--;
-  pthread_cond_signal(&cond);
-  pthread_mutex_unlock(&mutex);
-  return msg;
+  return 0;
 }
 
 enum OP_TYPE {
@@ -78,27 +90,68 @@ enum OP_TYPE {
   OP_SHOW,
   OP_LIST_EVENTS,
   OP_WAIT,
+  OP_SUBSCRIBE,
+  OP_RESERVE_BEST,
+  OP_CREATE_TEMPLATE,
+  OP_CREATE_BULK,
+  OP_FORK,
+  OP_LIST_PAGE,
+  OP_AVAILABILITY,
+  OP_SOLD_OUT,
+  OP_STATS,
+  OP_HOLD,
+  OP_CONFIRM,
+  OP_RELEASE,
+  OP_GET_RESERVATION,
+  OP_CANCEL,
+  OP_RESERVE_MULTI,
   OP_INVALID
 } op_type;
 
+// Names reported by the latency stats, in OP_TYPE order
+const char* const op_names[] = {"CREATE", "RESERVE", "SHOW", "LIST", "WAIT", "SUBSCRIBE", "RESERVE_BEST", "TEMPLATE",
+                                "CREATE_BULK", "FORK", "LIST_PAGE", "AVAILABILITY", "SOLD_OUT", "STATS", "HOLD", "CONFIRM",
+                                "RELEASE", "GET_RESERVATION", "CANCEL", "RESERVE_MULTI", "INVALID"};
+
 enum OP_TYPE getOperation (char* command) {
   if (!strcmp(command, "3")) return OP_CREATE;
   else if (!strcmp(command, "4")) return OP_RESERVE;
   else if (!strcmp(command, "5")) return OP_SHOW;
   else if (!strcmp(command, "6\n")) return OP_LIST_EVENTS;
-  else if (!strcmp(command, "WAIT\n")) return OP_WAIT;
+  else if (!strcmp(command, "16")) return OP_WAIT;
+  else if (!strcmp(command, "17")) return OP_HOLD;
+  else if (!strcmp(command, "18")) return OP_CONFIRM;
+  else if (!strcmp(command, "19")) return OP_RELEASE;
+  else if (!strcmp(command, "20")) return OP_GET_RESERVATION;
+  else if (!strcmp(command, "21")) return OP_CANCEL;
+  else if (!strcmp(command, "22")) return OP_RESERVE_MULTI;
+  else if (!strcmp(command, "7")) return OP_SUBSCRIBE;
+  else if (!strcmp(command, "8")) return OP_RESERVE_BEST;
+  else if (!strcmp(command, "9")) return OP_CREATE_TEMPLATE;
+  else if (!strcmp(command, "10")) return OP_CREATE_BULK;
+  else if (!strcmp(command, "11")) return OP_FORK;
+  else if (!strcmp(command, "12")) return OP_LIST_PAGE;
+  else if (!strcmp(command, "13")) return OP_AVAILABILITY;
+  else if (!strcmp(command, "14")) return OP_SOLD_OUT;
+  else if (!strcmp(command, "15\n")) return OP_STATS;
   else return OP_INVALID;
 }
 
-char** seperateElements(char* command) {
-  char** elements = malloc(sizeof(char*) * 10);
+char** seperateElements(char* command, size_t* num_elements) {
+  size_t count = 2;
+  for (char* c = command; *c != '\0'; c++) {
+    if (*c == '|') count++;
+  }
+
+  char** elements = calloc(count, sizeof(char*));
   char* token = strtok(command, "|");
-  int i = 0;
+  size_t i = 0;
   while (token != NULL) {
     elements[i] = token;
     i++;
     token = strtok(NULL, "|");
   }
+  *num_elements = i;
   return elements;
 }
 
@@ -117,144 +170,655 @@ void send_msg(int tx, char const *str) {
     }
 }
 
-void* executeRequest(void* arg) {
-  // Block SIGUSR1 in the worker threads
-  sigset_t mask;
-  sigemptyset(&mask);
-  sigaddset(&mask, SIGUSR1);
-  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+/// What the timer of a session is armed for.
+enum SessionTimer {
+  SESSION_TIMER_NONE,
+  SESSION_TIMER_IDLE,      /// Closes the session, armed while it is polled.
+  SESSION_TIMER_DEADLINE,  /// Fails the request if no worker took it yet.
+  SESSION_TIMER_WAIT       /// Replies to a WAIT and lets the session be polled again.
+};
+
+/// Client connected to the server.
+struct Session {
+  unsigned int id;
+  size_t slot;                    /// Index in sessions.
+  unsigned int priority;          /// Highest priority the requests of the session run at.
+  int rx;                         /// Non-blocking request pipe, read by the host thread.
+  int resp;                       /// Response pipe.
+  struct Subscriber* subscriber;  /// Pushes reservation notifications on the response pipe.
+  int busy;                       /// Whether a request of the session is queued, running or waiting, so it is not polled.
+  int armed;                      /// Whether a read of the request pipe is armed on the I/O loop.
+  char* reply;                    /// Reply left by the worker for the host to write, with io_uring.
+  size_t reply_len;               /// Number of bytes of the reply.
+  size_t reply_size;              /// Size of the reply buffer.
+  int writing;                    /// Whether the host has a write of the reply in flight, holding the reply lock.
+  uint64_t received;              /// When the request was read.
+  char request[BUFFER_SIZE];      /// Request being served.
+  struct Task task;               /// Queues the request for the workers.
+  struct Timer timer;             /// Host timer of the session.
+  enum SessionTimer timer_kind;   /// What the timer is armed for.
+};
+
+/// Gets the priority an operation runs at, for sessions allowed the highest one.
+/// @param op Operation of the request.
+/// @return Priority of the operation.
+unsigned int opPriority(enum OP_TYPE op) {
+  switch (op) {
+    case OP_RESERVE:
+    case OP_RESERVE_BEST:
+    case OP_SUBSCRIBE:
+    case OP_AVAILABILITY:
+    case OP_SOLD_OUT:
+    case OP_HOLD:
+    case OP_CONFIRM:
+    case OP_RELEASE:
+    case OP_CANCEL:
+    case OP_RESERVE_MULTI:
+      return PRIORITY_HIGH;
+
+    case OP_CREATE:
+    case OP_SHOW:
+    case OP_LIST_EVENTS:
+    case OP_LIST_PAGE:
+    case OP_GET_RESERVATION:
+    case OP_INVALID:
+      return PRIORITY_NORMAL;
+
+    case OP_WAIT:
+    case OP_CREATE_TEMPLATE:
+    case OP_CREATE_BULK:
+    case OP_FORK:
+    case OP_STATS:
+    default:
+      return PRIORITY_LOW;
+  }
+}
 
+/// Gets the node whose workers should run a request, the home node of the event it names.
+/// @param op Operation of the request.
+/// @param args Arguments of the request, from the '|' after the operation code.
+/// @return Home node of the event, 0 if workers are not pinned or the request names no event.
+unsigned int requestNode(enum OP_TYPE op, const char* args) {
+  if (!pin_workers || *args != '|') return 0;
+
+  switch (op) {
+    case OP_CREATE:
+    case OP_RESERVE:
+    case OP_SHOW:
+    case OP_SUBSCRIBE:
+    case OP_RESERVE_BEST:
+    case OP_FORK:
+    case OP_AVAILABILITY:
+    case OP_SOLD_OUT:
+    case OP_HOLD:
+    case OP_CONFIRM:
+    case OP_RELEASE:
+    case OP_GET_RESERVATION:
+    case OP_CANCEL:
+      break;
+
+    // The first event comes after the template of a bulk create and the event count of a package
+    case OP_CREATE_BULK:
+    case OP_RESERVE_MULTI:
+      args = strchr(args + 1, '|');
+      if (args == NULL) return 0;
+      break;
+
+    case OP_LIST_EVENTS:
+    case OP_WAIT:
+    case OP_CREATE_TEMPLATE:
+    case OP_LIST_PAGE:
+    case OP_STATS:
+    case OP_INVALID:
+    default:
+      return 0;
+  }
 
-  char req_pipe[BUFFER_SIZE];
-  char buffer[BUFFER_SIZE];
-  strcpy(buffer, dequeue());
+  return placement_home_node((unsigned int)strtoul(args + 1, NULL, 10));
+}
 
-  strcpy(req_pipe, "../client/");
-  strcat(req_pipe, strtok(buffer, " "));
-  char resp_pipe[BUFFER_SIZE];
-  strcpy(resp_pipe, "../client/");
-  strcat(resp_pipe, strtok(NULL, " "));
-  
+/// Gets the current tick of the host timers.
+/// @return Milliseconds on CLOCK_MONOTONIC.
+uint64_t timerNow() { return op_stats_now() / 1000000; }
+
+/// Arms the timer of a session, replacing what it was armed for.
+/// @param session Session owning the timer.
+/// @param kind What the timer is armed for.
+/// @param delay_ms Milliseconds until it fires.
+void armSessionTimer(struct Session* session, enum SessionTimer kind, uint64_t delay_ms) {
+  timer_wheel_cancel(&timers, &session->timer);
+  session->timer_kind = kind;
+  timer_wheel_add(&timers, &session->timer, delay_ms);
+}
 
-  char response[BUFFER_SIZE];
-  snprintf(response, sizeof(response), "%d", producer_consumer.count + 1);
-  strcat(response, "\n");
+void closeSession(struct Session* session);
+
+/// Fires the timer of a session, on the host thread.
+/// @param timer Timer of the session.
+void onSessionTimer(struct Timer* timer) {
+  struct Session* session = timer->arg;
+  enum SessionTimer kind = session->timer_kind;
+  session->timer_kind = SESSION_TIMER_NONE;
+
+  switch (kind) {
+    case SESSION_TIMER_IDLE:
+      fprintf(stderr, "[INFO]: session %u idle, closing\n", session->id);
+      closeSession(session);
+      break;
+
+    case SESSION_TIMER_DEADLINE:
+      // A worker that already took the request replies to it, however late
+      if (scheduler_cancel(&session->task) != 0) break;
+      fprintf(stderr, "[INFO]: session %u request past its deadline\n", session->id);
+      send_msg(session->resp, "1\n");
+      session->busy = 0;
+      break;
+
+    case SESSION_TIMER_WAIT:
+      send_msg(session->resp, "0\n");
+      session->busy = 0;
+      break;
+
+    case SESSION_TIMER_NONE:
+    default:
+      break;
+  }
+}
 
-  //Open pipe to write the session id
-  open_in_progress = 1;
-  int tx = open(pipe_name, O_WRONLY);
-  if (tx == -1) {
-      fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
-      exit(EXIT_FAILURE);
+/// Sets up a session: sends the session id and opens the pipes. Never waits on the client.
+/// @param registration Registration of the client, modified.
+/// @return Newly created session, NULL on failure.
+struct Session* admitSession(char* registration) {
+  char req_pipe[BUFFER_SIZE];
+  char resp_pipe[BUFFER_SIZE];
+  unsigned int priority;
+  if (registration_parse(registration, req_pipe, resp_pipe, sizeof(req_pipe), &priority)) {
+      fprintf(stderr, "[ERR]: invalid registration\n");
+      return NULL;
   }
-  send_msg(tx, response);   
 
-  close(tx);
+  struct Session* session = calloc(1, sizeof(struct Session));
+  if (session == NULL) return NULL;
+  session->priority = priority;
+  session->task.arg = session;
+  session->timer.arg = session;
+  session->timer.callback = onSessionTimer;
+
+  session->resp = registration_open_response(resp_pipe);
+  if (session->resp == -1) {
+      free(session);
+      return NULL;
+  }
 
-  // Open request pipe to read commands
-  int rx = open(req_pipe, O_RDONLY);
-  if (rx == -1) {
+  // Opened before the id is sent, so the client never waits for a reader
+  session->rx = open(req_pipe, O_RDONLY | O_NONBLOCK);
+  if (session->rx == -1) {
       fprintf(stderr, "[ERR]: open req failed: %s\n", strerror(errno));
-      exit(EXIT_FAILURE);
+      close(session->resp);
+      free(session);
+      return NULL;
   }
 
-  int resp = open(resp_pipe, O_WRONLY);
-  if (resp == -1) {
-      fprintf(stderr, "[ERR]: open resp failed: %s\n", strerror(errno));
-      exit(EXIT_FAILURE);
+  session->id = ++next_session;
+  char response[BUFFER_SIZE];
+  snprintf(response, sizeof(response), "%u\n", session->id);
+  send_msg(session->resp, response);
+
+  session->subscriber = subscriber_create(resp_pipe);
+  TRACE_EVENT(TRACE_SESSION, 0, session->id);
+  return session;
+}
+
+/// Ends a session once the client closed it.
+/// @param session Session to be closed, not in a worker.
+void closeSession(struct Session* session) {
+  sessions[session->slot] = NULL;
+  num_sessions--;
+  timer_wheel_cancel(&timers, &session->timer);
+  io_loop_forget(session->slot);
+  if (session->writing) subscriber_end_reply(session->subscriber);
+  subscriber_close(session->subscriber);
+  close(session->rx);
+  close(session->resp);
+  free(session->reply);
+  free(session);
+}
+
+/// Takes the next request of a session, read by the I/O loop, and queues it at its priority.
+/// @param session Session whose read completed, not in a worker.
+/// @param data Bytes read.
+/// @param command Number of bytes read, 0 at end of file, -errno on error.
+/// @return 0 if the session is still open, 1 if the client closed it.
+int readRequest(struct Session* session, const char* data, ssize_t command) {
+  if (command == 0) {
+      fprintf(stderr, "[INFO]: pipe closed\n");
+      return 1;
+  } else if (command < 0) {
+      fprintf(stderr, "[ERR]: read failed: %s\n", strerror((int)-command));
+      return 1;
   }
 
-  while (1) {
-    memset(response, 0, sizeof(response));
-    ssize_t command = read(rx, buffer, BUFFER_SIZE - 1);
-    if (command == 0) {
-        fprintf(stderr, "[INFO]: pipe closed\n");
-        break;
-    } else if (command == -1) {
-        fprintf(stderr, "[ERR]: read failed: %s\n", strerror(errno));
-        return 1;
-    }
+  session->received = op_stats_now();
+  fprintf(stderr, "[INFO]: received %zd B\n", command);
+  memcpy(session->request, data, (size_t)command);
+  session->request[command] = 0;
+
+  // Only the operation code is needed to pick the queue, the worker parses the rest
+  char code[8] = {0};
+  size_t len = strcspn(session->request, "|");
+  if (len < sizeof(code)) memcpy(code, session->request, len);
+  enum OP_TYPE op = getOperation(code);
+
+  timer_wheel_cancel(&timers, &session->timer);
+  session->busy = 1;
+
+  // A WAIT only parks the session on the wheel, no worker sleeps through it
+  if (op == OP_WAIT) {
+    unsigned long delay = session->request[len] == '|' ? strtoul(session->request + len + 1, NULL, 10) : 0;
+    printf("Waiting...\n");
+    armSessionTimer(session, SESSION_TIMER_WAIT, delay);
+    return 0;
+  }
 
-    fprintf(stderr, "[INFO]: received %zd B\n", command);
-    buffer[command] = 0;
-    fputs(buffer, stdout);
+  unsigned int priority = opPriority(op);
+  scheduler_submit(&session->task, priority > session->priority ? priority : session->priority,
+                   requestNode(op, session->request + len));
+  armSessionTimer(session, SESSION_TIMER_DEADLINE, REQUEST_DEADLINE_MS);
+  return 0;
+}
 
-    char** elements = seperateElements(buffer);
-    int event_id, ret;
-    size_t num_rows, num_cols, num_coords;
-    char* endptr;
-    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
-    char buffer[BUFFER_SIZE-10];
+/// Replies to the request of a session, on a worker.
+/// @note With io_uring the reply is only appended to the session, the host writes it with the replies of other
+///       sessions once the worker is done. Either way, notifications wait until the reply is written.
+/// @param session Session being served.
+/// @param str Reply to be sent.
+void sendReply(struct Session* session, const char* str) {
+  if (io_backend != IO_BACKEND_URING) {
+    subscriber_begin_reply(session->subscriber);
+    send_msg(session->resp, str);
+    subscriber_end_reply(session->subscriber);
+    return;
+  }
 
-    switch (getOperation(elements[0])) {
-      case OP_CREATE:
-        event_id = atoi(elements[1]);
-        num_rows = strtoul(elements[2], &endptr, 10);
-        num_cols = strtoul(elements[3], &endptr, 10);
+  size_t len = strlen(str);
+  if (len == 0) return;
+  if (session->reply_len + len > session->reply_size) {
+    size_t size = session->reply_len + len > 2 * session->reply_size ? session->reply_len + len : 2 * session->reply_size;
+    char* reply = realloc(session->reply, size);
+    if (reply == NULL) {
+      fprintf(stderr, "[ERR]: reply dropped, out of memory\n");
+      return;
+    }
+    session->reply = reply;
+    session->reply_size = size;
+  }
 
-        ret = ems_create(event_id, num_rows, num_cols);
+  memcpy(session->reply + session->reply_len, str, len);
+  session->reply_len += len;
+  fprintf(stdout, "sent: %s\n", str);
+}
 
-        if (ret != 0) fprintf(stderr, "Failed to create event\n");
-        snprintf(response, sizeof(response), "%d\n", ret);
-        break;
-      
-      case OP_RESERVE:
+/// Runs the request of a session and replies to it.
+/// @param session Session whose request was taken from the queue.
+void handleRequest(struct Session* session) {
+  char response[BUFFER_SIZE] = {0};
+  int resp = session->resp;
+  struct Subscriber* subscriber = session->subscriber;
+
+  op_stats_begin(session->received);
+  TRACE_EVENT(TRACE_REQUEST, 0, op_stats_now() - session->received);
+  fputs(session->request, stdout);
+
+  size_t num_elements;
+  char** elements = seperateElements(session->request, &num_elements);
+  enum OP_TYPE op = getOperation(elements[0]);
+  op_stats_mark(STAGE_PARSE);
+
+  int event_id, ret;
+  unsigned int first_id, delay;
+  char* stats;
+  size_t header_len;
+  size_t num_rows, num_cols, num_coords, num_events;
+  char* endptr;
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  unsigned int event_ids[MAX_PACKAGE_EVENTS], reservation_ids[MAX_PACKAGE_EVENTS];
+  size_t num_seats[MAX_PACKAGE_EVENTS];
+  char buffer[BUFFER_SIZE-10];
+
+  switch (op) {
+    case OP_CREATE:
+      event_id = atoi(elements[1]);
+      num_rows = strtoul(elements[2], &endptr, 10);
+      num_cols = strtoul(elements[3], &endptr, 10);
+
+      ret = ems_create(event_id, num_rows, num_cols);
+
+      if (ret != 0) fprintf(stderr, "Failed to create event\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+    
+    case OP_RESERVE:
+      // Each seat takes two fields after the count, a request short of them is rejected
+      ret = num_elements < 3;
+      if (ret == 0) {
         event_id = atoi(elements[1]);
         num_coords = strtoul(elements[2], &endptr, 10);
+        ret = num_coords > MAX_RESERVATION_SIZE || num_elements < 3 + 2 * num_coords;
+      }
 
+      if (ret == 0) {
         for (int i = 0; i < num_coords; i++) {
           xs[i] = strtoul(elements[3 + 2*i], &endptr, 10);
           ys[i] = strtoul(elements[4 + 2*i], &endptr, 10);
         }
 
         ret = ems_reserve(event_id, num_coords, xs, ys);
+      }
 
-        if (ret != 0) fprintf(stderr, "Failed to reserve seats\n");
+      if (ret != 0) fprintf(stderr, "Failed to reserve seats\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+
+      break;
+
+    case OP_SHOW:
+      event_id = atoi(elements[1]);
+
+      ret = ems_show(resp, event_id, buffer, sizeof(buffer));
+      if (ret != 0) fprintf(stderr, "Failed to show event\n");
+      snprintf(response, sizeof(response), "%d|%s\n", ret, ret == 0 ? buffer : "");
+      break;
+
+    case OP_LIST_EVENTS:
+      ret = ems_list_events(resp, buffer, sizeof(buffer));
+      if (ret != 0) fprintf(stderr, "Failed to list events\n");
+      snprintf(response, sizeof(response), "%d|%s\n", ret, ret == 0 ? buffer : "");
+      break;
+
+    case OP_LIST_PAGE:
+      // An "-" cursor starts from the first event
+      if (strcmp(elements[1], "-") != 0) first_id = (unsigned int)strtoul(elements[1], &endptr, 10);
+      num_coords = strtoul(elements[2], &endptr, 10);
+      num_rows = strtoul(elements[3], &endptr, 10);
+      num_cols = strtoul(elements[4], &endptr, 10);
+
+      ret = ems_list_events_page(strcmp(elements[1], "-") != 0 ? &first_id : NULL, num_coords, num_rows, num_cols,
+                                 buffer, sizeof(buffer));
+      if (ret != 0) fprintf(stderr, "Failed to list events\n");
+      snprintf(response, sizeof(response), "%d|%s\n", ret, ret == 0 ? buffer : "");
+      break;
+    
+    case OP_WAIT:
+      // Served by the host timers, never queued
+      break;
+
+    case OP_SUBSCRIBE:
+      event_id = atoi(elements[1]);
+
+      ret = subscriber == NULL ? 1 : ems_subscribe((unsigned int)event_id, subscriber);
+      if (ret != 0) fprintf(stderr, "Failed to subscribe to event\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+
+    case OP_RESERVE_BEST:
+      event_id = atoi(elements[1]);
+      num_coords = strtoul(elements[2], &endptr, 10);
+
+      ret = ems_reserve_best((unsigned int)event_id, num_coords, &num_rows, &num_cols);
+
+      if (ret != 0) {
+        fprintf(stderr, "Failed to reserve best seats\n");
         snprintf(response, sizeof(response), "%d\n", ret);
+      } else {
+        snprintf(response, sizeof(response), "%d|%zu|%zu\n", ret, num_rows, num_cols);
+      }
+      break;
 
-        break;
-
-      case OP_SHOW:
+    case OP_HOLD:
+      ret = num_elements < 4;
+      if (ret == 0) {
         event_id = atoi(elements[1]);
+        delay = (unsigned int)strtoul(elements[2], &endptr, 10);
+        num_coords = strtoul(elements[3], &endptr, 10);
+        ret = num_coords > MAX_RESERVATION_SIZE || num_elements < 4 + 2 * num_coords;
+      }
 
-        ret = ems_show(resp, event_id, buffer);
-        if (ret != 0) fprintf(stderr, "Failed to show event\n");
-        snprintf(response, sizeof(response), "%d|%s\n", ret, buffer);
-        break;
+      if (ret == 0) {
+        for (size_t i = 0; i < num_coords; i++) {
+          xs[i] = strtoul(elements[4 + 2*i], &endptr, 10);
+          ys[i] = strtoul(elements[5 + 2*i], &endptr, 10);
+        }
 
-      case OP_LIST_EVENTS:
-        ret = ems_list_events(resp, buffer);
-        if (ret != 0) fprintf(stderr, "Failed to list events\n");
-        snprintf(response, sizeof(response), "%d|%s\n", ret, buffer);
-        break;
-      
-      case OP_WAIT:
-        unsigned int delay = strtoul(elements[1], &endptr, 10);
-        if (delay > 0) {
-          printf("Waiting...\n");
-          sleep(delay);
+        ret = ems_hold((unsigned int)event_id, delay, num_coords, xs, ys, &first_id);
+      }
+
+      if (ret != 0) {
+        fprintf(stderr, "Failed to hold seats\n");
+        snprintf(response, sizeof(response), "%d\n", ret);
+      } else {
+        snprintf(response, sizeof(response), "%d|%u\n", ret, first_id);
+      }
+      break;
+
+    case OP_CONFIRM:
+    case OP_RELEASE:
+      event_id = atoi(elements[1]);
+      first_id = (unsigned int)strtoul(elements[2], &endptr, 10);
+
+      ret = op == OP_CONFIRM ? ems_confirm((unsigned int)event_id, first_id)
+                             : ems_release((unsigned int)event_id, first_id);
+
+      if (ret != 0) fprintf(stderr, "Failed to end hold\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+
+    case OP_GET_RESERVATION:
+      event_id = atoi(elements[1]);
+      first_id = (unsigned int)strtoul(elements[2], &endptr, 10);
+
+      ret = ems_get_reservation((unsigned int)event_id, first_id, buffer, sizeof(buffer));
+      if (ret != 0) fprintf(stderr, "Failed to get reservation\n");
+      snprintf(response, sizeof(response), "%d|%s\n", ret, ret == 0 ? buffer : "");
+      break;
+
+    case OP_CANCEL:
+      event_id = atoi(elements[1]);
+      first_id = (unsigned int)strtoul(elements[2], &endptr, 10);
+
+      ret = ems_cancel((unsigned int)event_id, first_id);
+      if (ret != 0) fprintf(stderr, "Failed to cancel reservation\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+
+    case OP_RESERVE_MULTI:
+      num_events = num_elements < 2 ? 0 : strtoul(elements[1], &endptr, 10);
+
+      // Each event is listed as "event|count|row|col...", its seats after those of the previous one. A request short
+      // of the fields its counts claim is rejected
+      ret = num_events == 0 || num_events > MAX_PACKAGE_EVENTS;
+      num_coords = 0;
+      for (size_t i = 0, pos = 2; i < num_events && ret == 0; i++) {
+        if (num_elements < pos + 2) {
+          ret = 1;
+          break;
         }
-        break;
+        event_ids[i] = (unsigned int)strtoul(elements[pos], &endptr, 10);
+        num_seats[i] = strtoul(elements[pos + 1], &endptr, 10);
+        pos += 2;
 
-      case OP_INVALID:
+        if (num_seats[i] > MAX_RESERVATION_SIZE - num_coords || num_seats[i] > (num_elements - pos) / 2) {
+          ret = 1;
+          break;
+        }
+
+        for (size_t j = 0; j < num_seats[i]; j++, pos += 2, num_coords++) {
+          xs[num_coords] = strtoul(elements[pos], &endptr, 10);
+          ys[num_coords] = strtoul(elements[pos + 1], &endptr, 10);
+        }
+      }
+
+      if (ret == 0) ret = ems_reserve_multi(num_events, event_ids, num_seats, xs, ys, reservation_ids);
+
+      if (ret != 0) {
+        fprintf(stderr, "Failed to reserve package\n");
+        snprintf(response, sizeof(response), "%d\n", ret);
         break;
+      }
+
+      // Replies with the id of the reservation in each event, in request order, which always fits
+      num_rows = (size_t)snprintf(response, sizeof(response), "%d", ret);
+      for (size_t i = 0; i < num_events; i++) {
+        num_rows += (size_t)snprintf(response + num_rows, sizeof(response) - num_rows, "|%u", reservation_ids[i]);
+      }
+      snprintf(response + num_rows, sizeof(response) - num_rows, "\n");
+      break;
 
-      default:
+    case OP_CREATE_TEMPLATE:
+      ret = num_elements < 5;
+      if (ret == 0) {
+        event_id = atoi(elements[1]);
+        num_rows = strtoul(elements[2], &endptr, 10);
+        num_cols = strtoul(elements[3], &endptr, 10);
+        num_coords = strtoul(elements[4], &endptr, 10);
+        ret = num_coords > MAX_RESERVATION_SIZE || num_elements < 5 + 2 * num_coords;
+      }
+
+      if (ret == 0) {
+        for (size_t i = 0; i < num_coords; i++) {
+          xs[i] = strtoul(elements[5 + 2*i], &endptr, 10);
+          ys[i] = strtoul(elements[6 + 2*i], &endptr, 10);
+        }
+
+        ret = ems_create_template((unsigned int)event_id, num_rows, num_cols, num_coords, xs, ys);
+      }
+
+      if (ret != 0) fprintf(stderr, "Failed to create template\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+
+    case OP_CREATE_BULK:
+      event_id = atoi(elements[1]);
+      first_id = (unsigned int)strtoul(elements[2], &endptr, 10);
+      num_coords = strtoul(elements[3], &endptr, 10);
+
+      // A trailing "|1" only checks the range, the router does so on every shard before creating any event
+      ret = ems_create_bulk((unsigned int)event_id, first_id, num_coords,
+                            num_elements > 4 && strtoul(elements[4], &endptr, 10) != 0);
+
+      if (ret != 0) fprintf(stderr, "Failed to create events\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+
+    case OP_FORK:
+      event_id = atoi(elements[1]);
+      first_id = (unsigned int)strtoul(elements[2], &endptr, 10);
+
+      ret = ems_fork((unsigned int)event_id, first_id);
+
+      if (ret != 0) fprintf(stderr, "Failed to fork event\n");
+      snprintf(response, sizeof(response), "%d\n", ret);
+      break;
+
+    case OP_AVAILABILITY:
+      event_id = atoi(elements[1]);
+      num_rows = strtoul(elements[2], &endptr, 10);
+
+      ret = ems_availability((unsigned int)event_id, num_rows, &num_coords, &num_cols);
+
+      if (ret != 0) {
+        fprintf(stderr, "Failed to get availability\n");
+        snprintf(response, sizeof(response), "%d\n", ret);
+      } else {
+        snprintf(response, sizeof(response), "%d|%zu|%zu\n", ret, num_coords, num_cols);
+      }
+      break;
+
+    case OP_SOLD_OUT:
+      event_id = atoi(elements[1]);
+
+      ret = ems_availability((unsigned int)event_id, 0, &num_coords, &num_cols);
+
+      if (ret != 0) {
+        fprintf(stderr, "Failed to get availability\n");
+        snprintf(response, sizeof(response), "%d\n", ret);
+      } else {
+        snprintf(response, sizeof(response), "%d|%d\n", ret, num_coords == 0);
+      }
+      break;
+
+    case OP_STATS:
+      // The table does not fit in a response, so the reply is "0|<length>\n" followed by the table. The header is
+      // put right before the table so both go out as a single reply
+      stats = malloc(STATS_HEADER_SIZE + STATS_BUFFER_SIZE);
+      if (stats == NULL) {
+        snprintf(response, sizeof(response), "1\n");
         break;
-    }
-  
-    send_msg(resp, response);
+      }
+
+      op_stats_format(op_names, OP_INVALID + 1, stats + STATS_HEADER_SIZE, STATS_BUFFER_SIZE);
+      header_len = (size_t)snprintf(response, sizeof(response), "0|%zu\n", strlen(stats + STATS_HEADER_SIZE));
+      memcpy(stats + STATS_HEADER_SIZE - header_len, response, header_len);
+      sendReply(session, stats + STATS_HEADER_SIZE - header_len);
+      response[0] = '\0';
+      free(stats);
+      break;
 
+    case OP_INVALID:
+      break;
+
+    default:
+      break;
   }
-  close(rx);
-  close(resp);
 
-  open_in_progress = 0;
+  op_stats_mark(STAGE_EXECUTE);
+  sendReply(session, response);
+  op_stats_mark(STAGE_REPLY);
+  TRACE_EVENT(TRACE_REPLY, (unsigned int)atoi(elements[0]), (uint64_t)atoi(response));
+  op_stats_end(op);
+  free(elements);
+}
+
+void* executeRequest(void* arg) {
+  size_t worker = *(size_t*)arg;
+  unsigned int node = pin_workers ? placement_pin_worker(worker) : 0;
+
+  // Workers take requests of any session, most urgent first, those of their node on ties
+  while (1) {
+    struct Session* session = scheduler_take(node)->arg;
+    handleRequest(session);
+
+    // The host only reads idle sessions, so it is woken to read this one again. Workers finishing before the host
+    // got to the sessions share a single wake
+    __atomic_store_n(&session->busy, 0, __ATOMIC_SEQ_CST);
+    char wake = 0;
+    if (!__atomic_exchange_n(&wake_pending, 1, __ATOMIC_SEQ_CST) && write(wake_pipe[1], &wake, 1) == -1 &&
+        errno != EAGAIN) {
+      fprintf(stderr, "[ERR]: wake failed: %s\n", strerror(errno));
+    }
+  }
+
+  return NULL;
 }
 
 int main(int argc, char* argv[]) {
+  const char* dump_path = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "ad:u")) != -1) {
+    if (opt == 'a') {
+      pin_workers = 1;
+    } else if (opt == 'd') {
+      dump_path = optarg;
+    } else if (opt == 'u') {
+      io_backend = IO_BACKEND_URING;
+    } else {
+      fprintf(stderr, "Usage: %s [-a] [-u] [-d dump_file] <pipe_path> [delay]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  argc -= optind - 1;
+  argv += optind - 1;
   if (argc < 2 || argc > 3) {
-    fprintf(stderr, "Usage: %s\n <pipe_path> [delay]\n", argv[0]);
+    fprintf(stderr, "Usage: %s [-a] [-u] [-d dump_file] <pipe_path> [delay]\n", argv[0]);
     return 1;
   }
 
@@ -279,8 +843,6 @@ int main(int argc, char* argv[]) {
   strcpy(pipe_name, "../");
   strcat(pipe_name, argv[1]);
 
-  int n_sessions = 0;
-
   //Creates pipe (register fifo)
   if (unlink(pipe_name) != 0 && errno != ENOENT) {
       fprintf(stderr, "[ERR]: unlink failed: %s\n", strerror(errno));
@@ -292,59 +854,157 @@ int main(int argc, char* argv[]) {
       return 1;
   }
 
+  // Subscribers may vanish while notifications are in flight
+  signal(SIGPIPE, SIG_IGN);
+
+  // SIGUSR1 is only taken by the dumper, every thread created from here on inherits the mask
+  sigset_t usr1;
+  sigemptyset(&usr1);
+  sigaddset(&usr1, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &usr1, NULL);
+
+  if (dumper_start(dump_path, op_names, OP_INVALID + 1)) {
+    fprintf(stderr, "Failed to start the dumper\n");
+    return 1;
+  }
+
+  if (subscriptions_init()) {
+    fprintf(stderr, "Failed to start the notifier\n");
+    return 1;
+  }
+
   // Initialize the producer-consumer queue
   initializeQueue();
 
-  // Create worker threads
-  pthread_t worker_threads[MAX_SESSIONS];
-  for (int i = 0; i < MAX_SESSIONS; i++) {
-    if (pthread_create(&worker_threads[i], NULL, executeRequest, NULL) != 0) {
+  if (pipe(wake_pipe) != 0 || fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK) == -1 ||
+      fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK) == -1) {
+      fprintf(stderr, "[ERR]: pipe failed: %s\n", strerror(errno));
+      return 1;
+  }
+
+  // Without the topology workers are left unpinned, on a single node pinning alone still applies
+  if (pin_workers && placement_init() != 0) pin_workers = 0;
+  if (pin_workers) fprintf(stderr, "[INFO]: pinning workers over %u NUMA nodes\n", placement_num_nodes());
+
+  // Create worker threads. Sessions do not hold one, the pool only bounds how many requests run at once
+  pthread_t worker_threads[NUM_WORKERS];
+  static size_t worker_ids[NUM_WORKERS];
+  for (size_t i = 0; i < NUM_WORKERS; i++) {
+    worker_ids[i] = i;
+    if (pthread_create(&worker_threads[i], NULL, executeRequest, &worker_ids[i]) != 0) {
       fprintf(stderr, "error creating thread.\n");
       return -1;
     }
   }
-  //TODO; eventual locks
-  open_in_progress = 0;
+  // Holding a write end means the register pipe never reports EOF between clients
+  int r_register_pipe = open(pipe_name, O_RDONLY | O_NONBLOCK);
+  int w_register_pipe = r_register_pipe == -1 ? -1 : open(pipe_name, O_WRONLY);
+  int flags = r_register_pipe == -1 ? -1 : fcntl(r_register_pipe, F_GETFL);
+  if (w_register_pipe == -1 || flags == -1 || fcntl(r_register_pipe, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+      fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
+      return 1;
+  }
+
+  if (io_loop_init(&io_backend, MAX_SESSIONS + 2, BUFFER_SIZE - 1) != 0 ||
+      io_loop_read(TAG_REGISTER, r_register_pipe) != 0 || io_loop_read(TAG_WAKE, wake_pipe[0]) != 0) {
+      fprintf(stderr, "[ERR]: I/O loop setup failed\n");
+      return 1;
+  }
+
+  timer_wheel_init(&timers, timerNow());
+  struct IoCompletion completions[MAX_SESSIONS + 2];
+
+  // Registrations are single lines shorter than PIPE_BUF, so they never interleave. A read may land on a partial line
+  char buffer[2 * BUFFER_SIZE];
+  size_t pending = 0;
   while (1) {
-    if (sigurs1_detected == 1){
-      fprintf(stdout, "SIGUSR1 detected. Now showing active events:\n");
-      for (int i = 0; i < MAX_SESSIONS; i++){
-        int id = active_events[_index];
-        if (id == -1) continue;
-        fprintf(stdout, "ID: %d. Current state of seats:\n", active_events[_index]);
-        char buf[BUFFER_SIZE];
-        ems_show(stdout, id, buf);
-        sigurs1_detected = 0;
+    timer_wheel_advance(&timers, timerNow());
+
+    // The host reads every request, workers only ever see whole ones already queued by priority
+    __atomic_store_n(&wake_pending, 0, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < MAX_SESSIONS; i++) {
+      struct Session* session = sessions[i];
+      if (session == NULL || __atomic_load_n(&session->busy, __ATOMIC_SEQ_CST)) continue;
+
+      // Back from a worker or just admitted: the deadline no longer applies, idleness does
+      if (session->timer_kind != SESSION_TIMER_IDLE) {
+        armSessionTimer(session, SESSION_TIMER_IDLE, SESSION_IDLE_TIMEOUT_MS);
       }
+
+      // Replies go out in the same submission as the reads armed here, notifications wait for their completion
+      if (session->reply_len > 0 && !session->writing) {
+        subscriber_begin_reply(session->subscriber);
+        if (io_loop_write(i, session->resp, session->reply, session->reply_len) == 0) {
+          session->reply_len = 0;
+          session->writing = 1;
+        } else {
+          subscriber_end_reply(session->subscriber);
+        }
+      }
+      if (!session->armed && io_loop_read(i, session->rx) == 0) session->armed = 1;
     }
-    open_in_progress = 1;
-    int r_register_pipe = open(pipe_name, O_RDONLY);
-    if (r_register_pipe == -1) {
-        fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
-        return 1;
-    }
-    char buffer[BUFFER_SIZE];
-    //Read from pipe
-    fprintf(stdout, "[INFO]: waiting for input\n");
-    ssize_t ret = read(r_register_pipe, buffer, BUFFER_SIZE - 1);
-    if (ret == 0) {
-      close(r_register_pipe);
-      open_in_progress = 0;
-      continue;
-    } else if (ret == -1) {
-      fprintf(stderr, "[ERR]: read failed: %s\n", strerror(errno));
-      return 1;
-    }
-    printf("cllo\n");
 
-    fprintf(stderr, "[INFO]: received %zd B\n", ret);
-    buffer[ret] = 0;
-    fputs(buffer, stdout); 
+    int num_completions = io_loop_wait(timer_wheel_timeout(&timers), completions, MAX_SESSIONS + 2);
+    if (num_completions == -1) return 1;
+
+    for (int i = 0; i < num_completions; i++) {
+      struct IoCompletion* completion = &completions[i];
+
+      if (completion->write) {
+        if (completion->len < 0) fprintf(stderr, "[ERR]: write failed: %s\n", strerror((int)-completion->len));
+        sessions[completion->tag]->writing = 0;
+        subscriber_end_reply(sessions[completion->tag]->subscriber);
+      } else if (completion->tag == TAG_WAKE) {
+        if (io_loop_read(TAG_WAKE, wake_pipe[0]) != 0) return 1;
+      } else if (completion->tag == TAG_REGISTER) {
+        if (completion->len < 0) {
+          fprintf(stderr, "[ERR]: read failed: %s\n", strerror((int)-completion->len));
+          return 1;
+        }
 
-    enqueue(buffer);
+        fprintf(stderr, "[INFO]: received %zd B\n", completion->len);
+        memcpy(buffer + pending, completion->data, (size_t)completion->len);
+        pending += (size_t)completion->len;
+        buffer[pending] = 0;
+
+        char* line = buffer;
+        char* end;
+        while ((end = strchr(line, '\n')) != NULL) {
+          *end = '\0';
+          fputs(line, stdout);
+          fputc('\n', stdout);
+
+          // Under overload the client is told to come back later instead of waiting in the pipe
+          if (tryEnqueue(line)) {
+            fprintf(stderr, "[INFO]: accept queue full, rejecting\n");
+            registration_reject(line, BUSY_RETRY_MS);
+          }
+          line = end + 1;
+        }
 
-    close(r_register_pipe);
-    open_in_progress = 0;
+        // Keep a partial line for the next read, drop one that can never fit
+        pending = strlen(line);
+        if (pending >= BUFFER_SIZE - 1) pending = 0;
+        memmove(buffer, line, pending);
+        if (io_loop_read(TAG_REGISTER, r_register_pipe) != 0) return 1;
+      } else {
+        struct Session* session = sessions[completion->tag];
+        session->armed = 0;
+        if (readRequest(session, completion->data, completion->len) != 0) closeSession(session);
+      }
+    }
+
+    // Free slots go to the oldest registrations
+    char registration[BUFFER_SIZE];
+    for (size_t i = 0; i < MAX_SESSIONS && num_sessions < MAX_SESSIONS; i++) {
+      if (sessions[i] != NULL) continue;
+      if (dequeue(registration)) break;
+
+      sessions[i] = admitSession(registration);
+      if (sessions[i] == NULL) continue;
+      sessions[i]->slot = i;
+      num_sessions++;
+    }
   }
 
   //TODO: Close Server
@@ -1,27 +1,129 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "common/constants.h"
 #include "common/io.h"
+#include "common/trace.h"
 #include "eventlist.h"
+#include "lockstats.h"
 #include "operations.h"
+#include "opstats.h"
+#include "textfmt.h"
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_us = 0;
 
-/// Gets the event with the given ID from the state.
+/// Waits to simulate a real system accessing a costly memory resource.
+static void access_delay() {
+  if (state_access_delay_us == 0) return;  // A zero-length nanosleep still costs a timer slack
+
+  struct timespec delay = {0, state_access_delay_us * 1000};
+  nanosleep(&delay, NULL);  // Should not be removed
+}
+
+/// Gets the event with the given ID from the hash index of the state.
 /// @note Will wait to simulate a real system accessing a costly memory resource.
 /// @param event_id The ID of the event to get.
-/// @param from First node to be searched.
-/// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
-static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode* from, struct ListNode* to) {
-  struct timespec delay = {0, state_access_delay_us * 1000};
-  nanosleep(&delay, NULL);  // Should not be removed
+static struct Event* find_event_with_delay(unsigned int event_id) {
+  uint64_t start = op_stats_now();
+  TRACE_EVENT(TRACE_LOOKUP_BEGIN, 0, event_id);
+  access_delay();
+
+  struct Event* event = find_event(event_list, event_id);
+  op_stats_add(STAGE_LOOKUP, op_stats_now() - start);
+  TRACE_EVENT(TRACE_LOOKUP_END, event != NULL, event_id);
+  return event;
+}
+
+/// Gets several events from the hash index of the state in a single batch.
+/// @note Will wait once to simulate a real system accessing a costly memory resource, however many events are asked.
+/// @param num_events Number of events to get.
+/// @param event_ids Array of the IDs of the events to get.
+/// @param events Array to store the events in, NULL for the ones not found.
+/// @return 0 if every event was found, 1 otherwise.
+static int find_events_with_delay(size_t num_events, const unsigned int* event_ids, struct Event** events) {
+  uint64_t start = op_stats_now();
+  TRACE_EVENT(TRACE_LOOKUP_BEGIN, 0, event_ids[0]);
+  access_delay();
+
+  int missing = 0;
+  for (size_t i = 0; i < num_events; i++) {
+    events[i] = find_event(event_list, event_ids[i]);
+    if (events[i] == NULL) missing = 1;
+  }
+  op_stats_add(STAGE_LOOKUP, op_stats_now() - start);
+  TRACE_EVENT(TRACE_LOOKUP_END, !missing, event_ids[0]);
+  return missing;
+}
+
+/// Locks the templates of the state, counting the wait towards the lock stage of the current request.
+/// @param write Whether the templates are going to be modified.
+/// @return 0 if the list was locked, an error number otherwise.
+static int lock_list(int write) {
+  uint64_t start = op_stats_now();
+  int ret = write ? STAT_WRLOCK(&event_list->rwl, LOCK_CLASS_LIST) : STAT_RDLOCK(&event_list->rwl, LOCK_CLASS_LIST);
+  op_stats_add(STAGE_LOCK, op_stats_now() - start);
+  TRACE_EVENT(TRACE_LOCK, 0, 0);
+  return ret;
+}
+
+/// Locks a partition of the state, counting the wait towards the lock stage of the current request.
+/// @param partition Partition to be locked.
+/// @param write Whether the partition is going to be modified.
+/// @return 0 if the partition was locked, an error number otherwise.
+static int lock_partition(struct EventPartition* partition, int write) {
+  uint64_t start = op_stats_now();
+  int ret = write ? STAT_WRLOCK(&partition->rwl, LOCK_CLASS_LIST) : STAT_RDLOCK(&partition->rwl, LOCK_CLASS_LIST);
+  op_stats_add(STAGE_LOCK, op_stats_now() - start);
+  TRACE_EVENT(TRACE_LOCK, 0, 0);
+  return ret;
+}
+
+#define ALL_PARTITIONS ((1u << EVENT_LIST_PARTITIONS) - 1)  // Mask of every partition of the state
+
+/// Gets the mask of the partition an event id falls in.
+static unsigned int partition_bit(unsigned int event_id) { return 1u << (event_id % EVENT_LIST_PARTITIONS); }
+
+/// Unlocks a set of partitions of the state.
+/// @param partitions Mask of the partitions, bit i standing for partition i.
+static void unlock_partitions(unsigned int partitions) {
+  for (size_t i = EVENT_LIST_PARTITIONS; i > 0; i--) {
+    if (partitions & (1u << (i - 1))) STAT_RWUNLOCK(&event_list->partitions[i - 1].rwl, LOCK_CLASS_LIST);
+  }
+}
+
+/// Locks a set of partitions of the state in ascending order.
+/// @note Every caller locking more than one partition goes through here, so the order is the same for all of them.
+/// @param partitions Mask of the partitions, bit i standing for partition i.
+/// @param write Whether the partitions are going to be modified.
+/// @return 0 if every partition was locked, an error number otherwise, with none of them locked.
+static int lock_partitions(unsigned int partitions, int write) {
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    if (!(partitions & (1u << i))) continue;
+
+    int ret = lock_partition(&event_list->partitions[i], write);
+    if (ret != 0) {
+      unlock_partitions(partitions & ((1u << i) - 1));
+      return ret;
+    }
+  }
+  return 0;
+}
 
-  return get_event(event_list, event_id, from, to);
+/// Locks an event, counting the wait towards the lock stage of the current request.
+/// @param event Event to be locked.
+/// @return 0 if the event was locked, an error number otherwise.
+static int lock_event(struct Event* event) {
+  uint64_t start = op_stats_now();
+  int ret = STAT_MUTEX_LOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  op_stats_add(STAGE_LOCK, op_stats_now() - start);
+  TRACE_EVENT(TRACE_LOCK, 1, event->id);
+  return ret;
 }
 
 /// Gets the index of a seat.
@@ -32,6 +134,69 @@ static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode
 /// @return Index of the seat.
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
+/// Bounded text buffer filled in a single pass.
+struct OutBuffer {
+  char* data;     /// Destination, always kept NUL-terminated.
+  size_t size;    /// Size of the destination.
+  size_t len;     /// Number of characters written.
+  int truncated;  /// Set once something did not fit.
+};
+
+/// Appends a string to a bounded buffer.
+/// @param out Buffer to append to.
+/// @param str String to be appended.
+static void out_str(struct OutBuffer* out, const char* str) {
+  size_t len = strlen(str);
+  if (out->truncated || out->len + len >= out->size) {
+    out->truncated = 1;
+    return;
+  }
+
+  memcpy(out->data + out->len, str, len + 1);
+  out->len += len;
+}
+
+/// Appends an unsigned integer in decimal to a bounded buffer.
+/// @param out Buffer to append to.
+/// @param value Value to be appended.
+static void out_uint(struct OutBuffer* out, size_t value) {
+  char digits[TEXT_UINT_SIZE];
+  size_t len = text_uint(digits, value);
+  if (out->truncated || out->len + len >= out->size) {
+    out->truncated = 1;
+    return;
+  }
+
+  memcpy(out->data + out->len, digits, len);
+  out->len += len;
+  out->data[out->len] = '\0';
+}
+
+/// Appends the reservation ids of seats in decimal to a bounded buffer, each followed by a separator.
+/// @param out Buffer to append to.
+/// @param map Seat map to be read.
+/// @param first Index of the first seat.
+/// @param count Number of seats.
+/// @param separator Character written after each seat.
+/// @return Number of seats appended, less than count if the buffer filled up.
+static size_t out_seats(struct OutBuffer* out, const struct SeatMap* map, size_t first, size_t count, char separator) {
+  size_t done = 0;
+  while (done < count && !out->truncated) {
+    size_t run;
+    const unsigned int* seats = seat_map_run(map, first + done, &run);
+    if (run > count - done) run = count - done;
+
+    size_t len;
+    size_t written = text_uints(out->data + out->len, out->size - out->len - 1, seats, run, separator, &len);
+    out->len += len;
+    done += written;
+    if (written < run) out->truncated = 1;
+  }
+
+  out->data[out->len] = '\0';
+  return done;
+}
+
 int ems_init(unsigned int delay_us) {
   if (event_list != NULL) {
     fprintf(stderr, "EMS state has already been initialized\n");
@@ -50,100 +215,117 @@ int ems_terminate() {
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+  if (STAT_WRLOCK(&event_list->rwl, LOCK_CLASS_LIST) != 0) {
     fprintf(stderr, "Error locking list rwl\n");
     return 1;
   }
 
-  free_list(event_list);
-  pthread_rwlock_unlock(&event_list->rwl);
-  return 0;
-}
-
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
-  if (event_list == NULL) {
-    fprintf(stderr, "EMS state must be initialized\n");
-    return 1;
-  }
-
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+  if (lock_partitions(ALL_PARTITIONS, 1) != 0) {
     fprintf(stderr, "Error locking list rwl\n");
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
     return 1;
   }
 
-  if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
-    fprintf(stderr, "Event already exists\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    return 1;
-  }
+  // The locks live inside the list, so they are released before the list is freed
+  struct EventList* list = event_list;
+  unlock_partitions(ALL_PARTITIONS);
+  event_list = NULL;
+  STAT_RWUNLOCK(&list->rwl, LOCK_CLASS_LIST);
+  pthread_rwlock_destroy(&list->rwl);
+  free_list(list);
+  return 0;
+}
 
+/// Allocates a new event, optionally laid out from existing seats.
+/// @param event_id Id of the event to be created.
+/// @param num_rows Number of rows of the event to be created.
+/// @param num_cols Number of columns of the event to be created.
+/// @param layout Seats shared copy-on-write by the new event, NULL for an empty venue.
+/// @param reservations Number of reservations already present in the layout.
+/// @return Newly created event, NULL on failure.
+static struct Event* new_event(unsigned int event_id, size_t num_rows, size_t num_cols, const struct SeatMap* layout,
+                               unsigned int reservations) {
   struct Event* event = malloc(sizeof(struct Event));
 
   if (event == NULL) {
     fprintf(stderr, "Error allocating memory for event\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    return 1;
+    return NULL;
   }
 
   event->id = event_id;
   event->rows = num_rows;
   event->cols = num_cols;
-  event->reservations = 0;
-  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
-    pthread_rwlock_unlock(&event_list->rwl);
+  event->reservations = reservations;
+  event->blocked = 0;
+  event->free_seats = num_rows * num_cols;
+  event->free_runs = NULL;
+  event->subscribers = NULL;
+  event->by_reservation = NULL;
+  event->holds = NULL;
+  event->holds_expire = UINT64_MAX;
+
+  event->row_free = malloc((num_rows == 0 ? 1 : num_rows) * sizeof(size_t));
+  if (event->row_free == NULL) {
+    fprintf(stderr, "Error allocating memory for event occupancy\n");
     free(event);
-    return 1;
+    return NULL;
   }
-  event->data = calloc(num_rows * num_cols, sizeof(unsigned int));
+  for (size_t i = 0; i < num_rows; i++) event->row_free[i] = num_cols;
 
-  if (event->data == NULL) {
-    fprintf(stderr, "Error allocating memory for event data\n");
-    pthread_rwlock_unlock(&event_list->rwl);
+  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
+    free(event->row_free);
     free(event);
-    return 1;
+    return NULL;
   }
 
-  if (append_to_list(event_list, event) != 0) {
-    fprintf(stderr, "Error appending event to list\n");
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event->data);
+  int ret = layout == NULL ? seat_map_init(&event->data, num_rows * num_cols) : seat_map_share(&event->data, layout);
+  if (ret != 0) {
+    fprintf(stderr, "Error allocating memory for event data\n");
+    pthread_mutex_destroy(&event->mutex);
+    free(event->row_free);
     free(event);
-    return 1;
+    return NULL;
   }
 
-  pthread_rwlock_unlock(&event_list->rwl);
-  return 0;
+  return event;
 }
 
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
-  if (event_list == NULL) {
-    fprintf(stderr, "EMS state must be initialized\n");
-    return 1;
-  }
-
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    fprintf(stderr, "Error locking list rwl\n");
-    return 1;
-  }
-
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
-
-  pthread_rwlock_unlock(&event_list->rwl);
+/// Copies the free seat counters of the layout an event was created from.
+/// @param event Event created from the layout.
+/// @param free_seats Number of free seats of the layout.
+/// @param row_free Free seats of each row of the layout.
+static void copy_occupancy(struct Event* event, size_t free_seats, const size_t* row_free) {
+  event->free_seats = free_seats;
+  memcpy(event->row_free, row_free, event->rows * sizeof(size_t));
+}
 
-  if (event == NULL) {
-    fprintf(stderr, "Event not found\n");
-    return 1;
+/// Makes every given seat writable, so that a reservation can no longer fail midway.
+/// @param event Event holding the seats, with its mutex held.
+/// @param num_seats Number of seats.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return 0 if every seat is writable, 1 otherwise.
+static int prepare_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
+  for (size_t i = 0; i < num_seats; i++) {
+    if (seat_map_ref(&event->data, seat_index(event, xs[i], ys[i])) == NULL) {
+      fprintf(stderr, "Error allocating memory for event data\n");
+      return 1;
+    }
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    fprintf(stderr, "Error locking mutex\n");
-    return 1;
-  }
+  return 0;
+}
 
+/// Checks that seats are free and makes them and their index entry writable, so that writing them can no longer fail.
+/// @param event Event holding the seats, with its mutex held.
+/// @param num_seats Number of seats.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @return 0 if the seats can be taken, 1 if a seat is out of bounds or taken or memory ran out.
+static int check_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys) {
   for (size_t i = 0; i < num_seats; i++) {
     if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
       fprintf(stderr, "Seat out of bounds\n");
-      pthread_mutex_unlock(&event->mutex);
       return 1;
     }
   }
@@ -154,9 +336,8 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
         continue;
       }
 
-      if (event->data[i] != 0) {
+      if (seat_map_get(&event->data, i) != 0) {
         fprintf(stderr, "Seat already reserved\n");
-        pthread_mutex_unlock(&event->mutex);
         return 1;
       }
 
@@ -164,117 +345,1225 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
     }
   }
 
+  if (prepare_seats(event, num_seats, xs, ys) != 0) return 1;
+
+  if (event->by_reservation != NULL &&
+      reservation_index_begin(event->by_reservation, event->reservations + 1, num_seats) == NULL) {
+    fprintf(stderr, "Error allocating memory for reservation index\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/// Writes a new reservation over seats that passed check_seats, keeping the occupancy counters in step.
+/// @param event Event holding the seats, with its mutex held since the check.
+/// @param num_seats Number of seats.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @param seats Array of num_seats to store the indices of the distinct seats taken in, NULL if not needed.
+/// @param num_taken Pointer to the variable to store the number of distinct seats taken in.
+/// @return Id of the reservation.
+static unsigned int write_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys, size_t* seats,
+                                size_t* num_taken) {
+  // The room was made by check_seats, so this finds it without allocating
+  size_t* indexed = NULL;
+  if (event->by_reservation != NULL) {
+    indexed = reservation_index_begin(event->by_reservation, event->reservations + 1, num_seats);
+  }
+
   unsigned int reservation_id = ++event->reservations;
 
+  size_t taken = 0;
+  for (size_t i = 0; i < num_seats; i++) {
+    size_t index = seat_index(event, xs[i], ys[i]);
+    unsigned int* seat = seat_map_ref(&event->data, index);
+    if (*seat == reservation_id) continue;  // Seat listed twice
+
+    *seat = reservation_id;
+    if (seats != NULL) seats[taken] = index;
+    if (indexed != NULL) indexed[taken] = index;
+    taken++;
+    __atomic_store_n(&event->row_free[xs[i] - 1], event->row_free[xs[i] - 1] - 1, __ATOMIC_RELAXED);
+    if (event->free_runs != NULL) free_runs_set(event->free_runs, xs[i], ys[i], 0);
+  }
+  __atomic_store_n(&event->free_seats, event->free_seats - taken, __ATOMIC_RELAXED);
+  if (indexed != NULL) reservation_index_end(event->by_reservation, reservation_id, taken);
+
+  *num_taken = taken;
+  return reservation_id;
+}
+
+/// Writes a new reservation over free seats, keeping the occupancy counters in step.
+/// @param event Event holding the seats, with its mutex held.
+/// @param num_seats Number of seats.
+/// @param xs Array of rows of the seats.
+/// @param ys Array of columns of the seats.
+/// @param seats Array of num_seats to store the indices of the distinct seats taken in, NULL if not needed.
+/// @param num_taken Pointer to the variable to store the number of distinct seats taken in.
+/// @return Id of the reservation, 0 if a seat is out of bounds or taken or memory ran out.
+static unsigned int take_seats(struct Event* event, size_t num_seats, size_t* xs, size_t* ys, size_t* seats,
+                               size_t* num_taken) {
+  if (check_seats(event, num_seats, xs, ys) != 0) return 0;
+  return write_seats(event, num_seats, xs, ys, seats, num_taken);
+}
+
+/// Frees the seats of a reservation, keeping the occupancy counters and the reservation index in step.
+/// @param event Event holding the seats, with its mutex held.
+/// @param reservation_id Id of the reservation.
+/// @param seats Indices of the seats, all taken and distinct.
+/// @param num_seats Number of seats.
+/// @return 0 if the seats were freed, 1 if memory ran out and none was.
+static int release_seats(struct Event* event, unsigned int reservation_id, const size_t* seats, size_t num_seats) {
+  for (size_t i = 0; i < num_seats; i++) {
+    if (seat_map_ref(&event->data, seats[i]) == NULL) {
+      fprintf(stderr, "Error allocating memory for event data\n");
+      return 1;
+    }
+  }
+
   for (size_t i = 0; i < num_seats; i++) {
-    event->data[seat_index(event, xs[i], ys[i])] = reservation_id;
+    size_t row = seats[i] / event->cols;
+    *seat_map_ref(&event->data, seats[i]) = 0;
+    __atomic_store_n(&event->row_free[row], event->row_free[row] + 1, __ATOMIC_RELAXED);
+    if (event->free_runs != NULL) free_runs_set(event->free_runs, row + 1, seats[i] % event->cols + 1, 1);
   }
+  __atomic_store_n(&event->free_seats, event->free_seats + num_seats, __ATOMIC_RELAXED);
+  if (event->by_reservation != NULL) reservation_index_remove(event->by_reservation, reservation_id);
 
-  pthread_mutex_unlock(&event->mutex);
   return 0;
 }
 
-int ems_show(int out_fd, unsigned int event_id, char* buffer) {
+/// Unlinks a hold from its event and frees it, leaving its seats as they are.
+/// @param event Event of the hold, with its mutex held.
+/// @param link Link pointing to the hold.
+static void remove_hold(struct Event* event, struct Hold** link) {
+  struct Hold* hold = *link;
+  *link = hold->next;
+  free(hold);
+
+  uint64_t next = UINT64_MAX;
+  for (struct Hold* current = event->holds; current != NULL; current = current->next) {
+    if (current->expires < next) next = current->expires;
+  }
+  __atomic_store_n(&event->holds_expire, next, __ATOMIC_RELAXED);
+}
+
+/// Finds a hold of an event.
+/// @param event Event of the hold, with its mutex held.
+/// @param hold_id Id of the hold.
+/// @return Link pointing to the hold, NULL if there is none.
+static struct Hold** find_hold(struct Event* event, unsigned int hold_id) {
+  for (struct Hold** link = &event->holds; *link != NULL; link = &(*link)->next) {
+    if ((*link)->id == hold_id) return link;
+  }
+
+  return NULL;
+}
+
+/// Releases the holds of an event that expired.
+/// @note Events without holds pay a single pointer check, so every seat access can sweep lazily.
+/// @param event Event to be swept, with its mutex held.
+static void expire_holds(struct Event* event) {
+  if (event->holds == NULL) return;
+
+  uint64_t now = op_stats_now();
+  if (now < event->holds_expire) return;
+
+  uint64_t next = UINT64_MAX;
+  struct Hold** link = &event->holds;
+  while (*link != NULL) {
+    struct Hold* hold = *link;
+
+    // A hold whose seats could not be freed stays, to be retried on the next access
+    if (hold->expires <= now && release_seats(event, hold->id, hold->seats, hold->num_seats) == 0) {
+      *link = hold->next;
+      free(hold);
+      continue;
+    }
+
+    if (hold->expires < next) next = hold->expires;
+    link = &hold->next;
+  }
+  __atomic_store_n(&event->holds_expire, next, __ATOMIC_RELAXED);
+}
+
+/// Locks an event and releases its expired holds.
+/// @param event Event to be locked.
+/// @return 0 if the event was locked, an error number otherwise.
+static int lock_event_swept(struct Event* event) {
+  int ret = lock_event(event);
+  if (ret == 0) expire_holds(event);
+  return ret;
+}
+
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+  // Only the partition of the id is locked, creates of ids in other partitions go on in parallel
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 1) != 0) {
     fprintf(stderr, "Error locking list rwl\n");
     return 1;
   }
 
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  if (find_event_with_delay(event_id) != NULL) {
+    fprintf(stderr, "Event already exists\n");
+    STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+    return 1;
+  }
+
+  struct Event* event = new_event(event_id, num_rows, num_cols, NULL, 0);
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  // An empty venue has nothing to scan, so its index is kept from the first reservation on
+  if (event != NULL && (event->by_reservation = reservation_index_create(NULL, 0, 0)) == NULL) {
+    fprintf(stderr, "Error allocating memory for reservation index\n");
+    free_event(event);
+    event = NULL;
+  }
 
   if (event == NULL) {
-    fprintf(stderr, "Event not found\n");
+    STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    fprintf(stderr, "Error locking mutex\n");
+  if (append_to_list(event_list, event) != 0) {
+    fprintf(stderr, "Error appending event to list\n");
+    STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+    free_event(event);
+    return 1;
+  }
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+  return 0;
+}
+
+int ems_create_template(unsigned int template_id, size_t num_rows, size_t num_cols, size_t num_blocked, size_t* xs,
+                        size_t* ys) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct Template* template = malloc(sizeof(struct Template));
+  if (template == NULL) {
+    fprintf(stderr, "Error allocating memory for template\n");
     return 1;
   }
 
-  char aux1[1000] = {0};
-  char aux2[16];
+  template->id = template_id;
+  template->rows = num_rows;
+  template->cols = num_cols;
+  template->reservations = num_blocked > 0;
+  template->free_seats = num_rows * num_cols;
+
+  template->row_free = malloc((num_rows == 0 ? 1 : num_rows) * sizeof(size_t));
+  if (template->row_free == NULL) {
+    fprintf(stderr, "Error allocating memory for template occupancy\n");
+    free(template);
+    return 1;
+  }
+  for (size_t i = 0; i < num_rows; i++) template->row_free[i] = num_cols;
+
+  if (seat_map_init(&template->data, num_rows * num_cols) != 0) {
+    fprintf(stderr, "Error allocating memory for template data\n");
+    free(template->row_free);
+    free(template);
+    return 1;
+  }
+
+  // Blocked seats form the first reservation of every event made from the template
+  for (size_t i = 0; i < num_blocked; i++) {
+    if (xs[i] <= 0 || xs[i] > num_rows || ys[i] <= 0 || ys[i] > num_cols) {
+      fprintf(stderr, "Seat out of bounds\n");
+      seat_map_destroy(&template->data);
+      free(template->row_free);
+      free(template);
+      return 1;
+    }
 
-  
-  for (size_t i = 1; i <= event->rows; i++) {
-    for (size_t j = 1; j <= event->cols; j++) {
-      memset(aux2, 0, sizeof(aux2));
-      snprintf(aux2, sizeof(aux2), "%d", event->data[seat_index(event, i, j)]);
-      strcat(aux1, aux2);
-      strcat(aux1, " ");
+    unsigned int* seat = seat_map_ref(&template->data, (xs[i] - 1) * num_cols + ys[i] - 1);
+    if (seat == NULL) {
+      fprintf(stderr, "Error allocating memory for template data\n");
+      seat_map_destroy(&template->data);
+      free(template->row_free);
+      free(template);
+      return 1;
+    }
+    if (*seat == 0) {
+      template->free_seats--;
+      template->row_free[xs[i] - 1]--;
     }
+    *seat = 1;
+  }
+
+  if (lock_list(1) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    seat_map_destroy(&template->data);
+    free(template->row_free);
+    free(template);
+    return 1;
   }
-  snprintf(buffer, sizeof(buffer), "%d|%d|", event->rows, event->cols);
-  strcat(buffer, aux1);
-  strcat(buffer, "\n");
-  pthread_mutex_unlock(&event->mutex);
+
+  if (find_template(event_list, template_id) != NULL) {
+    fprintf(stderr, "Template already exists\n");
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
+    seat_map_destroy(&template->data);
+    free(template->row_free);
+    free(template);
+    return 1;
+  }
+
+  template->next = event_list->templates;
+  event_list->templates = template;
+
+  STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
   return 0;
 }
 
-int ems_list_events(int out_fd, char* buffer) {
-  int n_events = 0;
-  char aux1[1000] = {0};
-  char aux2[16];
+int ems_create_bulk(unsigned int template_id, unsigned int first_id, size_t count, int check_only) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+  if (count == 0 || count - 1 > UINT_MAX - first_id) {
+    fprintf(stderr, "Invalid event id range\n");
+    return 1;
+  }
+
+  // The batch holds the write lock of its partitions, so it is kept short for the sessions waiting on them
+  if (count > MAX_BULK_EVENTS) {
+    fprintf(stderr, "Too many events in a bulk creation\n");
+    return 1;
+  }
+
+  unsigned int partitions = 0;
+  for (size_t i = 0; i < count && partitions != ALL_PARTITIONS; i++) {
+    partitions |= partition_bit(first_id + (unsigned int)i);
+  }
+
+  // Templates are never removed, so reading them is enough to build events from one
+  if (lock_list(0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Template* template = find_template(event_list, template_id);
+  if (template == NULL) {
+    fprintf(stderr, "Template not found\n");
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
+    return 1;
+  }
+
+  if (lock_partitions(partitions, 1) != 0) {
     fprintf(stderr, "Error locking list rwl\n");
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
     return 1;
   }
 
-  struct ListNode* to = event_list->tail;
-  struct ListNode* current = event_list->head;
+  // The whole batch pays for a single access to the state
+  access_delay();
 
-  if (current == NULL) {
-    char buff[] = "No events\n";
-    ssize_t bytes_written = write(out_fd, buff, strlen(buff));
-    if (bytes_written == -1) {
-      perror("Error writing to file descriptor");
-      pthread_rwlock_unlock(&event_list->rwl);
+  for (size_t i = 0; i < count; i++) {
+    if (find_event(event_list, first_id + (unsigned int)i) != NULL) {
+      fprintf(stderr, "Event already exists\n");
+      unlock_partitions(partitions);
+      STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
       return 1;
     }
+  }
 
-    pthread_rwlock_unlock(&event_list->rwl);
+  if (check_only) {
+    unlock_partitions(partitions);
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
     return 0;
   }
 
-  while (1) {
-    n_events++;
-    char buff[] = "Event: ";
-    if (print_str(out_fd, buff)) {
-      perror("Error writing to file descriptor");
-      pthread_rwlock_unlock(&event_list->rwl);
-      return 1;
+  struct Event** events = malloc(count * sizeof(struct Event*));
+  struct ListNode** nodes = malloc(count * sizeof(struct ListNode*));
+  if (events == NULL || nodes == NULL) {
+    fprintf(stderr, "Error allocating memory for events\n");
+    free(events);
+    free(nodes);
+    unlock_partitions(partitions);
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
+    return 1;
+  }
+
+  size_t created = 0;
+  for (; created < count; created++) {
+    nodes[created] = malloc(sizeof(struct ListNode));
+    if (nodes[created] == NULL) break;
+    events[created] = new_event(first_id + (unsigned int)created, template->rows, template->cols, &template->data,
+                                template->reservations);
+    if (events[created] == NULL) {
+      free(nodes[created]);
+      break;
     }
+    events[created]->blocked = template->reservations;
+    copy_occupancy(events[created], template->free_seats, template->row_free);
+  }
 
-    char id[16];
-    memset(aux2, 0, sizeof(aux2));
-    snprintf(aux2, sizeof(aux2), "%d", current->event->id);
-    strcat(aux1, aux2);
-    strcat(aux1, " ");
+  // Everything that can fail happens before the first event is appended, so the batch is created whole or not at all
+  size_t added[EVENT_LIST_PARTITIONS] = {0};
+  for (size_t i = 0; i < count; i++) added[(first_id + (unsigned int)i) % EVENT_LIST_PARTITIONS]++;
 
-    if (current == to) {
-      break;
+  int ret = created < count;
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS && ret == 0; i++) {
+    if (added[i] > 0) ret = reserve_partition(&event_list->partitions[i], added[i]);
+  }
+
+  if (ret != 0) {
+    fprintf(stderr, "Error allocating memory for events\n");
+    while (created > 0) {
+      created--;
+      free_event(events[created]);
+      free(nodes[created]);
+    }
+    free(events);
+    free(nodes);
+    unlock_partitions(partitions);
+    STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++) append_node(event_list, nodes[i], events[i]);
+
+  free(events);
+  free(nodes);
+  unlock_partitions(partitions);
+  STAT_RWUNLOCK(&event_list->rwl, LOCK_CLASS_LIST);
+  return 0;
+}
+
+int ems_fork(unsigned int event_id, unsigned int new_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  unsigned int partitions = partition_bit(event_id) | partition_bit(new_id);
+  if (lock_partitions(partitions, 1) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  if (find_event_with_delay(new_id) != NULL) {
+    fprintf(stderr, "Event already exists\n");
+    unlock_partitions(partitions);
+    return 1;
+  }
+
+  struct Event* source = find_event(event_list, event_id);
+  if (source == NULL) {
+    fprintf(stderr, "Event not found\n");
+    unlock_partitions(partitions);
+    return 1;
+  }
+
+  if (lock_event_swept(source) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    unlock_partitions(partitions);
+    return 1;
+  }
+
+  // Only the chunk table is copied while the live event is locked
+  struct Event* event = new_event(new_id, source->rows, source->cols, &source->data, source->reservations);
+  if (event != NULL) {
+    event->blocked = source->blocked;
+    copy_occupancy(event, source->free_seats, source->row_free);
+  }
+
+  if (event != NULL && source->by_reservation != NULL &&
+      (event->by_reservation = reservation_index_copy(source->by_reservation)) == NULL) {
+    fprintf(stderr, "Error allocating memory for reservation index\n");
+    free_event(event);
+    event = NULL;
+  }
+
+  // Holds belong to the checkout of the source, their seats are free in the clone
+  for (struct Hold* hold = source->holds; hold != NULL && event != NULL; hold = hold->next) {
+    if (release_seats(event, hold->id, hold->seats, hold->num_seats) != 0) {
+      free_event(event);
+      event = NULL;
     }
+  }
 
-    current = current->next;
+  STAT_MUTEX_UNLOCK(&source->mutex, LOCK_CLASS_EVENT, source->id);
+
+  if (event == NULL) {
+    unlock_partitions(partitions);
+    return 1;
   }
 
-  snprintf(buffer, sizeof(buffer), "%d", n_events);
-  strcat(buffer, "|");
-  strcat(buffer, aux1);
-  strcat(buffer, "\n");
+  if (append_to_list(event_list, event) != 0) {
+    fprintf(stderr, "Error appending event to list\n");
+    unlock_partitions(partitions);
+    free_event(event);
+    return 1;
+  }
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  unlock_partitions(partitions);
   return 0;
-}
\ No newline at end of file
+}
+
+int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  size_t taken;
+  unsigned int reservation_id = take_seats(event, num_seats, xs, ys, NULL, &taken);
+  if (reservation_id == 0) {
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    return 1;
+  }
+
+  if (event->subscribers != NULL) {
+    struct Notification notification = {event_id, reservation_id, taken};
+    subscription_publish(&event->subscribers, &notification);
+  }
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  return 0;
+}
+
+int ems_reserve_multi(size_t num_events, const unsigned int* event_ids, const size_t* num_seats, size_t* xs,
+                      size_t* ys, unsigned int* reservation_ids) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (num_events == 0 || num_events > MAX_PACKAGE_EVENTS) {
+    fprintf(stderr, "Invalid number of events\n");
+    return 1;
+  }
+
+  struct Event* events[MAX_PACKAGE_EVENTS];
+  size_t first[MAX_PACKAGE_EVENTS];  // Position of the seats of each event in xs and ys
+  size_t order[MAX_PACKAGE_EVENTS];  // Positions of the events by ascending id
+
+  for (size_t i = 0; i < num_events; i++) {
+    if (num_seats[i] == 0) {
+      fprintf(stderr, "Invalid number of seats\n");
+      return 1;
+    }
+    first[i] = i == 0 ? 0 : first[i - 1] + num_seats[i - 1];
+
+    size_t j = i;
+    for (; j > 0 && event_ids[order[j - 1]] > event_ids[i]; j--) order[j] = order[j - 1];
+    order[j] = i;
+  }
+
+  for (size_t i = 1; i < num_events; i++) {
+    if (event_ids[order[i]] == event_ids[order[i - 1]]) {
+      fprintf(stderr, "Event listed twice\n");
+      return 1;
+    }
+  }
+
+  unsigned int partitions = 0;
+  for (size_t i = 0; i < num_events; i++) partitions |= partition_bit(event_ids[i]);
+
+  if (lock_partitions(partitions, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  int missing = find_events_with_delay(num_events, event_ids, events);
+
+  unlock_partitions(partitions);
+
+  if (missing) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  // Every package locks its events in ascending id order, so two packages sharing events cannot deadlock
+  size_t locked = 0;
+  for (; locked < num_events; locked++) {
+    if (lock_event_swept(events[order[locked]]) != 0) break;
+  }
+
+  int ret = locked < num_events;
+  if (ret != 0) fprintf(stderr, "Error locking mutex\n");
+
+  // Nothing is written until every event passed, after which writing can no longer fail
+  for (size_t i = 0; i < num_events && ret == 0; i++) {
+    ret = check_seats(events[i], num_seats[i], xs + first[i], ys + first[i]);
+  }
+
+  for (size_t i = 0; i < num_events && ret == 0; i++) {
+    size_t taken;
+    reservation_ids[i] = write_seats(events[i], num_seats[i], xs + first[i], ys + first[i], NULL, &taken);
+
+    if (events[i]->subscribers != NULL) {
+      struct Notification notification = {event_ids[i], reservation_ids[i], taken};
+      subscription_publish(&events[i]->subscribers, &notification);
+    }
+  }
+
+  while (locked > 0) {
+    struct Event* event = events[order[--locked]];
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  }
+
+  return ret;
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* row, size_t* col) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  if (event->free_runs == NULL) {
+    event->free_runs = free_runs_create(event->rows, event->cols, &event->data);
+    if (event->free_runs == NULL) {
+      fprintf(stderr, "Error allocating memory for free seat index\n");
+      STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+      return 1;
+    }
+  }
+
+  if (free_runs_find_best(event->free_runs, num_seats, row, col) != 0) {
+    fprintf(stderr, "No block of free seats available\n");
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    return 1;
+  }
+
+  for (size_t i = 0; i < num_seats; i++) {
+    if (seat_map_ref(&event->data, seat_index(event, *row, *col + i)) == NULL) {
+      fprintf(stderr, "Error allocating memory for event data\n");
+      STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+      return 1;
+    }
+  }
+
+  size_t* indexed = NULL;
+  if (event->by_reservation != NULL) {
+    indexed = reservation_index_begin(event->by_reservation, event->reservations + 1, num_seats);
+    if (indexed == NULL) {
+      fprintf(stderr, "Error allocating memory for reservation index\n");
+      STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+      return 1;
+    }
+  }
+
+  unsigned int reservation_id = ++event->reservations;
+
+  for (size_t i = 0; i < num_seats; i++) {
+    *seat_map_ref(&event->data, seat_index(event, *row, *col + i)) = reservation_id;
+    free_runs_set(event->free_runs, *row, *col + i, 0);
+    if (indexed != NULL) indexed[i] = seat_index(event, *row, *col + i);
+  }
+  __atomic_store_n(&event->row_free[*row - 1], event->row_free[*row - 1] - num_seats, __ATOMIC_RELAXED);
+  __atomic_store_n(&event->free_seats, event->free_seats - num_seats, __ATOMIC_RELAXED);
+  if (indexed != NULL) reservation_index_end(event->by_reservation, reservation_id, num_seats);
+
+  if (event->subscribers != NULL) {
+    struct Notification notification = {event_id, reservation_id, num_seats};
+    subscription_publish(&event->subscribers, &notification);
+  }
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  return 0;
+}
+
+int ems_hold(unsigned int event_id, unsigned int ttl_ms, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Allocated up front, so a hold never has to be undone once its seats are taken
+  struct Hold* hold = malloc(sizeof(struct Hold) + num_seats * sizeof(size_t));
+  if (hold == NULL) {
+    fprintf(stderr, "Error allocating memory for hold\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    free(hold);
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    free(hold);
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    free(hold);
+    return 1;
+  }
+
+  hold->id = take_seats(event, num_seats, xs, ys, hold->seats, &hold->num_seats);
+  if (hold->id == 0) {
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    free(hold);
+    return 1;
+  }
+
+  hold->expires = op_stats_now() + (uint64_t)ttl_ms * 1000000;
+  hold->next = event->holds;
+  event->holds = hold;
+  if (hold->expires < event->holds_expire) __atomic_store_n(&event->holds_expire, hold->expires, __ATOMIC_RELAXED);
+  *hold_id = hold->id;
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  return 0;
+}
+
+/// Ends a hold of an event, either keeping its seats as a reservation or freeing them.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @param confirm Whether the seats are kept.
+/// @return 0 if the hold was ended, 1 otherwise.
+static int end_hold(unsigned int event_id, unsigned int hold_id, int confirm) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  // Expired holds were swept above, so a late confirmation fails instead of racing a new reservation
+  struct Hold** link = find_hold(event, hold_id);
+  if (link == NULL) {
+    fprintf(stderr, "Hold not found\n");
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    return 1;
+  }
+
+  size_t num_seats = (*link)->num_seats;
+  if (!confirm && release_seats(event, hold_id, (*link)->seats, num_seats) != 0) {
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    return 1;
+  }
+  remove_hold(event, link);
+
+  // Subscribers only hear of holds once they become reservations
+  if (confirm && event->subscribers != NULL) {
+    struct Notification notification = {event_id, hold_id, num_seats};
+    subscription_publish(&event->subscribers, &notification);
+  }
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  return 0;
+}
+
+int ems_confirm(unsigned int event_id, unsigned int hold_id) { return end_hold(event_id, hold_id, 1); }
+
+int ems_release(unsigned int event_id, unsigned int hold_id) { return end_hold(event_id, hold_id, 0); }
+
+/// Gets the reservation index of an event, building it on the first lookup.
+/// @param event Event to be indexed, with its mutex held.
+/// @return Index of the event, NULL on failure.
+static struct ReservationIndex* reservation_index(struct Event* event) {
+  if (event->by_reservation == NULL) {
+    event->by_reservation = reservation_index_create(&event->data, event->rows * event->cols, event->reservations);
+    if (event->by_reservation == NULL) fprintf(stderr, "Error allocating memory for reservation index\n");
+  }
+
+  return event->by_reservation;
+}
+
+int ems_get_reservation(unsigned int event_id, unsigned int reservation_id, char* buffer, size_t size) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  struct ReservationIndex* index = reservation_index(event);
+  size_t count = 0;
+  const size_t* seats = index == NULL ? NULL : reservation_index_get(index, reservation_id, &count);
+
+  struct OutBuffer out = {buffer, size, 0, 0};
+  out_uint(&out, count);
+  for (size_t i = 0; i < count && !out.truncated; i++) {
+    out_str(&out, "|");
+    out_uint(&out, seats[i] / event->cols + 1);
+    out_str(&out, "|");
+    out_uint(&out, seats[i] % event->cols + 1);
+  }
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+
+  if (count == 0) {
+    fprintf(stderr, "Reservation not found\n");
+    return 1;
+  }
+
+  if (out.truncated) {
+    fprintf(stderr, "Reservation too large to show\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  // The seats blocked by a template are part of the venue, not a sale
+  if (reservation_id != 0 && reservation_id == event->blocked) {
+    fprintf(stderr, "Reservation holds the seats blocked by the template\n");
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    return 1;
+  }
+
+  // Holds end through RELEASE, which also drops the expiry
+  if (find_hold(event, reservation_id) != NULL) {
+    fprintf(stderr, "Reservation is held, release it instead\n");
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+    return 1;
+  }
+
+  struct ReservationIndex* index = reservation_index(event);
+  size_t count = 0;
+  const size_t* seats = index == NULL ? NULL : reservation_index_get(index, reservation_id, &count);
+
+  int ret = 1;
+  if (count == 0) {
+    fprintf(stderr, "Reservation not found\n");
+  } else {
+    ret = release_seats(event, reservation_id, seats, count);
+  }
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  return ret;
+}
+
+int ems_show(int out_fd, unsigned int event_id, char* buffer, size_t size) {
+  (void)out_fd;
+
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event_swept(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  struct OutBuffer out = {buffer, size, 0, 0};
+  out_uint(&out, event->rows);
+  out_str(&out, "|");
+  out_uint(&out, event->cols);
+  out_str(&out, "|");
+
+  out_seats(&out, &event->data, 0, event->rows * event->cols, ' ');
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+
+  if (out.truncated) {
+    fprintf(stderr, "Event too large to show\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_list_events(int out_fd, char* buffer, size_t size) {
+  (void)out_fd;
+
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (lock_partitions(ALL_PARTITIONS, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct OutBuffer out = {buffer, size, 0, 0};
+  struct ListNode* nodes[EVENT_LIST_PARTITIONS];
+  size_t num_events = 0;
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    nodes[i] = event_list->partitions[i].head;
+    num_events += event_list->partitions[i].size;
+  }
+
+  if (num_events == 0) {
+    out_str(&out, "No events");
+    unlock_partitions(ALL_PARTITIONS);
+    return 0;
+  }
+
+  out_uint(&out, num_events);
+  out_str(&out, "|");
+
+  // Partitions are merged back into creation order, the order the events were always listed in
+  for (struct ListNode* current = next_created(event_list, nodes); current != NULL && !out.truncated;
+       current = next_created(event_list, nodes)) {
+    out_uint(&out, current->event->id);
+    out_str(&out, " ");
+  }
+
+  unlock_partitions(ALL_PARTITIONS);
+
+  if (out.truncated) {
+    fprintf(stderr, "Too many events to list, use a paginated list\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_list_events_page(const unsigned int* after_id, size_t limit, size_t min_free, size_t min_capacity,
+                         char* buffer, size_t size) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  if (limit == 0 || limit > LIST_PAGE_MAX) limit = LIST_PAGE_MAX;
+
+  // Ids are gathered under the lock and only formatted once it is released
+  unsigned int ids[LIST_PAGE_MAX];
+  size_t count = 0;
+  unsigned int cursor = 0;
+  int more = 0;
+
+  if (lock_partitions(ALL_PARTITIONS, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  size_t positions[EVENT_LIST_PARTITIONS];
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    positions[i] = after_id == NULL ? 0 : events_after(&event_list->partitions[i], *after_id);
+  }
+
+  for (size_t scanned = 0; count < limit && scanned < LIST_SCAN_MAX; scanned++) {
+    struct Event* event = next_by_id(event_list, positions);
+    if (event == NULL) break;
+    cursor = event->id;
+
+    if (event->rows * event->cols < min_capacity) continue;
+    if (__atomic_load_n(&event->free_seats, __ATOMIC_RELAXED) < min_free) continue;
+
+    ids[count++] = event->id;
+  }
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) {
+    if (positions[i] < event_list->partitions[i].size) more = 1;
+  }
+
+  unlock_partitions(ALL_PARTITIONS);
+
+  struct OutBuffer out = {buffer, size, 0, 0};
+  out_uint(&out, count);
+  out_str(&out, "|");
+  for (size_t j = 0; j < count; j++) {
+    out_uint(&out, ids[j]);
+    out_str(&out, " ");
+  }
+  out_str(&out, "|");
+  if (more) {
+    out_uint(&out, cursor);
+  } else {
+    out_str(&out, "-");
+  }
+
+  if (out.truncated) {
+    fprintf(stderr, "Buffer too small for the events page\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_dump(FILE* out) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  // Events are never freed while the server runs, so the pointers outlive the list lock
+  if (lock_partitions(ALL_PARTITIONS, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  size_t num_events = 0;
+  size_t positions[EVENT_LIST_PARTITIONS] = {0};
+  for (size_t i = 0; i < EVENT_LIST_PARTITIONS; i++) num_events += event_list->partitions[i].size;
+
+  struct Event** events = malloc((num_events == 0 ? 1 : num_events) * sizeof(struct Event*));
+  if (events == NULL) {
+    unlock_partitions(ALL_PARTITIONS);
+    fprintf(stderr, "Error allocating memory for dump\n");
+    return 1;
+  }
+  for (size_t i = 0; i < num_events; i++) events[i] = next_by_id(event_list, positions);
+
+  unlock_partitions(ALL_PARTITIONS);
+
+  char line[BUFSIZ];
+  int ret = 0;
+  for (size_t i = 0; i < num_events && ret == 0; i++) {
+    struct Event* event = events[i];
+    struct SeatMap snapshot;
+
+    // Sharing the chunks only takes references, the event copies them back on its next write
+    if (STAT_MUTEX_LOCK(&event->mutex, LOCK_CLASS_EVENT, event->id) != 0) {
+      fprintf(stderr, "Error locking mutex\n");
+      ret = 1;
+      break;
+    }
+    expire_holds(event);
+    unsigned int reservations = event->reservations;
+    int shared = seat_map_share(&snapshot, &event->data);
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+
+    if (shared != 0) {
+      fprintf(stderr, "Error allocating memory for dump\n");
+      ret = 1;
+      break;
+    }
+
+    fprintf(out, "Event %u (%zux%zu, %u reservations):\n", event->id, event->rows, event->cols, reservations);
+    for (size_t row = 0; row < event->rows; row++) {
+      struct OutBuffer buffer = {line, sizeof(line), 0, 0};
+
+      // A full line buffer is flushed and the rest of the row written from its start
+      for (size_t col = 0; col < event->cols;) {
+        col += out_seats(&buffer, &snapshot, row * event->cols + col, event->cols - col, ' ');
+        if (buffer.truncated) {
+          fwrite(line, 1, buffer.len, out);
+          buffer.len = 0;
+          buffer.truncated = 0;
+        }
+      }
+
+      // The separator after the last seat ends the row, a row without seats is just its newline
+      if (buffer.len == 0) {
+        fputc('\n', out);
+      } else {
+        line[buffer.len - 1] = '\n';
+        fwrite(line, 1, buffer.len, out);
+      }
+    }
+
+    seat_map_destroy(&snapshot);
+    if (ferror(out)) ret = 1;
+  }
+
+  free(events);
+  return ret;
+}
+
+int ems_availability(unsigned int event_id, size_t row, size_t* free_seats, size_t* capacity) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (row > event->rows) {
+    fprintf(stderr, "Row out of bounds\n");
+    return 1;
+  }
+
+  // Expired holds still count as taken until swept, which only events with holds ever have to wait for
+  uint64_t holds_expire = __atomic_load_n(&event->holds_expire, __ATOMIC_RELAXED);
+  if (holds_expire != UINT64_MAX && holds_expire <= op_stats_now()) {
+    if (lock_event_swept(event) != 0) {
+      fprintf(stderr, "Error locking mutex\n");
+      return 1;
+    }
+    STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  }
+
+  // Counters are read without the event mutex so polling never waits behind reservations
+  if (row == 0) {
+    *free_seats = __atomic_load_n(&event->free_seats, __ATOMIC_RELAXED);
+    *capacity = event->rows * event->cols;
+  } else {
+    *free_seats = __atomic_load_n(&event->row_free[row - 1], __ATOMIC_RELAXED);
+    *capacity = event->cols;
+  }
+
+  return 0;
+}
+
+int ems_subscribe(unsigned int event_id, struct Subscriber* subscriber) {
+  if (event_list == NULL) {
+    fprintf(stderr, "EMS state must be initialized\n");
+    return 1;
+  }
+
+  struct EventPartition* partition = list_partition(event_list, event_id);
+  if (lock_partition(partition, 0) != 0) {
+    fprintf(stderr, "Error locking list rwl\n");
+    return 1;
+  }
+
+  struct Event* event = find_event_with_delay(event_id);
+
+  STAT_RWUNLOCK(&partition->rwl, LOCK_CLASS_LIST);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event(event) != 0) {
+    fprintf(stderr, "Error locking mutex\n");
+    return 1;
+  }
+
+  int ret = subscription_add(&event->subscribers, subscriber);
+  if (ret != 0) fprintf(stderr, "Error allocating memory for subscription\n");
+
+  STAT_MUTEX_UNLOCK(&event->mutex, LOCK_CLASS_EVENT, event->id);
+  return ret;
+}
@@ -2,6 +2,12 @@
 #define SERVER_OPERATIONS_H
 
 #include <stddef.h>
+#include <stdio.h>
+
+#include "subscriptions.h"
+
+#define LIST_PAGE_MAX 64     // Events per page of a paginated list
+#define LIST_SCAN_MAX 4096   // Events visited per page of a paginated list
 
 /// Initializes the EMS state.
 /// @param delay_us Delay in microseconds.
@@ -18,6 +24,33 @@ int ems_terminate();
 /// @return 0 if the event was created successfully, 1 otherwise.
 int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 
+/// Creates a venue template that events can be created from.
+/// @param template_id Id of the template to be created.
+/// @param num_rows Number of rows of the venue.
+/// @param num_cols Number of columns of the venue.
+/// @param num_blocked Number of seats blocked in every event created from the template.
+/// @param xs Array of rows of the blocked seats.
+/// @param ys Array of columns of the blocked seats.
+/// @return 0 if the template was created successfully, 1 otherwise.
+int ems_create_template(unsigned int template_id, size_t num_rows, size_t num_cols, size_t num_blocked, size_t *xs,
+                        size_t *ys);
+
+/// Creates the events first_id .. first_id + count - 1 from a template.
+/// @note An unknown template or an id already in use creates none of the events.
+/// @param template_id Id of the template the events are created from.
+/// @param first_id Id of the first event to be created.
+/// @param count Number of events to be created, at most MAX_BULK_EVENTS.
+/// @param check_only Whether to only check that the events could be created, creating none.
+/// @return 0 if the events were created successfully (or could be), 1 otherwise.
+int ems_create_bulk(unsigned int template_id, unsigned int first_id, size_t count, int check_only);
+
+/// Clones an event into a new event id, sharing its seats copy-on-write.
+/// @note The clone starts with the seats of the event and then evolves on its own.
+/// @param event_id Id of the event to be cloned.
+/// @param new_id Id of the clone.
+/// @return 0 if the clone was created successfully, 1 otherwise.
+int ems_fork(unsigned int event_id, unsigned int new_id);
+
 /// Creates a new reservation for the given event.
 /// @param event_id Id of the event to create a reservation for.
 /// @param num_seats Number of seats to reserve.
@@ -26,15 +59,117 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
 
+/// Creates a reservation in each of several events, all or none of them.
+/// @note The events are found in a single batch and locked in ascending id order, every seat is checked before
+///       any is written.
+/// @param num_events Number of events, at most MAX_PACKAGE_EVENTS, each listed once.
+/// @param event_ids Array of the ids of the events.
+/// @param num_seats Array of the number of seats to reserve in each event.
+/// @param xs Array of rows of the seats to reserve, those of each event after those of the previous one.
+/// @param ys Array of columns of the seats to reserve, in the same order.
+/// @param reservation_ids Array to store the id of the reservation in each event in.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_events, const unsigned int *event_ids, const size_t *num_seats, size_t *xs,
+                      size_t *ys, unsigned int *reservation_ids);
+
+/// Reserves the best block of contiguous free seats in a single row.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param row Pointer to the variable to store the row of the block in.
+/// @param col Pointer to the variable to store the first column of the block in.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t *row, size_t *col);
+
+/// Holds seats of an event for a limited time, under a reservation id of their own.
+/// @note Held seats show and conflict like reserved ones. They are freed once the hold expires, swept lazily by the
+///       next access to the event, so events without holds pay nothing for it.
+/// @param event_id Id of the event to hold seats of.
+/// @param ttl_ms Milliseconds until the hold expires.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param hold_id Pointer to the variable to store the id of the hold in.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int ttl_ms, size_t num_seats, size_t *xs, size_t *ys,
+             unsigned int *hold_id);
+
+/// Turns a hold that did not expire into a reservation with the same id.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return 0 if the hold was confirmed successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int hold_id);
+
+/// Frees the seats of a hold before it expires.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return 0 if the hold was released successfully, 1 otherwise.
+int ems_release(unsigned int event_id, unsigned int hold_id);
+
+/// Gets the seats of a reservation through the reservation index of its event.
+/// @note Runs in time proportional to the size of the reservation, once the index is built.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @param buffer Buffer to store "count|row|col|row|col..." in.
+/// @param size Size of the buffer.
+/// @return 0 if the reservation was found, 1 otherwise.
+int ems_get_reservation(unsigned int event_id, unsigned int reservation_id, char *buffer, size_t size);
+
+/// Cancels a reservation, freeing its seats.
+/// @note Runs in time proportional to the size of the reservation, once the index is built. Holds are
+///       ended with ems_release instead, and the seats blocked by a template are never freed.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the reservation was cancelled, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
 /// Prints the given event.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
+/// @param buffer Buffer to store "rows|cols|seat seat ... " in.
+/// @param size Size of the buffer.
 /// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show(int out_fd, unsigned int event_id, char *buffer);
+int ems_show(int out_fd, unsigned int event_id, char *buffer, size_t size);
 
 /// Prints all the events.
 /// @param out_fd File descriptor to print the events to.
+/// @param buffer Buffer to store "count|id id ... " in.
+/// @param size Size of the buffer.
 /// @return 0 if the events were printed successfully, 1 otherwise.
-int ems_list_events(int out_fd, char *buffer);
+int ems_list_events(int out_fd, char *buffer, size_t size);
+
+/// Prints a page of the events, in ascending id order.
+/// @note At most LIST_SCAN_MAX events are visited per call, so a page may hold
+///       fewer than limit events while the cursor still points to more.
+/// @param after_id Only events with a larger id are listed, NULL to start from the first one.
+/// @param limit Maximum number of events in the page, capped at LIST_PAGE_MAX.
+/// @param min_free Only events with at least this many free seats are listed.
+/// @param min_capacity Only events with at least this many seats are listed.
+/// @param buffer Buffer to store "count|id id ... |cursor" in, cursor being "-" after the last page.
+/// @param size Size of the buffer.
+/// @return 0 if the events were printed successfully, 1 otherwise.
+int ems_list_events_page(const unsigned int *after_id, size_t limit, size_t min_free, size_t min_capacity,
+                         char *buffer, size_t size);
+
+/// Writes the seats of every event, in id order.
+/// @note Each event is copied under its lock and formatted from the copy, so
+///       reservations are never blocked on the output.
+/// @param out Stream to write to.
+/// @return 0 if every event was written successfully, 1 otherwise.
+int ems_dump(FILE *out);
+
+/// Gets the number of free seats of an event or of one of its rows.
+/// @note Runs in constant time from counters kept by the reservations.
+/// @param event_id Id of the event.
+/// @param row Row to be queried, starting at 1, or 0 for the whole event.
+/// @param free_seats Pointer to the variable to store the number of free seats in.
+/// @param capacity Pointer to the variable to store the number of seats in.
+/// @return 0 if the availability was read successfully, 1 otherwise.
+int ems_availability(unsigned int event_id, size_t row, size_t *free_seats, size_t *capacity);
+
+/// Subscribes a session to the reservations of the given event.
+/// @param event_id Id of the event to subscribe to.
+/// @param subscriber Subscriber of the session.
+/// @return 0 if the subscription was created successfully, 1 otherwise.
+int ems_subscribe(unsigned int event_id, struct Subscriber *subscriber);
 
 #endif  // SERVER_OPERATIONS_H
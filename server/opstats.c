@@ -0,0 +1,117 @@
+#include "opstats.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common/histogram.h"
+
+static const char* stage_names[NUM_STAGES] = {"queue", "parse", "lookup", "lock", "execute", "reply"};
+
+/// Histograms of a worker thread: the total and every stage of each operation.
+struct WorkerStats {
+  struct Histogram latency[OP_STATS_MAX_OPS][NUM_STAGES + 1];
+  struct WorkerStats* next;
+};
+
+/// Request being timed on a thread.
+struct RequestTimer {
+  uint64_t start;              /// When the request started.
+  uint64_t last_mark;          /// End of the last sequential stage.
+  uint64_t stages[NUM_STAGES]; /// Time spent in each stage.
+};
+
+static struct WorkerStats* all_workers = NULL;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local struct WorkerStats* local = NULL;
+static _Thread_local struct RequestTimer timer;
+
+uint64_t op_stats_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void op_stats_begin(uint64_t arrival) {
+  timer.start = arrival;
+  timer.last_mark = op_stats_now();
+  for (int i = 0; i < NUM_STAGES; i++) timer.stages[i] = 0;
+  timer.stages[STAGE_QUEUE] = timer.last_mark - arrival;
+}
+
+void op_stats_mark(enum OpStage stage) {
+  uint64_t now = op_stats_now();
+  timer.stages[stage] += now - timer.last_mark;
+  timer.last_mark = now;
+}
+
+void op_stats_add(enum OpStage stage, uint64_t ns) { timer.stages[stage] += ns; }
+
+void op_stats_end(unsigned int op) {
+  if (op >= OP_STATS_MAX_OPS) return;
+
+  if (local == NULL) {
+    // Histograms are only touched once used, so most of this stays unmapped
+    local = calloc(1, sizeof(struct WorkerStats));
+    if (local == NULL) return;
+
+    pthread_mutex_lock(&stats_mutex);
+    local->next = all_workers;
+    all_workers = local;
+    pthread_mutex_unlock(&stats_mutex);
+  }
+
+  // Lookups and lock waits happen while executing, so they are not counted twice
+  uint64_t nested = timer.stages[STAGE_LOOKUP] + timer.stages[STAGE_LOCK];
+  timer.stages[STAGE_EXECUTE] = timer.stages[STAGE_EXECUTE] > nested ? timer.stages[STAGE_EXECUTE] - nested : 0;
+
+  for (int i = 0; i < NUM_STAGES; i++) histogram_record(&local->latency[op][i + 1], timer.stages[i]);
+  histogram_record(&local->latency[op][0], timer.last_mark - timer.start);
+}
+
+/// Appends formatted text to a bounded buffer, counting what did not fit.
+/// @param buffer Buffer to write to.
+/// @param size Size of the buffer.
+/// @param len Length of the text so far, updated with the appended length.
+/// @param format printf format.
+__attribute__((format(printf, 4, 5))) static void append(char* buffer, size_t size, size_t* len, const char* format,
+                                                          ...) {
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(buffer + (*len < size ? *len : size), *len < size ? size - *len : 0, format, args);
+  va_end(args);
+
+  if (written > 0) *len += (size_t)written;
+}
+
+size_t op_stats_format(const char* const* names, size_t num_ops, char* buffer, size_t size) {
+  static struct Histogram merged[NUM_STAGES + 1];
+  size_t len = 0;
+
+  if (size > 0) buffer[0] = '\0';
+  append(buffer, size, &len, "Request latency (ns):\n%-13s %-8s %10s %10s %10s %10s %10s\n", "op", "stage", "count",
+         "p50", "p99", "p999", "max");
+
+  // The merge histograms are shared, so concurrent dumps take turns
+  pthread_mutex_lock(&stats_mutex);
+  for (size_t op = 0; op < num_ops && op < OP_STATS_MAX_OPS; op++) {
+    for (int i = 0; i <= NUM_STAGES; i++) histogram_init(&merged[i]);
+    for (struct WorkerStats* worker = all_workers; worker != NULL; worker = worker->next) {
+      for (int i = 0; i <= NUM_STAGES; i++) histogram_merge(&merged[i], &worker->latency[op][i]);
+    }
+    if (merged[0].count == 0) continue;
+
+    for (int i = 0; i <= NUM_STAGES; i++) {
+      append(buffer, size, &len, "%-13s %-8s %10llu %10llu %10llu %10llu %10llu\n", i == 0 ? names[op] : "",
+             i == 0 ? "total" : stage_names[i - 1], (unsigned long long)merged[i].count,
+             (unsigned long long)histogram_percentile(&merged[i], 0.5),
+             (unsigned long long)histogram_percentile(&merged[i], 0.99),
+             (unsigned long long)histogram_percentile(&merged[i], 0.999), (unsigned long long)merged[i].max);
+    }
+  }
+  pthread_mutex_unlock(&stats_mutex);
+
+  return len;
+}
@@ -0,0 +1,49 @@
+#ifndef SERVER_OP_STATS_H
+#define SERVER_OP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OP_STATS_MAX_OPS 32
+
+/// Stages a request goes through, timed separately.
+enum OpStage {
+  STAGE_QUEUE,    /// Waiting for a worker in the queue of its priority.
+  STAGE_PARSE,    /// Splitting the request and identifying the operation.
+  STAGE_LOOKUP,   /// Finding the event, including the simulated access delay.
+  STAGE_LOCK,     /// Waiting for the event list and event locks.
+  STAGE_EXECUTE,  /// Running the operation, minus its lookups and lock waits.
+  STAGE_REPLY,    /// Writing the response.
+  NUM_STAGES
+};
+
+/// Gets the current time for the stage timers.
+/// @return Monotonic time in nanoseconds.
+uint64_t op_stats_now();
+
+/// Starts timing a request on the calling thread, counting the time since it arrived as queueing.
+/// @param arrival When the request was read, from op_stats_now.
+void op_stats_begin(uint64_t arrival);
+
+/// Ends a sequential stage (parse, execute or reply) at the current time.
+/// @param stage Stage that just finished, measured from the previous mark.
+void op_stats_mark(enum OpStage stage);
+
+/// Adds time spent in a stage nested inside the execution (lookup or lock).
+/// @param stage Stage the time was spent in.
+/// @param ns Time spent, in nanoseconds.
+void op_stats_add(enum OpStage stage, uint64_t ns);
+
+/// Records the stages of the request into the histograms of the calling thread.
+/// @param op Operation of the request, below OP_STATS_MAX_OPS.
+void op_stats_end(unsigned int op);
+
+/// Merges the histograms of every thread and formats them as a table.
+/// @param names Name of each operation.
+/// @param num_ops Number of operations.
+/// @param buffer Buffer to write to, always NUL-terminated.
+/// @param size Size of the buffer.
+/// @return Length of the whole table, which did not fit if it is size or more.
+size_t op_stats_format(const char* const* names, size_t num_ops, char* buffer, size_t size);
+
+#endif  // SERVER_OP_STATS_H
@@ -0,0 +1,105 @@
+#define _GNU_SOURCE  // sched_getaffinity and the CPU_* macros
+#include "placement.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eventlist.h"
+#include "scheduler.h"
+
+#define NODE_CPULIST "/sys/devices/system/node/node%u/cpulist"
+#define MAX_NODE_IDS 1024  // Node ids probed in sysfs, they need not be contiguous
+
+static size_t cpus[CPU_SETSIZE];                 // Allowed CPUs, grouped by node
+static size_t node_first[SCHEDULER_MAX_NODES];  // Position in cpus of the first CPU of each node
+static size_t node_cpus[SCHEDULER_MAX_NODES];   // Number of CPUs of each node
+static unsigned int num_nodes = 1;
+
+/// Reads the CPUs of a NUMA node from sysfs.
+/// @param node_id Id of the node.
+/// @param set Set to store the CPUs in.
+/// @return 0 if the node exists, 1 otherwise.
+static int read_node_cpus(unsigned int node_id, cpu_set_t* set) {
+  char path[64];
+  snprintf(path, sizeof(path), NODE_CPULIST, node_id);
+  FILE* file = fopen(path, "r");
+  if (file == NULL) return 1;
+
+  char line[4096];
+  int ret = fgets(line, sizeof(line), file) == NULL;
+  fclose(file);
+  if (ret) return 1;
+
+  // "0-3,8-11", a node without CPUs has an empty list
+  CPU_ZERO(set);
+  char* c = line;
+  while (*c >= '0' && *c <= '9') {
+    unsigned long first = strtoul(c, &c, 10);
+    unsigned long last = *c == '-' ? strtoul(c + 1, &c, 10) : first;
+    for (size_t cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, set);
+    if (*c == ',') c++;
+  }
+
+  return 0;
+}
+
+int placement_init() {
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    fprintf(stderr, "Error reading the CPU affinity\n");
+    return 1;
+  }
+
+  size_t num_cpus = 0;
+  num_nodes = 0;
+  cpu_set_t node;
+  for (unsigned int id = 0; id < MAX_NODE_IDS && num_nodes < SCHEDULER_MAX_NODES; id++) {
+    if (read_node_cpus(id, &node) != 0) continue;
+
+    cpu_set_t usable;
+    CPU_AND(&usable, &node, &allowed);
+    if (CPU_COUNT(&usable) == 0) continue;
+
+    node_first[num_nodes] = num_cpus;
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &usable)) cpus[num_cpus++] = cpu;
+    }
+    node_cpus[num_nodes] = num_cpus - node_first[num_nodes];
+    num_nodes++;
+  }
+
+  if (num_nodes > 0) return 0;
+
+  // No NUMA topology: a single node holding every allowed CPU
+  num_nodes = 1;
+  node_first[0] = 0;
+  for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) cpus[num_cpus++] = cpu;
+  }
+  node_cpus[0] = num_cpus;
+  return 0;
+}
+
+unsigned int placement_num_nodes() { return num_nodes; }
+
+unsigned int placement_pin_worker(size_t worker) {
+  unsigned int node = (unsigned int)(worker % num_nodes);
+  if (node_cpus[node] == 0) return node;
+
+  // Workers past the CPUs of their node share them
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[node_first[node] + worker / num_nodes % node_cpus[node]], &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    fprintf(stderr, "Error pinning worker %zu, it runs unpinned\n", worker);
+  }
+
+  return node;
+}
+
+unsigned int placement_home_node(unsigned int event_id) {
+  return event_id % EVENT_LIST_PARTITIONS % num_nodes;
+}
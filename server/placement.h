@@ -0,0 +1,29 @@
+#ifndef SERVER_PLACEMENT_H
+#define SERVER_PLACEMENT_H
+
+#include <stddef.h>
+
+/// Discovers the CPUs the server may run on and the NUMA node of each.
+/// @note Machines that do not expose their NUMA topology are treated as a single node holding every allowed CPU.
+///       Only the first SCHEDULER_MAX_NODES nodes get workers.
+/// @return 0 if the CPUs were found, 1 otherwise.
+int placement_init();
+
+/// Gets the number of NUMA nodes with CPUs the server may run on.
+/// @return Number of nodes, 1 before placement_init or on single-node machines.
+unsigned int placement_num_nodes();
+
+/// Pins the calling thread to a single CPU, spreading the workers over the nodes first and their CPUs second.
+/// @note A worker that cannot be pinned keeps running unpinned, it still reports the node it was meant for.
+/// @param worker Index of the worker.
+/// @return Node the worker belongs to.
+unsigned int placement_pin_worker(size_t worker);
+
+/// Gets the home node of an event, whose workers run its requests and so first touch its seats.
+/// @note Events of the same event list partition share a node, so creates and reservations of a partition stay on
+///       it.
+/// @param event_id Id of the event.
+/// @return Home node of the event.
+unsigned int placement_home_node(unsigned int event_id);
+
+#endif  // SERVER_PLACEMENT_H
@@ -0,0 +1,67 @@
+#include "registration.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+
+#define REJECT_PATH_SIZE 1024
+
+int registration_parse(char* registration, char* req_pipe, char* resp_pipe, size_t size, unsigned int* priority) {
+  char* save;
+  char* req_name = strtok_r(registration, " \n", &save);
+  char* resp_name = strtok_r(NULL, " \n", &save);
+  char* priority_name = strtok_r(NULL, " \n", &save);
+  if (req_name == NULL || resp_name == NULL) return 1;
+
+  *priority = PRIORITY_HIGH;
+  if (priority_name != NULL) {
+    char* endptr;
+    unsigned long value = strtoul(priority_name, &endptr, 10);
+    if (*endptr != '\0' || value >= NUM_PRIORITIES) return 1;
+    *priority = (unsigned int)value;
+  }
+
+  // Client pipe names are relative to the client directory
+  int len = snprintf(req_pipe, size, "../client/%s", req_name);
+  if (len < 0 || (size_t)len >= size) return 1;
+  len = snprintf(resp_pipe, size, "../client/%s", resp_name);
+  if (len < 0 || (size_t)len >= size) return 1;
+  return 0;
+}
+
+int registration_open_response(const char* resp_pipe) {
+  int fd = open(resp_pipe, O_WRONLY | O_NONBLOCK);
+  if (fd == -1) {
+      fprintf(stderr, "[ERR]: open resp failed: %s\n", strerror(errno));
+      return -1;
+  }
+
+  int flags = fcntl(fd, F_GETFL);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+      fprintf(stderr, "[ERR]: fcntl failed: %s\n", strerror(errno));
+      close(fd);
+      return -1;
+  }
+
+  return fd;
+}
+
+void registration_reject(char* registration, unsigned int retry_ms) {
+  char req_pipe[REJECT_PATH_SIZE], resp_pipe[REJECT_PATH_SIZE];
+  unsigned int priority;
+  if (registration_parse(registration, req_pipe, resp_pipe, sizeof(req_pipe), &priority)) return;
+
+  int fd = open(resp_pipe, O_WRONLY | O_NONBLOCK);
+  if (fd == -1) return;
+
+  // Shorter than PIPE_BUF, so it is written whole or not at all
+  char reply[32];
+  int len = snprintf(reply, sizeof(reply), "BUSY|%u\n", retry_ms);
+  if (write(fd, reply, (size_t)len) != len) fprintf(stderr, "[ERR]: busy reply failed: %s\n", strerror(errno));
+  close(fd);
+}
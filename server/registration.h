@@ -0,0 +1,27 @@
+#ifndef SERVER_REGISTRATION_H
+#define SERVER_REGISTRATION_H
+
+#include <stddef.h>
+
+/// Splits a registration into the paths of the client pipes and the priority of the session.
+/// @note Client pipe names are relative to the client directory.
+/// @param registration Registration, "<request pipe> <response pipe> [priority]", modified.
+/// @param req_pipe Buffer to store the path of the request pipe in.
+/// @param resp_pipe Buffer to store the path of the response pipe in.
+/// @param size Size of both buffers.
+/// @param priority Pointer to store the priority in, PRIORITY_HIGH if the client did not declare one.
+/// @return 0 if the registration is valid, 1 otherwise.
+int registration_parse(char* registration, char* req_pipe, char* resp_pipe, size_t size, unsigned int* priority);
+
+/// Opens the response pipe of a registering client without waiting on it.
+/// @note The client holds the read end while it registers, so this only fails if the client is gone.
+/// @param resp_pipe Path of the response pipe.
+/// @return Blocking file descriptor of the pipe, -1 on error.
+int registration_open_response(const char* resp_pipe);
+
+/// Tells a client that could not be admitted when to register again. Never blocks.
+/// @param registration Registration of the client, modified.
+/// @param retry_ms Milliseconds the client is told to wait.
+void registration_reject(char* registration, unsigned int retry_ms);
+
+#endif  // SERVER_REGISTRATION_H
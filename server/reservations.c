@@ -0,0 +1,139 @@
+#include "reservations.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Gets the capacity to grow an array to.
+/// @param capacity Current capacity.
+/// @param needed Number of elements needed.
+/// @return New capacity, doubling the current one until it fits.
+static size_t grown_capacity(size_t capacity, size_t needed) {
+  if (capacity == 0) capacity = 16;
+  while (capacity < needed) capacity *= 2;
+  return capacity;
+}
+
+/// Grows the id table to hold at least a number of ids.
+/// @return 0 if the table is large enough, 1 on failure.
+static int reserve_ids(struct ReservationIndex* index, size_t needed) {
+  if (needed <= index->ids_capacity) return 0;
+
+  size_t capacity = grown_capacity(index->ids_capacity, needed);
+  struct ReservationSeats* ids = realloc(index->ids, capacity * sizeof(struct ReservationSeats));
+  if (ids == NULL) return 1;
+
+  index->ids = ids;
+  index->ids_capacity = capacity;
+  return 0;
+}
+
+/// Grows the pool to hold at least a number of seats.
+/// @return 0 if the pool is large enough, 1 on failure.
+static int reserve_seats(struct ReservationIndex* index, size_t needed) {
+  if (needed <= index->seats_capacity) return 0;
+
+  size_t capacity = grown_capacity(index->seats_capacity, needed);
+  size_t* seats = realloc(index->seats, capacity * sizeof(size_t));
+  if (seats == NULL) return 1;
+
+  index->seats = seats;
+  index->seats_capacity = capacity;
+  return 0;
+}
+
+struct ReservationIndex* reservation_index_create(const struct SeatMap* data, size_t size, unsigned int reservations) {
+  struct ReservationIndex* index = calloc(1, sizeof(struct ReservationIndex));
+  if (index == NULL) return NULL;
+
+  index->num_ids = (size_t)reservations + 1;
+  if (reserve_ids(index, index->num_ids) != 0) {
+    free(index);
+    return NULL;
+  }
+  memset(index->ids, 0, index->num_ids * sizeof(struct ReservationSeats));
+  if (data == NULL || size == 0) return index;
+
+  // Counted first, so the seats of every reservation land next to each other in a single pass
+  for (size_t i = 0; i < size; i++) {
+    unsigned int id = seat_map_get(data, i);
+    if (id != 0 && id < index->num_ids) index->ids[id].count++;
+  }
+
+  size_t first = 0;
+  for (size_t id = 0; id < index->num_ids; id++) {
+    index->ids[id].first = first;
+    first += index->ids[id].count;
+    index->ids[id].count = 0;
+  }
+
+  if (reserve_seats(index, first) != 0) {
+    reservation_index_free(index);
+    return NULL;
+  }
+  index->num_seats = first;
+
+  for (size_t i = 0; i < size; i++) {
+    unsigned int id = seat_map_get(data, i);
+    if (id == 0 || id >= index->num_ids) continue;
+
+    struct ReservationSeats* entry = &index->ids[id];
+    index->seats[entry->first + entry->count++] = i;
+  }
+
+  return index;
+}
+
+struct ReservationIndex* reservation_index_copy(const struct ReservationIndex* index) {
+  struct ReservationIndex* copy = calloc(1, sizeof(struct ReservationIndex));
+  if (copy == NULL) return NULL;
+
+  if (reserve_ids(copy, index->num_ids) != 0 || reserve_seats(copy, index->num_seats) != 0) {
+    reservation_index_free(copy);
+    return NULL;
+  }
+
+  memcpy(copy->ids, index->ids, index->num_ids * sizeof(struct ReservationSeats));
+  if (index->num_seats > 0) memcpy(copy->seats, index->seats, index->num_seats * sizeof(size_t));
+  copy->num_ids = index->num_ids;
+  copy->num_seats = index->num_seats;
+  return copy;
+}
+
+void reservation_index_free(struct ReservationIndex* index) {
+  if (index == NULL) return;
+  free(index->ids);
+  free(index->seats);
+  free(index);
+}
+
+size_t* reservation_index_begin(struct ReservationIndex* index, unsigned int id, size_t max_seats) {
+  if (reserve_ids(index, (size_t)id + 1) != 0 || reserve_seats(index, index->num_seats + max_seats) != 0) {
+    return NULL;
+  }
+
+  return index->seats + index->num_seats;
+}
+
+void reservation_index_end(struct ReservationIndex* index, unsigned int id, size_t count) {
+  // Ids that never reached the index, such as failed ones, stay empty
+  while (index->num_ids <= id) {
+    index->ids[index->num_ids++] = (struct ReservationSeats){index->num_seats, 0};
+  }
+
+  index->ids[id] = (struct ReservationSeats){index->num_seats, count};
+  index->num_seats += count;
+}
+
+const size_t* reservation_index_get(const struct ReservationIndex* index, unsigned int id, size_t* count) {
+  if (id == 0 || id >= index->num_ids) {
+    *count = 0;
+    return NULL;
+  }
+
+  *count = index->ids[id].count;
+  return *count == 0 ? NULL : index->seats + index->ids[id].first;
+}
+
+void reservation_index_remove(struct ReservationIndex* index, unsigned int id) {
+  if (id != 0 && id < index->num_ids) index->ids[id].count = 0;
+}
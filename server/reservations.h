@@ -0,0 +1,68 @@
+#ifndef SERVER_RESERVATIONS_H
+#define SERVER_RESERVATIONS_H
+
+#include <stddef.h>
+
+#include "seats.h"
+
+/// Seats of a reservation, as a range of the index pool.
+struct ReservationSeats {
+  size_t first;  /// Position of the first seat in the pool.
+  size_t count;  /// Number of seats, 0 once cancelled.
+};
+
+/// Index from the reservation ids of an event to their seats.
+/// @note Ids are handed out in order, so the table is indexed by id and the seats of every reservation are
+///       appended to a single pool. Cancelled ranges are not reclaimed.
+struct ReservationIndex {
+  size_t num_ids;                   /// Entries in use, ids 1 .. num_ids - 1 (0 is never a reservation).
+  size_t ids_capacity;              /// Capacity of ids.
+  struct ReservationSeats* ids;     /// Seats of each id.
+  size_t num_seats;                 /// Seats in use in the pool.
+  size_t seats_capacity;            /// Capacity of the pool.
+  size_t* seats;                    /// Seat indices of every reservation, grouped by reservation.
+};
+
+/// Builds the index from the seats of an event.
+/// @note Costs a pass over every seat, events created empty start with reservation_index_create(NULL, 0, 0).
+/// @param data Reservations of each seat, NULL if there are none.
+/// @param size Number of seats.
+/// @param reservations Largest reservation id.
+/// @return Newly created index, NULL on failure.
+struct ReservationIndex* reservation_index_create(const struct SeatMap* data, size_t size, unsigned int reservations);
+
+/// Copies an index.
+/// @param index Index to be copied.
+/// @return Newly created index, NULL on failure.
+struct ReservationIndex* reservation_index_copy(const struct ReservationIndex* index);
+
+/// Frees an index.
+/// @param index Index to be freed.
+void reservation_index_free(struct ReservationIndex* index);
+
+/// Makes room for the seats of a new reservation, so recording it can no longer fail.
+/// @param index Index to be modified.
+/// @param id Id of the reservation, larger than any recorded one.
+/// @param max_seats Largest number of seats the reservation may have.
+/// @return Where to write the seat indices, NULL on failure.
+size_t* reservation_index_begin(struct ReservationIndex* index, unsigned int id, size_t max_seats);
+
+/// Records a reservation whose seats were written where reservation_index_begin pointed.
+/// @param index Index to be modified.
+/// @param id Id of the reservation.
+/// @param count Number of seats written.
+void reservation_index_end(struct ReservationIndex* index, unsigned int id, size_t count);
+
+/// Gets the seats of a reservation.
+/// @param index Index to be searched.
+/// @param id Id of the reservation.
+/// @param count Pointer to the variable to store the number of seats in, 0 if the reservation does not exist.
+/// @return Seat indices of the reservation.
+const size_t* reservation_index_get(const struct ReservationIndex* index, unsigned int id, size_t* count);
+
+/// Forgets the seats of a reservation.
+/// @param index Index to be modified.
+/// @param id Id of the reservation.
+void reservation_index_remove(struct ReservationIndex* index, unsigned int id);
+
+#endif  // SERVER_RESERVATIONS_H
@@ -0,0 +1,868 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/constants.h"
+#include "operations.h"
+#include "registration.h"
+
+#define BUFFER_SIZE 1024
+#define MAX_SHARDS 16
+#define MAX_SESSIONS 32
+#define BUSY_RETRY_MS 100           // How long rejected clients are told to wait before registering again
+#define SHARD_BLOCK_SIZE 64         // Consecutive event ids kept on the same shard, so bulk creations split little
+#define SHARD_START_MS 5000         // How long a backend gets to create its register pipe
+#define SHARD_REGISTER_MS 5000      // How long a backend gets to answer a registration
+#define SHARD_REGISTER_ATTEMPTS 10  // Registrations tried while a backend answers BUSY
+
+// Usage: router <pipe_path> <num_shards> [delay]
+// Owns the register pipe and forwards the requests of every session to the ems backends it starts, one per shard.
+
+/// Bytes gathered from a pipe, grown as needed.
+struct Text {
+  char* data;
+  size_t len;
+};
+
+/// Part of a client request that is sent to a single shard.
+struct Step {
+  unsigned int shard;
+  char* line;         /// Request sent to the shard.
+  struct Text reply;  /// Reply of the shard.
+  int sent;           /// Whether the line was sent.
+  int done;           /// Whether the reply is complete.
+  int gated;          /// Only sent once every step that is not gated succeeded, failed unsent otherwise.
+};
+
+/// How the replies of the steps of a request become the reply to the client.
+enum Merge {
+  MERGE_FORWARD,    /// Single step, its reply is passed on.
+  MERGE_STATUS,     /// "0\n" if every step succeeded, "1\n" otherwise.
+  MERGE_LIST,       /// Ids of every shard, in ascending order rather than in creation order.
+  MERGE_LIST_PAGE,  /// Page of the first ids of every shard.
+  MERGE_STATS       /// Tables of every shard, one after the other.
+};
+
+/// Session of a client on a shard, opened on the first request routed there.
+struct Backend {
+  int req;                  /// Request pipe, -1 while closed.
+  int resp;                 /// Non-blocking response pipe, -1 while closed.
+  int failed;               /// Set once the shard could not be reached, its steps fail from then on.
+  char req_name[64];        /// Name of the request pipe in the client directory.
+  char resp_name[64];       /// Name of the response pipe in the client directory.
+  char input[BUFFER_SIZE];  /// Bytes read from the response pipe and not handled yet.
+  size_t input_len;         /// Number of bytes in input.
+  size_t body_left;         /// Bytes of a stats table still expected after its header.
+  size_t step;              /// Step waiting for its reply, SIZE_MAX if none.
+};
+
+/// Client connected to the router.
+struct RouterSession {
+  unsigned int id;
+  unsigned int priority;             /// Priority the backend sessions are registered with.
+  int rx;                            /// Non-blocking request pipe.
+  int resp;                          /// Response pipe.
+  char input[BUFFER_SIZE];           /// Bytes of requests read and not handled yet.
+  size_t input_len;                  /// Number of bytes in input.
+  struct Backend backends[MAX_SHARDS];
+  struct Step* steps;                /// Steps of the request being served, NULL if none.
+  size_t num_steps;                  /// Number of steps.
+  size_t steps_done;                 /// Number of steps with a complete reply.
+  enum Merge merge;                  /// How the replies are merged.
+  size_t page_limit;                 /// Page size of a paginated list.
+};
+
+unsigned int num_shards;
+int shard_register[MAX_SHARDS];  // Write ends of the register pipes of the backends
+unsigned int next_session = 0;
+unsigned int num_sessions = 0;   // Sessions being served, updated atomically by their threads
+
+/// Gets the shard an event lives on.
+/// @param event_id Id of the event.
+/// @return Shard of the event.
+unsigned int shardOf(unsigned int event_id) {
+  // Fibonacci hashing of the block, so neighbouring blocks spread over the shards
+  uint32_t block = event_id / SHARD_BLOCK_SIZE;
+  return (uint32_t)(block * 2654435761u) % num_shards;
+}
+
+/// Appends bytes to a text.
+/// @return 0 if the bytes were appended, 1 if memory ran out.
+int appendText(struct Text* text, const char* data, size_t len) {
+  char* grown = realloc(text->data, text->len + len + 1);
+  if (grown == NULL) return 1;
+
+  memcpy(grown + text->len, data, len);
+  text->data = grown;
+  text->len += len;
+  text->data[text->len] = '\0';
+  return 0;
+}
+
+/// Writes a whole buffer to a pipe.
+/// @return 0 if everything was written, 1 otherwise.
+int writeAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t ret = write(fd, data, len);
+    if (ret == -1 && errno == EINTR) continue;
+    if (ret <= 0) return 1;
+
+    data += ret;
+    len -= (size_t)ret;
+  }
+
+  return 0;
+}
+
+/// Waits for a number of milliseconds.
+void sleepMs(unsigned int ms) {
+  struct timespec delay = {ms / 1000, (long)(ms % 1000) * 1000000L};
+  while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {
+  }
+}
+
+/// Closes the session of a client on a shard and removes its pipes.
+/// @param backend Session on the shard.
+void closeBackend(struct Backend* backend) {
+  if (backend->req != -1) close(backend->req);
+  if (backend->resp != -1) close(backend->resp);
+  backend->req = -1;
+  backend->resp = -1;
+  if (backend->req_name[0] == '\0') return;
+
+  // The backend sees its pipes close and ends the session on its side
+  char path[BUFFER_SIZE];
+  snprintf(path, sizeof(path), "../client/%s", backend->req_name);
+  unlink(path);
+  snprintf(path, sizeof(path), "../client/%s", backend->resp_name);
+  unlink(path);
+}
+
+/// Registers a client with a shard, the same way a client registers with a single server.
+/// @param session Session of the client.
+/// @param shard Shard to register with.
+/// @return 0 if the backend session is open, 1 otherwise.
+int openBackend(struct RouterSession* session, unsigned int shard) {
+  struct Backend* backend = &session->backends[shard];
+  snprintf(backend->req_name, sizeof(backend->req_name), "router.%d.%u.%u.req", (int)getpid(), session->id, shard);
+  snprintf(backend->resp_name, sizeof(backend->resp_name), "router.%d.%u.%u.resp", (int)getpid(), session->id, shard);
+
+  char req_path[BUFFER_SIZE], resp_path[BUFFER_SIZE];
+  snprintf(req_path, sizeof(req_path), "../client/%s", backend->req_name);
+  snprintf(resp_path, sizeof(resp_path), "../client/%s", backend->resp_name);
+  unlink(req_path);
+  unlink(resp_path);
+  if (mkfifo(req_path, 0666) != 0 || mkfifo(resp_path, 0666) != 0) {
+    fprintf(stderr, "[ERR]: mkfifo failed: %s\n", strerror(errno));
+    closeBackend(backend);
+    return 1;
+  }
+
+  // The backend answers on the response pipe, which must have a reader before it registers
+  backend->resp = open(resp_path, O_RDONLY | O_NONBLOCK);
+  if (backend->resp == -1) {
+    fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
+    closeBackend(backend);
+    return 1;
+  }
+
+  char registration[BUFFER_SIZE];
+  int len = snprintf(registration, sizeof(registration), "%s %s %u\n", backend->req_name, backend->resp_name,
+                     session->priority);
+
+  char reply[BUFFER_SIZE];
+  for (unsigned int attempt = 0;; attempt++) {
+    if (writeAll(shard_register[shard], registration, (size_t)len) != 0) {
+      fprintf(stderr, "[ERR]: shard %u unreachable\n", shard);
+      closeBackend(backend);
+      return 1;
+    }
+
+    struct pollfd pfd = {backend->resp, POLLIN, 0};
+    int ready = poll(&pfd, 1, SHARD_REGISTER_MS);
+    ssize_t ret = ready == 1 ? read(backend->resp, reply, sizeof(reply) - 1) : -1;
+    if (ret <= 0) {
+      fprintf(stderr, "[ERR]: shard %u did not answer the registration\n", shard);
+      closeBackend(backend);
+      return 1;
+    }
+    reply[ret] = '\0';
+
+    if (strncmp(reply, "BUSY|", 5) != 0) break;
+    if (attempt + 1 == SHARD_REGISTER_ATTEMPTS) {
+      fprintf(stderr, "[ERR]: shard %u busy\n", shard);
+      closeBackend(backend);
+      return 1;
+    }
+    sleepMs((unsigned int)atoi(reply + 5));
+  }
+
+  backend->req = open(req_path, O_WRONLY);
+  if (backend->req == -1) {
+    fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
+    closeBackend(backend);
+    return 1;
+  }
+
+  return 0;
+}
+
+/// Fails the step a shard owes a reply to, and every later one, once the shard cannot be reached.
+/// @param session Session of the client.
+/// @param shard Shard that failed.
+void failBackend(struct RouterSession* session, unsigned int shard) {
+  struct Backend* backend = &session->backends[shard];
+  fprintf(stderr, "[ERR]: session %u lost shard %u\n", session->id, shard);
+  closeBackend(backend);
+  backend->failed = 1;
+  backend->body_left = 0;
+  backend->input_len = 0;
+
+  for (size_t i = 0; i < session->num_steps; i++) {
+    struct Step* step = &session->steps[i];
+    if (step->shard != shard || step->done) continue;
+
+    step->reply.len = 0;
+    appendText(&step->reply, "1\n", 2);
+    step->done = 1;
+    session->steps_done++;
+  }
+  backend->step = SIZE_MAX;
+}
+
+/// Sends the next step of every shard that is not waiting on a reply.
+/// @param session Session of the client.
+void sendSteps(struct RouterSession* session) {
+  int checking = 0, check_failed = 0;
+  for (size_t i = 0; i < session->num_steps; i++) {
+    struct Step* step = &session->steps[i];
+    if (step->gated) continue;
+    if (!step->done) checking = 1;
+    if (step->done && (step->reply.data == NULL || atoi(step->reply.data) != 0)) check_failed = 1;
+  }
+
+  for (size_t i = 0; i < session->num_steps; i++) {
+    struct Step* step = &session->steps[i];
+    struct Backend* backend = &session->backends[step->shard];
+    if (step->sent || step->done || (step->gated && checking)) continue;
+
+    if (step->gated && check_failed) {
+      step->reply.len = 0;
+      appendText(&step->reply, "1\n", 2);
+      step->done = 1;
+      session->steps_done++;
+      continue;
+    }
+    if (backend->step != SIZE_MAX) continue;
+
+    step->sent = 1;
+    if (!backend->failed && backend->req == -1 && openBackend(session, step->shard) != 0) backend->failed = 1;
+
+    backend->step = i;
+    if (backend->failed || writeAll(backend->req, step->line, strlen(step->line)) != 0) {
+      failBackend(session, step->shard);
+    }
+  }
+}
+
+/// Handles what a shard wrote: notifications go straight to the client, the rest is the reply of its step.
+/// @param session Session of the client.
+/// @param shard Shard whose response pipe is readable.
+/// @return 0 if the client can still be written to, 1 otherwise.
+int readBackend(struct RouterSession* session, unsigned int shard) {
+  struct Backend* backend = &session->backends[shard];
+  ssize_t ret = read(backend->resp, backend->input + backend->input_len, sizeof(backend->input) - backend->input_len);
+  if (ret == -1 && (errno == EAGAIN || errno == EINTR)) return 0;
+  if (ret <= 0) {
+    failBackend(session, shard);
+    return 0;
+  }
+  backend->input_len += (size_t)ret;
+
+  size_t start = 0;
+  while (start < backend->input_len) {
+    char* data = backend->input + start;
+    size_t len = backend->input_len - start;
+    struct Step* step = backend->step == SIZE_MAX ? NULL : &session->steps[backend->step];
+
+    // A stats table follows its header as raw bytes
+    if (backend->body_left > 0) {
+      size_t take = len < backend->body_left ? len : backend->body_left;
+      if (step != NULL) appendText(&step->reply, data, take);
+      backend->body_left -= take;
+      start += take;
+    } else {
+      char* end = memchr(data, '\n', len);
+      if (end == NULL) break;
+      size_t line_len = (size_t)(end - data) + 1;
+      start += line_len;
+
+      if (data[0] == 'N' || data[0] == 'R') {
+        if (writeAll(session->resp, data, line_len) != 0) return 1;
+        continue;
+      }
+
+      if (step == NULL) continue;  // Nothing was asked, such as a late reply to a failed step
+      appendText(&step->reply, data, line_len);
+
+      size_t length;
+      if (strcmp(step->line, "15\n") == 0 && data[0] == '0' && sscanf(data, "%*d|%zu", &length) == 1) {
+        backend->body_left = length;
+      }
+    }
+
+    if (step != NULL && backend->body_left == 0) {
+      step->done = 1;
+      session->steps_done++;
+      backend->step = SIZE_MAX;
+    }
+  }
+
+  // A line that can never fit is dropped rather than stalling the shard
+  if (start == 0 && backend->input_len == sizeof(backend->input)) start = backend->input_len;
+  memmove(backend->input, backend->input + start, backend->input_len - start);
+  backend->input_len -= start;
+  return 0;
+}
+
+/// Adds a step to the request being served.
+/// @param gated Whether the step waits for the other steps to succeed.
+/// @return 0 if the step was added, 1 if memory ran out.
+int addStep(struct RouterSession* session, unsigned int shard, const char* line, int gated) {
+  struct Step* steps = realloc(session->steps, (session->num_steps + 1) * sizeof(struct Step));
+  if (steps == NULL) return 1;
+  session->steps = steps;
+
+  struct Step* step = &steps[session->num_steps];
+  *step = (struct Step){shard, strdup(line), {NULL, 0}, 0, 0, gated};
+  if (step->line == NULL) return 1;
+
+  session->num_steps++;
+  return 0;
+}
+
+/// Frees the steps of the request that was served.
+/// @param session Session of the client.
+void freeSteps(struct RouterSession* session) {
+  for (size_t i = 0; i < session->num_steps; i++) {
+    free(session->steps[i].line);
+    free(session->steps[i].reply.data);
+  }
+
+  free(session->steps);
+  session->steps = NULL;
+  session->num_steps = 0;
+  session->steps_done = 0;
+}
+
+/// Splits a request into the steps of the shards that serve it.
+/// @param session Session of the client.
+/// @param line Request, a single line.
+/// @return 0 if the request was split, 1 if it cannot be served across shards and fails at once.
+int routeRequest(struct RouterSession* session, const char* line) {
+  char fields[BUFFER_SIZE];
+  strncpy(fields, line, sizeof(fields) - 1);
+  fields[sizeof(fields) - 1] = '\0';
+
+  // Only the numbers are needed, "12|-|..." reads the cursor of a first page as 0
+  unsigned long values[8] = {0};
+  size_t num_values = 0;
+  char* save;
+  for (char* field = strtok_r(fields, "|", &save); field != NULL && num_values < 8;
+       field = strtok_r(NULL, "|", &save)) {
+    values[num_values++] = strtoul(field, NULL, 10);
+  }
+
+  session->merge = MERGE_FORWARD;
+  switch (values[0]) {
+    case 6:   // LIST
+    case 12:  // LIST_PAGE
+    case 15:  // STATS
+      session->merge = values[0] == 6 ? MERGE_LIST : values[0] == 12 ? MERGE_LIST_PAGE : MERGE_STATS;
+      session->page_limit = values[2] == 0 || values[2] > LIST_PAGE_MAX ? LIST_PAGE_MAX : values[2];
+      for (unsigned int shard = 0; shard < num_shards; shard++) {
+        if (addStep(session, shard, line, 0) != 0) return 1;
+      }
+      return 0;
+
+    case 9:  // TEMPLATE, kept on every shard as bulk creations span them
+      session->merge = MERGE_STATUS;
+      for (unsigned int shard = 0; shard < num_shards; shard++) {
+        if (addStep(session, shard, line, 0) != 0) return 1;
+      }
+      return 0;
+
+    case 10: {  // CREATE_BULK, split in runs of ids that share a block
+      unsigned long first = values[2], count = values[3];
+      if (count == 0 || count > MAX_BULK_EVENTS || count - 1 > UINT_MAX - first) return addStep(session, 0, line, 0);
+
+      // Every run is checked on its shard first, so a missing template or a taken id creates no event anywhere. An
+      // event another client creates in the range between the check and the creation still fails only its run
+      session->merge = MERGE_STATUS;
+      for (unsigned long id = first; id < first + count;) {
+        unsigned long end = (id / SHARD_BLOCK_SIZE + 1) * SHARD_BLOCK_SIZE;
+        if (end > first + count) end = first + count;
+
+        char step[BUFFER_SIZE];
+        unsigned int shard = shardOf((unsigned int)id);
+        snprintf(step, sizeof(step), "10|%lu|%lu|%lu|1\n", values[1], id, end - id);
+        if (addStep(session, shard, step, 0) != 0) return 1;
+        snprintf(step, sizeof(step), "10|%lu|%lu|%lu\n", values[1], id, end - id);
+        if (addStep(session, shard, step, 1) != 0) return 1;
+        id = end;
+      }
+      return 0;
+    }
+
+    case 11:  // FORK, the seats of the event cannot move between shards
+      if (shardOf((unsigned int)values[1]) != shardOf((unsigned int)values[2])) {
+        fprintf(stderr, "[ERR]: fork across shards\n");
+        return 1;
+      }
+      return addStep(session, shardOf((unsigned int)values[1]), line, 0);
+
+    case 22: {  // RESERVE_MULTI, only atomic within a shard
+      strncpy(fields, line, sizeof(fields) - 1);
+      fields[sizeof(fields) - 1] = '\0';
+      strtok_r(fields, "|", &save);
+      strtok_r(NULL, "|", &save);
+
+      unsigned int shard = 0;
+      for (unsigned long i = 0; i < values[1]; i++) {
+        char* event = strtok_r(NULL, "|", &save);
+        char* seats = strtok_r(NULL, "|", &save);
+        if (event == NULL || seats == NULL) break;
+
+        unsigned int event_shard = shardOf((unsigned int)strtoul(event, NULL, 10));
+        if (i > 0 && event_shard != shard) {
+          fprintf(stderr, "[ERR]: package across shards\n");
+          return 1;
+        }
+        shard = event_shard;
+
+        for (unsigned long j = 2 * strtoul(seats, NULL, 10); j > 0; j--) strtok_r(NULL, "|", &save);
+      }
+      return addStep(session, shard, line, 0);
+    }
+
+    case 16:  // WAIT, any shard pauses the session the same
+      return addStep(session, 0, line, 0);
+
+    default:  // Requests on a single event, anything else is left for a backend to reject
+      return addStep(session, num_values > 1 ? shardOf((unsigned int)values[1]) : 0, line, 0);
+  }
+}
+
+/// Compares event ids for sorting.
+int compareIds(const void* a, const void* b) {
+  unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+  return (x > y) - (x < y);
+}
+
+/// Merges the ids listed by every shard, "0|count|id id ...|cursor" for pages and "0|count|id id ..." otherwise.
+/// @note A single server lists in creation order, but the shards do not share a creation order, so ids are listed in
+///       ascending order instead. The same events come out, in a different order when created out of id order.
+/// @param session Session of the client, with every step done.
+/// @param reply Text to store the reply in.
+/// @return 0 if the reply was built, 1 if a shard failed or memory ran out.
+int mergeIds(struct RouterSession* session, struct Text* reply) {
+  unsigned int* ids = NULL;
+  size_t num_ids = 0;
+  int has_cursor = 0;
+  unsigned int cursor = 0;  // Every shard covered the ids up to here
+  int ret = 0;
+
+  for (size_t i = 0; i < session->num_steps && ret == 0; i++) {
+    char* data = session->steps[i].reply.data;
+    if (data == NULL || atoi(data) != 0) {
+      ret = 1;
+      break;
+    }
+
+    char* list = strchr(data, '|');
+    if (list == NULL || strncmp(list, "|No events", 10) == 0) continue;
+    list = strchr(list + 1, '|');
+    if (list == NULL) {
+      ret = 1;
+      break;
+    }
+
+    while (ret == 0) {
+      char* next;
+      unsigned long id = strtoul(list + 1, &next, 10);
+      if (next == list + 1) break;
+
+      unsigned int* grown = realloc(ids, (num_ids + 1) * sizeof(unsigned int));
+      if (grown == NULL) {
+        ret = 1;
+        break;
+      }
+      ids = grown;
+      ids[num_ids++] = (unsigned int)id;
+      list = next;
+    }
+
+    // The cursor of a page follows the last "|"
+    if (session->merge == MERGE_LIST_PAGE) {
+      char* last = strrchr(data, '|');
+      if (last != NULL && last[1] != '-') {
+        unsigned int shard_cursor = (unsigned int)strtoul(last + 1, NULL, 10);
+        if (!has_cursor || shard_cursor < cursor) cursor = shard_cursor;
+        has_cursor = 1;
+      }
+    }
+  }
+
+  if (ret == 0 && ids != NULL) qsort(ids, num_ids, sizeof(unsigned int), compareIds);
+
+  // A shard that stopped early may still hold ids past its cursor, so none past the lowest cursor is listed
+  if (ret == 0 && session->merge == MERGE_LIST_PAGE) {
+    while (has_cursor && num_ids > 0 && ids[num_ids - 1] > cursor) num_ids--;
+    if (num_ids > session->page_limit) {
+      num_ids = session->page_limit;
+      cursor = ids[num_ids - 1];
+      has_cursor = 1;
+    }
+  }
+
+  char number[16];
+  if (ret == 0 && session->merge == MERGE_LIST && num_ids == 0) {
+    ret = appendText(reply, "0|No events", 11);
+  } else if (ret == 0) {
+    snprintf(number, sizeof(number), "0|%zu|", num_ids);
+    ret = appendText(reply, number, strlen(number));
+    for (size_t i = 0; i < num_ids && ret == 0; i++) {
+      snprintf(number, sizeof(number), "%u ", ids[i]);
+      ret = appendText(reply, number, strlen(number));
+    }
+
+    if (ret == 0 && session->merge == MERGE_LIST_PAGE) {
+      snprintf(number, sizeof(number), has_cursor ? "|%u" : "|-", cursor);
+      ret = appendText(reply, number, strlen(number));
+    }
+  }
+
+  free(ids);
+  if (ret == 0) ret = appendText(reply, "\n", 1);
+
+  // Past the response size of a single server the listing fails the same way
+  if (ret == 0 && reply->len >= BUFFER_SIZE - 10) {
+    fprintf(stderr, "Too many events to list, use a paginated list\n");
+    ret = 1;
+  }
+  return ret;
+}
+
+/// Merges the replies of the steps and sends the result to the client.
+/// @param session Session of the client, with every step done.
+/// @return 0 if the reply was sent, 1 otherwise.
+int sendReply(struct RouterSession* session) {
+  struct Text reply = {NULL, 0};
+  int failed = 0;
+  for (size_t i = 0; i < session->num_steps; i++) {
+    if (session->steps[i].reply.data == NULL || atoi(session->steps[i].reply.data) != 0) failed = 1;
+  }
+
+  int ret = 0;
+  switch (session->merge) {
+    case MERGE_FORWARD:
+      ret = appendText(&reply, session->steps[0].reply.data, session->steps[0].reply.len);
+      break;
+
+    case MERGE_STATUS:
+      ret = appendText(&reply, failed ? "1\n" : "0\n", 2);
+      break;
+
+    case MERGE_LIST:
+    case MERGE_LIST_PAGE:
+      if (mergeIds(session, &reply) != 0) {
+        reply.len = 0;
+        ret = appendText(&reply, "1\n", 2);
+      }
+      break;
+
+    case MERGE_STATS: {
+      // "0|<length>\n" followed by the table of every shard under its own title
+      struct Text tables = {NULL, 0};
+      for (size_t i = 0; i < session->num_steps && !failed && ret == 0; i++) {
+        char* body = strchr(session->steps[i].reply.data, '\n') + 1;
+        char title[32];
+        snprintf(title, sizeof(title), "Shard %u\n", session->steps[i].shard);
+        ret = appendText(&tables, title, strlen(title));
+        if (ret == 0) ret = appendText(&tables, body, strlen(body));
+      }
+
+      char header[32];
+      snprintf(header, sizeof(header), failed ? "1\n" : "0|%zu\n", tables.len);
+      if (ret == 0) ret = appendText(&reply, header, strlen(header));
+      if (ret == 0 && !failed && tables.len > 0) ret = appendText(&reply, tables.data, tables.len);
+      free(tables.data);
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  ret = ret != 0 || reply.data == NULL || writeAll(session->resp, reply.data, reply.len) != 0;
+  free(reply.data);
+  freeSteps(session);
+  return ret;
+}
+
+/// Starts serving the next request the client sent.
+/// @param session Session of the client, not serving a request, with a whole request in its input.
+/// @return 0 if the client can still be written to, 1 otherwise.
+int takeRequest(struct RouterSession* session) {
+  char* end = memchr(session->input, '\n', session->input_len);
+  char line[BUFFER_SIZE + 1];  // A request may fill the whole input, its terminator comes on top
+  size_t line_len = (size_t)(end - session->input) + 1;
+  memcpy(line, session->input, line_len);
+  line[line_len] = '\0';
+  memmove(session->input, session->input + line_len, session->input_len - line_len);
+  session->input_len -= line_len;
+
+  if (routeRequest(session, line) != 0 || session->steps == NULL) {
+    freeSteps(session);
+    return writeAll(session->resp, "1\n", 2);
+  }
+
+  sendSteps(session);
+  return 0;
+}
+
+/// Serves a client until it closes its pipes.
+/// @param arg Registration of the client, freed once read.
+void* serveSession(void* arg) {
+  struct RouterSession* session = calloc(1, sizeof(struct RouterSession));
+  char req_pipe[BUFFER_SIZE], resp_pipe[BUFFER_SIZE];
+  int valid = session != NULL &&
+              registration_parse(arg, req_pipe, resp_pipe, sizeof(req_pipe), &session->priority) == 0;
+  free(arg);
+
+  if (valid) session->resp = registration_open_response(resp_pipe);
+  if (valid && session->resp != -1) {
+    // Opened before the id is sent, so the client never waits for a reader
+    session->rx = open(req_pipe, O_RDONLY | O_NONBLOCK);
+    if (session->rx == -1) {
+      fprintf(stderr, "[ERR]: open req failed: %s\n", strerror(errno));
+      close(session->resp);
+      valid = 0;
+    }
+  } else {
+    valid = 0;
+  }
+
+  if (!valid) {
+    free(session);
+    __atomic_sub_fetch(&num_sessions, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  session->id = __atomic_add_fetch(&next_session, 1, __ATOMIC_RELAXED);
+  for (unsigned int shard = 0; shard < num_shards; shard++) {
+    session->backends[shard] = (struct Backend){.req = -1, .resp = -1, .step = SIZE_MAX};
+  }
+
+  char response[32];
+  snprintf(response, sizeof(response), "%u\n", session->id);
+  int closed = writeAll(session->resp, response, strlen(response));
+
+  struct pollfd fds[MAX_SHARDS + 1];
+  unsigned int polled[MAX_SHARDS];  // Shard behind each polled response pipe
+  while (!closed) {
+    // Requests are served one at a time, the client is only read between them
+    nfds_t first = session->steps == NULL ? 1 : 0;
+    nfds_t nfds = first;
+    if (first == 1) fds[0] = (struct pollfd){session->rx, POLLIN, 0};
+
+    // Shards are always polled, so notifications reach the client while it is idle
+    for (unsigned int shard = 0; shard < num_shards; shard++) {
+      if (session->backends[shard].resp == -1) continue;
+      polled[nfds - first] = shard;
+      fds[nfds++] = (struct pollfd){session->backends[shard].resp, POLLIN, 0};
+    }
+
+    if (poll(fds, nfds, -1) == -1) {
+      if (errno == EINTR) continue;
+      fprintf(stderr, "[ERR]: poll failed: %s\n", strerror(errno));
+      break;
+    }
+
+    if (first == 1 && fds[0].revents != 0) {
+      ssize_t ret = read(session->rx, session->input + session->input_len, sizeof(session->input) - session->input_len);
+      if (ret == 0 || (ret == -1 && errno != EAGAIN && errno != EINTR)) break;
+      if (ret > 0) session->input_len += (size_t)ret;
+
+      // A request that can never fit is dropped rather than stalling the session
+      if (session->input_len == sizeof(session->input) && memchr(session->input, '\n', session->input_len) == NULL) {
+        session->input_len = 0;
+      }
+    }
+
+    for (nfds_t i = first; i < nfds && !closed; i++) {
+      if (fds[i].revents != 0) closed = readBackend(session, polled[i - first]);
+    }
+
+    // Shards freed by a reply take their next step
+    if (session->steps != NULL) sendSteps(session);
+
+    // A finished request is answered, then the next whole one the client sent is taken
+    while (!closed) {
+      if (session->steps != NULL && session->steps_done == session->num_steps) {
+        closed = sendReply(session);
+      } else if (session->steps == NULL && memchr(session->input, '\n', session->input_len) != NULL) {
+        closed = takeRequest(session);
+      } else {
+        break;
+      }
+    }
+  }
+
+  fprintf(stderr, "[INFO]: session %u closed\n", session->id);
+  freeSteps(session);
+  for (unsigned int shard = 0; shard < num_shards; shard++) closeBackend(&session->backends[shard]);
+  close(session->rx);
+  close(session->resp);
+  free(session);
+  __atomic_sub_fetch(&num_sessions, 1, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+/// Starts the backend of a shard and opens its register pipe.
+/// @param pipe_path Register pipe of the router, the backend takes "<pipe_path>.<shard>".
+/// @param shard Shard served by the backend.
+/// @param delay Delay argument of the backend, NULL for its default.
+/// @return 0 if the backend is accepting registrations, 1 otherwise.
+int startShard(const char* pipe_path, unsigned int shard, const char* delay) {
+  char shard_pipe[BUFFER_SIZE];
+  snprintf(shard_pipe, sizeof(shard_pipe), "%s.%u", pipe_path, shard);
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    fprintf(stderr, "[ERR]: fork failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  if (pid == 0) {
+    // Backends do not outlive the router
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    execl("./ems", "ems", shard_pipe, delay, (char*)NULL);
+    fprintf(stderr, "[ERR]: exec failed: %s\n", strerror(errno));
+    _exit(1);
+  }
+
+  // The backend creates the pipe as "../<name>" and then reads it, until then opening fails
+  char path[BUFFER_SIZE + 3];
+  snprintf(path, sizeof(path), "../%s", shard_pipe);
+  for (unsigned int waited = 0; waited < SHARD_START_MS; waited += 10) {
+    shard_register[shard] = open(path, O_WRONLY | O_NONBLOCK);
+    if (shard_register[shard] != -1) break;
+    sleepMs(10);
+  }
+
+  int flags = shard_register[shard] == -1 ? -1 : fcntl(shard_register[shard], F_GETFL);
+  if (flags == -1 || fcntl(shard_register[shard], F_SETFL, flags & ~O_NONBLOCK) == -1) {
+    fprintf(stderr, "[ERR]: shard %u did not start\n", shard);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3 || argc > 4) {
+    fprintf(stderr, "Usage: %s <pipe_path> <num_shards> [delay]\n", argv[0]);
+    return 1;
+  }
+
+  char* endptr;
+  unsigned long shards = strtoul(argv[2], &endptr, 10);
+  if (*endptr != '\0' || shards == 0 || shards > MAX_SHARDS) {
+    fprintf(stderr, "Invalid number of shards, at most %d\n", MAX_SHARDS);
+    return 1;
+  }
+  num_shards = (unsigned int)shards;
+
+  // Shards and clients may vanish while they are written to
+  signal(SIGPIPE, SIG_IGN);
+
+  for (unsigned int shard = 0; shard < num_shards; shard++) {
+    if (startShard(argv[1], shard, argc == 4 ? argv[3] : NULL)) return 1;
+  }
+
+  char pipe_name[BUFFER_SIZE];
+  snprintf(pipe_name, sizeof(pipe_name), "../%s", argv[1]);
+  if (unlink(pipe_name) != 0 && errno != ENOENT) {
+      fprintf(stderr, "[ERR]: unlink failed: %s\n", strerror(errno));
+      return 1;
+  }
+
+  if (mkfifo(pipe_name, 0640) != 0) {
+      fprintf(stderr, "[ERR]: mkfifo failed: %s\n", strerror(errno));
+      return 1;
+  }
+
+  // Holding a write end means the register pipe never reports EOF between clients
+  int r_register_pipe = open(pipe_name, O_RDONLY | O_NONBLOCK);
+  int w_register_pipe = r_register_pipe == -1 ? -1 : open(pipe_name, O_WRONLY);
+  int flags = r_register_pipe == -1 ? -1 : fcntl(r_register_pipe, F_GETFL);
+  if (w_register_pipe == -1 || flags == -1 || fcntl(r_register_pipe, F_SETFL, flags & ~O_NONBLOCK) == -1) {
+      fprintf(stderr, "[ERR]: open failed: %s\n", strerror(errno));
+      return 1;
+  }
+
+  // Registrations are single lines shorter than PIPE_BUF, so they never interleave
+  char buffer[BUFFER_SIZE];
+  size_t pending = 0;
+  while (1) {
+    ssize_t ret = read(r_register_pipe, buffer + pending, BUFFER_SIZE - 1 - pending);
+    if (ret == -1 && errno == EINTR) continue;
+    if (ret == -1) {
+      fprintf(stderr, "[ERR]: read failed: %s\n", strerror(errno));
+      return 1;
+    }
+
+    pending += (size_t)ret;
+    buffer[pending] = 0;
+
+    char* line = buffer;
+    char* end;
+    while ((end = strchr(line, '\n')) != NULL) {
+      *end = '\0';
+
+      // Every session holds a thread and a session on each shard it uses, past the limit clients come back later
+      pthread_t thread;
+      char* registration = strdup(line);
+      if (registration == NULL || __atomic_add_fetch(&num_sessions, 1, __ATOMIC_RELAXED) > MAX_SESSIONS ||
+          pthread_create(&thread, NULL, serveSession, registration) != 0) {
+        if (registration != NULL) __atomic_sub_fetch(&num_sessions, 1, __ATOMIC_RELAXED);
+        fprintf(stderr, "[INFO]: router full, rejecting\n");
+        registration_reject(line, BUSY_RETRY_MS);
+        free(registration);
+      } else {
+        pthread_detach(thread);
+      }
+      line = end + 1;
+    }
+
+    // Keep a partial line for the next read, drop one that can never fit
+    pending = strlen(line);
+    if (pending == BUFFER_SIZE - 1) pending = 0;
+    memmove(buffer, line, pending);
+  }
+
+  return 0;
+}
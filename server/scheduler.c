@@ -0,0 +1,126 @@
+#include "scheduler.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "common/constants.h"
+#include "lockstats.h"
+#include "opstats.h"
+
+/// Tasks of a priority, oldest first.
+struct TaskQueue {
+  struct Task* head;
+  struct Task* tail;
+};
+
+static struct TaskQueue queues[SCHEDULER_MAX_NODES][NUM_PRIORITIES];
+static pthread_mutex_t queues_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queues_cond[SCHEDULER_MAX_NODES] = {
+    PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+static size_t idle_workers[SCHEDULER_MAX_NODES];  // Workers of each node waiting for a task
+static size_t wakeups[SCHEDULER_MAX_NODES];       // Idle workers of each node signalled but not yet awake
+static size_t num_tasks = 0;
+
+void scheduler_submit(struct Task* task, unsigned int priority, unsigned int node) {
+  if (priority >= NUM_PRIORITIES) priority = NUM_PRIORITIES - 1;
+  task->priority = priority;
+  task->node = node % SCHEDULER_MAX_NODES;
+  task->submitted = op_stats_now();
+  task->next = NULL;
+
+  STAT_MUTEX_LOCK(&queues_mutex, LOCK_CLASS_QUEUE, 0);
+  struct TaskQueue* queue = &queues[task->node][priority];
+  if (queue->tail == NULL) {
+    queue->head = task;
+  } else {
+    queue->tail->next = task;
+  }
+  queue->tail = task;
+  num_tasks++;
+
+  // A worker already signalled wakes up anyway, so only one left idle is woken. One of another node is only woken
+  // when none of the node is left, it then takes the task over. With none left at all, a busy worker takes the task
+  // when it comes back
+  for (unsigned int i = 0; i < SCHEDULER_MAX_NODES; i++) {
+    unsigned int wake = (task->node + i) % SCHEDULER_MAX_NODES;
+    if (idle_workers[wake] > wakeups[wake]) {
+      wakeups[wake]++;
+      pthread_cond_signal(&queues_cond[wake]);
+      break;
+    }
+  }
+  STAT_MUTEX_UNLOCK(&queues_mutex, LOCK_CLASS_QUEUE, 0);
+}
+
+struct Task* scheduler_take(unsigned int node) {
+  node %= SCHEDULER_MAX_NODES;
+
+  STAT_MUTEX_LOCK(&queues_mutex, LOCK_CLASS_QUEUE, 0);
+  if (num_tasks == 0) {
+    idle_workers[node]++;
+    do {
+      STAT_COND_WAIT(&queues_cond[node], &queues_mutex, LOCK_CLASS_QUEUE);
+      // Awake either way: its signal is used up even if another worker or a cancel emptied the queues meanwhile
+      if (wakeups[node] > 0) wakeups[node]--;
+    } while (num_tasks == 0);
+    idle_workers[node]--;
+  }
+
+  // Only the heads matter: they are the oldest, so the most aged, of their queue
+  uint64_t now = op_stats_now();
+  struct TaskQueue* best = NULL;
+  uint64_t best_rank = 0;
+  int best_local = 0;
+  for (unsigned int i = 0; i < SCHEDULER_MAX_NODES; i++) {
+    for (unsigned int priority = 0; priority < NUM_PRIORITIES; priority++) {
+      struct Task* head = queues[i][priority].head;
+      if (head == NULL) continue;
+
+      uint64_t promoted = (now - head->submitted) / SCHEDULER_AGING_NS;
+      uint64_t rank = promoted >= priority ? 0 : priority - promoted;
+      int local = i == node;
+      // Ties go to the node of the worker, then to the oldest, so an aged task does overtake a steady stream of
+      // newer urgent ones
+      if (best == NULL || rank < best_rank ||
+          (rank == best_rank && (local > best_local ||
+                                 (local == best_local && head->submitted < best->head->submitted)))) {
+        best = &queues[i][priority];
+        best_rank = rank;
+        best_local = local;
+      }
+    }
+  }
+
+  struct Task* task = best->head;
+  best->head = task->next;
+  if (best->head == NULL) best->tail = NULL;
+  num_tasks--;
+  STAT_MUTEX_UNLOCK(&queues_mutex, LOCK_CLASS_QUEUE, 0);
+
+  return task;
+}
+
+int scheduler_cancel(struct Task* task) {
+  STAT_MUTEX_LOCK(&queues_mutex, LOCK_CLASS_QUEUE, 0);
+  struct TaskQueue* queue = &queues[task->node][task->priority];
+  struct Task* prev = NULL;
+  struct Task* current = queue->head;
+  while (current != NULL && current != task) {
+    prev = current;
+    current = current->next;
+  }
+
+  if (current != NULL) {
+    if (prev == NULL) {
+      queue->head = task->next;
+    } else {
+      prev->next = task->next;
+    }
+    if (queue->tail == task) queue->tail = prev;
+    num_tasks--;
+  }
+  STAT_MUTEX_UNLOCK(&queues_mutex, LOCK_CLASS_QUEUE, 0);
+
+  return current == NULL;
+}
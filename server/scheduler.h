@@ -0,0 +1,37 @@
+#ifndef SERVER_SCHEDULER_H
+#define SERVER_SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_AGING_NS 20000000ULL  // Time a task waits to be treated as one priority higher
+#define SCHEDULER_MAX_NODES 8           // NUMA nodes with queues of their own
+
+/// Unit of work queued for the worker pool.
+struct Task {
+  void* arg;              /// What the worker runs, owned by the caller.
+  unsigned int priority;  /// Priority it was submitted with, PRIORITY_HIGH first.
+  unsigned int node;      /// Node whose workers it was submitted to.
+  uint64_t submitted;     /// When it was submitted, CLOCK_MONOTONIC in nanoseconds.
+  struct Task* next;      /// Next task of the same priority.
+};
+
+/// Queues a task behind the others of its priority and node, and wakes a worker, one of the node if any is idle.
+/// @param task Task to be queued, must stay valid until it is taken.
+/// @param priority Priority of the task, clamped to the lowest one.
+/// @param node Node whose workers should run the task, 0 when placement is not used.
+void scheduler_submit(struct Task* task, unsigned int priority, unsigned int node);
+
+/// Takes the most urgent task, waiting for one if there is none.
+/// @note The head of each queue is compared after aging, so a low priority task that waited long enough runs
+///       ahead of newer high priority ones instead of starving. Among equally urgent tasks those of the node of
+///       the worker go first, but a worker never idles while a task of another node waits.
+/// @param node Node of the calling worker.
+/// @return Task taken.
+struct Task* scheduler_take(unsigned int node);
+
+/// Takes a task back out of its queue before a worker gets it.
+/// @param task Task that was submitted.
+/// @return 0 if the task was removed, 1 if a worker already took it.
+int scheduler_cancel(struct Task* task);
+
+#endif  // SERVER_SCHEDULER_H
@@ -0,0 +1,159 @@
+#define _GNU_SOURCE  // MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE
+#include "seats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Every never-written chunk points here; its reference is never dropped to 0
+static struct SeatChunk zero_chunk = {1, NULL, {0}};
+
+// Taken by the seat maps whose slab could not be mapped, so the mapping is only tried once
+static struct SeatSlab no_slab = {1, 0, NULL};
+
+static int use_huge_pages = 1;
+
+void seat_map_use_huge_pages(int enable) { __atomic_store_n(&use_huge_pages, enable != 0, __ATOMIC_RELAXED); }
+
+/// Maps a slab with a slot for every chunk of a seat map.
+/// @note Explicit huge pages are tried first, then transparent ones. Slots are zeroed by the kernel, and pages are
+///       only backed once written.
+/// @param num_chunks Number of chunks of the seat map.
+/// @return Slab held by the seat map, &no_slab on failure.
+static struct SeatSlab* slab_create(size_t num_chunks) {
+  struct SeatSlab* slab = malloc(sizeof(struct SeatSlab));
+  if (slab == NULL) return &no_slab;
+
+  slab->live = 1;
+  slab->length = (num_chunks * sizeof(struct SeatChunk) + SEAT_HUGE_PAGE_SIZE - 1) & ~(size_t)(SEAT_HUGE_PAGE_SIZE - 1);
+
+  void* base = MAP_FAILED;
+  if (__atomic_load_n(&use_huge_pages, __ATOMIC_RELAXED)) {
+    base = mmap(NULL, slab->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+
+  // Without reserved huge pages the kernel may still back a large enough mapping with transparent ones
+  if (base == MAP_FAILED) {
+    base = mmap(NULL, slab->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      free(slab);
+      return &no_slab;
+    }
+    madvise(base, slab->length, __atomic_load_n(&use_huge_pages, __ATOMIC_RELAXED) ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+  }
+
+  slab->chunks = base;
+  return slab;
+}
+
+/// Drops a reference to a slab, unmapping it once none of its chunks is used anymore.
+/// @param slab Slab to be released.
+static void slab_put(struct SeatSlab* slab) {
+  if (slab->chunks == NULL) return;
+  if (__atomic_sub_fetch(&slab->live, 1, __ATOMIC_ACQ_REL) == 0) {
+    munmap(slab->chunks, slab->length);
+    free(slab);
+  }
+}
+
+/// Allocates the private copy of a chunk of a seat map.
+/// @param map Seat map owning the copy.
+/// @param index Index of the chunk.
+/// @return Uninitialized chunk, NULL on failure.
+static struct SeatChunk* chunk_alloc(struct SeatMap* map, size_t index) {
+  if (map->slab == NULL && map->num_chunks * sizeof(struct SeatChunk) >= SEAT_HUGE_PAGE_SIZE) {
+    map->slab = slab_create(map->num_chunks);
+  }
+
+  // Only the owner writes the slab of a slot, other seat maps sharing the chunk just drop references to it
+  if (map->slab != NULL && map->slab->chunks != NULL && map->slab->chunks[index].slab == NULL) {
+    struct SeatChunk* chunk = &map->slab->chunks[index];
+    chunk->slab = map->slab;
+    __atomic_add_fetch(&map->slab->live, 1, __ATOMIC_RELAXED);
+    return chunk;
+  }
+
+  struct SeatChunk* chunk = malloc(sizeof(struct SeatChunk));
+  if (chunk != NULL) chunk->slab = NULL;
+  return chunk;
+}
+
+/// Takes a reference to a chunk.
+/// @param chunk Chunk to be referenced.
+static void chunk_get(struct SeatChunk* chunk) { __atomic_add_fetch(&chunk->refs, 1, __ATOMIC_RELAXED); }
+
+/// Drops a reference to a chunk, freeing it when no seat map uses it anymore.
+/// @param chunk Chunk to be released.
+static void chunk_put(struct SeatChunk* chunk) {
+  if (__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+  // A slot of a slab stays marked as taken, it is unmapped with the rest of the slab
+  if (chunk->slab != NULL) {
+    slab_put(chunk->slab);
+  } else {
+    free(chunk);
+  }
+}
+
+int seat_map_init(struct SeatMap* map, size_t size) {
+  map->size = size;
+  map->num_chunks = (size + SEAT_CHUNK_SIZE - 1) / SEAT_CHUNK_SIZE;
+  map->slab = NULL;
+  map->chunks = malloc((map->num_chunks == 0 ? 1 : map->num_chunks) * sizeof(struct SeatChunk*));
+  if (map->chunks == NULL) return 1;
+
+  for (size_t i = 0; i < map->num_chunks; i++) {
+    chunk_get(&zero_chunk);
+    map->chunks[i] = &zero_chunk;
+  }
+
+  return 0;
+}
+
+int seat_map_share(struct SeatMap* map, const struct SeatMap* from) {
+  map->size = from->size;
+  map->num_chunks = from->num_chunks;
+  map->slab = NULL;
+  map->chunks = malloc((map->num_chunks == 0 ? 1 : map->num_chunks) * sizeof(struct SeatChunk*));
+  if (map->chunks == NULL) return 1;
+
+  for (size_t i = 0; i < map->num_chunks; i++) {
+    chunk_get(from->chunks[i]);
+    map->chunks[i] = from->chunks[i];
+  }
+
+  return 0;
+}
+
+void seat_map_destroy(struct SeatMap* map) {
+  if (map->chunks == NULL) return;
+
+  for (size_t i = 0; i < map->num_chunks; i++) {
+    chunk_put(map->chunks[i]);
+  }
+
+  free(map->chunks);
+  map->chunks = NULL;
+
+  if (map->slab != NULL) slab_put(map->slab);
+  map->slab = NULL;
+}
+
+unsigned int* seat_map_ref(struct SeatMap* map, size_t index) {
+  size_t i = index >> SEAT_CHUNK_SHIFT;
+  struct SeatChunk* chunk = map->chunks[i];
+
+  // Only holders of a chunk can share it further, so a sole owner may write in place
+  if (__atomic_load_n(&chunk->refs, __ATOMIC_ACQUIRE) != 1) {
+    struct SeatChunk* copy = chunk_alloc(map, i);
+    if (copy == NULL) return NULL;
+
+    copy->refs = 1;
+    memcpy(copy->seats, chunk->seats, sizeof(copy->seats));
+    map->chunks[i] = copy;
+    chunk_put(chunk);
+    chunk = copy;
+  }
+
+  return &chunk->seats[index & (SEAT_CHUNK_SIZE - 1)];
+}
@@ -0,0 +1,85 @@
+#ifndef SERVER_SEATS_H
+#define SERVER_SEATS_H
+
+#include <stddef.h>
+
+#define SEAT_CHUNK_SHIFT 10
+#define SEAT_CHUNK_SIZE (1u << SEAT_CHUNK_SHIFT)  // Seats per chunk (4 KiB)
+#define SEAT_HUGE_PAGE_SIZE (2u << 20)            // Seat maps of at least this many bytes get a slab
+
+struct SeatSlab;
+
+/// Fixed-size block of seats, shared copy-on-write between seat maps.
+struct SeatChunk {
+  unsigned int refs;                    /// Number of seat maps using the chunk.
+  struct SeatSlab* slab;                /// Slab the chunk was carved from, NULL if it was allocated on its own.
+  unsigned int seats[SEAT_CHUNK_SIZE];  /// Reservation id of each seat, 0 if free.
+};
+
+/// Region the chunks of a large seat map are carved from, backed by huge pages when the system has them.
+/// @note Slot i only ever holds the first copy of chunk i of the seat map, later copies are allocated on their own.
+struct SeatSlab {
+  size_t live;               /// Chunks of the slab still referenced, plus one while its seat map lives.
+  size_t length;             /// Bytes mapped.
+  struct SeatChunk* chunks;  /// Slots, one per chunk of the seat map, NULL if the slab could not be mapped.
+};
+
+/// Reservations of every seat of an event, split in copy-on-write chunks.
+struct SeatMap {
+  size_t size;                 /// Number of seats.
+  size_t num_chunks;           /// Number of chunks.
+  struct SeatChunk** chunks;   /// Chunk table, seat i lives in chunks[i / SEAT_CHUNK_SIZE].
+  struct SeatSlab* slab;       /// Slab of the written chunks, NULL until the first write of a large seat map.
+};
+
+/// Chooses whether large seat maps are backed by huge pages, they are by default.
+/// @note Only affects seat maps written for the first time afterwards.
+/// @param enable 0 to carve slabs from regular pages, anything else to ask for huge pages.
+void seat_map_use_huge_pages(int enable);
+
+/// Initializes a seat map with every seat free.
+/// @note No seat memory is allocated until a seat is written.
+/// @param map Seat map to be initialized.
+/// @param size Number of seats.
+/// @return 0 if the seat map was initialized successfully, 1 otherwise.
+int seat_map_init(struct SeatMap* map, size_t size);
+
+/// Initializes a seat map sharing every chunk of another one.
+/// @note Costs one pointer per chunk, seats are copied when first written.
+/// @param map Seat map to be initialized.
+/// @param from Seat map to be shared. Writers of it must be excluded during the call.
+/// @return 0 if the seat map was initialized successfully, 1 otherwise.
+int seat_map_share(struct SeatMap* map, const struct SeatMap* from);
+
+/// Releases the chunks of a seat map.
+/// @param map Seat map to be destroyed.
+void seat_map_destroy(struct SeatMap* map);
+
+/// Gets a writable reference to a seat, copying its chunk if it is shared.
+/// @note The first write of a seat map of at least SEAT_HUGE_PAGE_SIZE bytes maps its slab, falling back to
+///       allocating chunks on their own if that fails.
+/// @param map Seat map to be modified.
+/// @param index Index of the seat.
+/// @return Pointer to the seat, NULL on failure.
+unsigned int* seat_map_ref(struct SeatMap* map, size_t index);
+
+/// Gets the reservation id of a seat.
+/// @param map Seat map to be read.
+/// @param index Index of the seat.
+/// @return Reservation id of the seat, 0 if free.
+static inline unsigned int seat_map_get(const struct SeatMap* map, size_t index) {
+  return map->chunks[index >> SEAT_CHUNK_SHIFT]->seats[index & (SEAT_CHUNK_SIZE - 1)];
+}
+
+/// Gets the seats stored side by side from a seat on, up to the end of its chunk or of the seat map.
+/// @param map Seat map to be read.
+/// @param index Index of the first seat.
+/// @param count Set to the number of seats of the run.
+/// @return Reservation ids of the seats of the run.
+static inline const unsigned int* seat_map_run(const struct SeatMap* map, size_t index, size_t* count) {
+  size_t offset = index & (SEAT_CHUNK_SIZE - 1);
+  *count = SEAT_CHUNK_SIZE - offset < map->size - index ? SEAT_CHUNK_SIZE - offset : map->size - index;
+  return map->chunks[index >> SEAT_CHUNK_SHIFT]->seats + offset;
+}
+
+#endif  // SERVER_SEATS_H
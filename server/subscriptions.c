@@ -0,0 +1,287 @@
+#include "subscriptions.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct Subscriber** registry = NULL;
+static size_t registry_size = 0;
+static size_t registry_capacity = 0;
+
+static sem_t pending;  // Posted whenever a subscriber may have something to send
+
+/// Drops one reference to a subscriber, freeing it when no owner is left.
+/// @note Must be called with the subscriber mutex held; it is released here.
+/// @param subscriber Subscriber to be released.
+static void subscriber_release_locked(struct Subscriber* subscriber) {
+  unsigned int refs = --subscriber->refs;
+  pthread_mutex_unlock(&subscriber->mutex);
+
+  if (refs == 0) {
+    pthread_mutex_destroy(&subscriber->mutex);
+    pthread_mutex_destroy(&subscriber->reply_mutex);
+    free(subscriber);
+  }
+}
+
+/// Writes a notification line without blocking.
+/// @param fd Non-blocking file descriptor to write to.
+/// @param line Line to be written, shorter than PIPE_BUF so the write is atomic.
+/// @return 0 if the line was written, 1 if the pipe is full or broken.
+static int push_line(int fd, const char* line) {
+  size_t len = strlen(line);
+  ssize_t written = write(fd, line, len);
+  return written != (ssize_t)len;
+}
+
+/// Sends every queued notification of a subscriber.
+/// @note A subscriber whose pipe is full loses its queue and gets a resync instead. One in the middle of a reply
+///       keeps its queue, subscriber_end_reply wakes the notifier again.
+/// @param subscriber Subscriber to be flushed.
+static void subscriber_flush(struct Subscriber* subscriber) {
+  struct Notification batch[SUBSCRIBER_QUEUE_SIZE];
+  size_t count = 0;
+  int resync = 0;
+  int fd;
+
+  pthread_mutex_lock(&subscriber->mutex);
+  if (pthread_mutex_trylock(&subscriber->reply_mutex) != 0) {
+    pthread_mutex_unlock(&subscriber->mutex);
+    return;
+  }
+
+  fd = subscriber->fd;
+  if (__atomic_exchange_n(&subscriber->needs_resync, 0, __ATOMIC_RELAXED)) {
+    resync = 1;
+  } else {
+    for (; count < subscriber->count; count++) {
+      batch[count] = subscriber->queue[(subscriber->head + count) % SUBSCRIBER_QUEUE_SIZE];
+    }
+  }
+  subscriber->head = 0;
+  subscriber->count = 0;
+  pthread_mutex_unlock(&subscriber->mutex);
+
+  if (fd == -1) {
+    pthread_mutex_unlock(&subscriber->reply_mutex);
+    return;
+  }
+
+  int failed = 0;
+  if (resync) {
+    failed = push_line(fd, "R\n");
+  }
+
+  for (size_t i = 0; i < count && !failed; i++) {
+    char line[64];
+    snprintf(line, sizeof(line), "N|%u|%u|%zu\n", batch[i].event_id, batch[i].reservation_id, batch[i].num_seats);
+    failed = push_line(fd, line);
+  }
+  pthread_mutex_unlock(&subscriber->reply_mutex);
+
+  if (failed) {
+    pthread_mutex_lock(&subscriber->mutex);
+    subscriber->needs_resync = 1;
+    pthread_mutex_unlock(&subscriber->mutex);
+  }
+}
+
+/// Notifier thread: wakes up on publications and drains every subscriber.
+static void* notifier(void* arg) {
+  (void)arg;
+
+  while (1) {
+    if (sem_wait(&pending) != 0) {
+      if (errno == EINTR) continue;
+      fprintf(stderr, "[ERR]: notifier wait failed: %s\n", strerror(errno));
+      return NULL;
+    }
+
+    // Coalesce wake-ups, a single pass drains everything queued so far
+    while (sem_trywait(&pending) == 0)
+      ;
+
+    pthread_mutex_lock(&registry_mutex);
+    for (size_t i = 0; i < registry_size; i++) {
+      subscriber_flush(registry[i]);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+  }
+}
+
+int subscriptions_init() {
+  if (sem_init(&pending, 0, 0) != 0) {
+    fprintf(stderr, "Error initializing notifier semaphore\n");
+    return 1;
+  }
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, notifier, NULL) != 0) {
+    fprintf(stderr, "Error creating notifier thread\n");
+    return 1;
+  }
+
+  pthread_detach(thread);
+  return 0;
+}
+
+struct Subscriber* subscriber_create(const char* resp_pipe) {
+  struct Subscriber* subscriber = malloc(sizeof(struct Subscriber));
+  if (subscriber == NULL) return NULL;
+
+  // A separate open file description keeps the session replies blocking
+  subscriber->fd = open(resp_pipe, O_WRONLY | O_NONBLOCK);
+  if (subscriber->fd == -1) {
+    fprintf(stderr, "[ERR]: open notify failed: %s\n", strerror(errno));
+    free(subscriber);
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&subscriber->mutex, NULL) != 0) {
+    close(subscriber->fd);
+    free(subscriber);
+    return NULL;
+  }
+
+  if (pthread_mutex_init(&subscriber->reply_mutex, NULL) != 0) {
+    pthread_mutex_destroy(&subscriber->mutex);
+    close(subscriber->fd);
+    free(subscriber);
+    return NULL;
+  }
+
+  subscriber->active = 1;
+  subscriber->needs_resync = 0;
+  subscriber->refs = 1;
+  subscriber->head = 0;
+  subscriber->count = 0;
+
+  pthread_mutex_lock(&registry_mutex);
+  if (registry_size == registry_capacity) {
+    size_t capacity = registry_capacity == 0 ? 8 : registry_capacity * 2;
+    struct Subscriber** grown = realloc(registry, capacity * sizeof(struct Subscriber*));
+    if (grown == NULL) {
+      pthread_mutex_unlock(&registry_mutex);
+      close(subscriber->fd);
+      pthread_mutex_destroy(&subscriber->mutex);
+      pthread_mutex_destroy(&subscriber->reply_mutex);
+      free(subscriber);
+      return NULL;
+    }
+    registry = grown;
+    registry_capacity = capacity;
+  }
+  registry[registry_size++] = subscriber;
+  pthread_mutex_unlock(&registry_mutex);
+
+  return subscriber;
+}
+
+void subscriber_close(struct Subscriber* subscriber) {
+  if (subscriber == NULL) return;
+
+  pthread_mutex_lock(&registry_mutex);
+  for (size_t i = 0; i < registry_size; i++) {
+    if (registry[i] == subscriber) {
+      registry[i] = registry[--registry_size];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&registry_mutex);
+
+  pthread_mutex_lock(&subscriber->mutex);
+  subscriber->active = 0;
+  close(subscriber->fd);
+  subscriber->fd = -1;
+  subscriber->count = 0;
+  subscriber_release_locked(subscriber);
+}
+
+void subscriber_begin_reply(struct Subscriber* subscriber) {
+  if (subscriber != NULL) pthread_mutex_lock(&subscriber->reply_mutex);
+}
+
+void subscriber_end_reply(struct Subscriber* subscriber) {
+  if (subscriber == NULL) return;
+  pthread_mutex_unlock(&subscriber->reply_mutex);
+
+  // The notifier skipped whatever was queued during the reply
+  pthread_mutex_lock(&subscriber->mutex);
+  int queued = subscriber->count > 0 || __atomic_load_n(&subscriber->needs_resync, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&subscriber->mutex);
+  if (queued) sem_post(&pending);
+}
+
+int subscription_add(struct Subscription** list, struct Subscriber* subscriber) {
+  for (struct Subscription* current = *list; current != NULL; current = current->next) {
+    if (current->subscriber == subscriber) return 0;
+  }
+
+  struct Subscription* node = malloc(sizeof(struct Subscription));
+  if (node == NULL) return 1;
+
+  pthread_mutex_lock(&subscriber->mutex);
+  subscriber->refs++;
+  pthread_mutex_unlock(&subscriber->mutex);
+
+  node->subscriber = subscriber;
+  node->next = *list;
+  *list = node;
+  return 0;
+}
+
+void subscription_publish(struct Subscription** list, const struct Notification* notification) {
+  int published = 0;
+  struct Subscription** link = list;
+
+  while (*link != NULL) {
+    struct Subscription* node = *link;
+    struct Subscriber* subscriber = node->subscriber;
+
+    // Never wait behind the notifier, a busy subscriber just misses this one
+    if (pthread_mutex_trylock(&subscriber->mutex) != 0) {
+      __atomic_store_n(&subscriber->needs_resync, 1, __ATOMIC_RELAXED);
+      published = 1;
+      link = &node->next;
+      continue;
+    }
+
+    if (!subscriber->active) {
+      *link = node->next;
+      free(node);
+      subscriber_release_locked(subscriber);
+      continue;
+    }
+
+    if (subscriber->count == SUBSCRIBER_QUEUE_SIZE) {
+      subscriber->needs_resync = 1;
+    } else {
+      subscriber->queue[(subscriber->head + subscriber->count) % SUBSCRIBER_QUEUE_SIZE] = *notification;
+      subscriber->count++;
+    }
+    pthread_mutex_unlock(&subscriber->mutex);
+
+    published = 1;
+    link = &node->next;
+  }
+
+  if (published) sem_post(&pending);
+}
+
+void subscription_free_list(struct Subscription** list) {
+  struct Subscription* current = *list;
+  while (current != NULL) {
+    struct Subscription* next = current->next;
+    pthread_mutex_lock(&current->subscriber->mutex);
+    subscriber_release_locked(current->subscriber);
+    free(current);
+    current = next;
+  }
+  *list = NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef SERVER_SUBSCRIPTIONS_H
+#define SERVER_SUBSCRIPTIONS_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define SUBSCRIBER_QUEUE_SIZE 64
+
+/// Compact change notification pushed to subscribers.
+struct Notification {
+  unsigned int event_id;        /// Event that was modified.
+  unsigned int reservation_id;  /// Reservation that modified it.
+  size_t num_seats;             /// Number of seats in the reservation.
+};
+
+/// Per-session subscriber with a bounded notification queue.
+struct Subscriber {
+  int fd;                       /// Non-blocking descriptor of the session response pipe, -1 once closed.
+  int active;                   /// 0 once the session has ended.
+  int needs_resync;             /// Set when notifications were dropped.
+  unsigned int refs;            /// Number of owners (session + event subscription lists).
+  size_t head;                  /// Index of the oldest queued notification.
+  size_t count;                 /// Number of queued notifications.
+  pthread_mutex_t mutex;        /// Mutex to protect the subscriber.
+  pthread_mutex_t reply_mutex;  /// Held while a reply is written, so no notification lands inside it.
+  struct Notification queue[SUBSCRIBER_QUEUE_SIZE];
+};
+
+/// Node of the per-event subscriber list.
+struct Subscription {
+  struct Subscriber* subscriber;
+  struct Subscription* next;
+};
+
+/// Starts the notifier thread that drains subscriber queues.
+/// @return 0 if the notifier was started successfully, 1 otherwise.
+int subscriptions_init();
+
+/// Creates a subscriber that pushes to the given response pipe.
+/// @param resp_pipe Path of the session response pipe.
+/// @return Newly created subscriber, NULL on failure.
+struct Subscriber* subscriber_create(const char* resp_pipe);
+
+/// Ends the session side of a subscriber. Event lists drop it lazily.
+/// @param subscriber Subscriber to be closed.
+void subscriber_close(struct Subscriber* subscriber);
+
+/// Keeps notifications off the response pipe while a reply is written to it.
+/// @note Replies longer than PIPE_BUF are not written atomically, a notification could otherwise split them.
+/// @param subscriber Subscriber of the session, NULL if it has none.
+void subscriber_begin_reply(struct Subscriber* subscriber);
+
+/// Lets notifications through again once a reply was written, sending those queued meanwhile.
+/// @note Must be called by the thread that called subscriber_begin_reply.
+/// @param subscriber Subscriber of the session, NULL if it has none.
+void subscriber_end_reply(struct Subscriber* subscriber);
+
+/// Adds a subscriber to an event subscriber list.
+/// @note Must be called with the event mutex held.
+/// @param list Subscriber list of the event.
+/// @param subscriber Subscriber to be added.
+/// @return 0 if the subscriber was added successfully, 1 otherwise.
+int subscription_add(struct Subscription** list, struct Subscriber* subscriber);
+
+/// Queues a notification for every subscriber of an event without blocking.
+/// @note Must be called with the event mutex held. Busy or full queues drop the
+///       notification and flag the subscriber for a resync.
+/// @param list Subscriber list of the event.
+/// @param notification Notification to be published.
+void subscription_publish(struct Subscription** list, const struct Notification* notification);
+
+/// Releases every node of an event subscriber list.
+/// @param list Subscriber list of the event.
+void subscription_free_list(struct Subscription** list);
+
+#endif  // SERVER_SUBSCRIPTIONS_H
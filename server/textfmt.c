@@ -0,0 +1,130 @@
+#include "textfmt.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BLOCK_VALUES 8                     // Values written per step of the unchecked loop
+#define BLOCK_TEXT (BLOCK_VALUES * 11)     // Longest text of a block, 10 digits and a separator per value
+
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const unsigned long long powers_of_ten[TEXT_UINT_SIZE] = {
+    1ull,
+    10ull,
+    100ull,
+    1000ull,
+    10000ull,
+    100000ull,
+    1000000ull,
+    10000000ull,
+    100000000ull,
+    1000000000ull,
+    10000000000ull,
+    100000000000ull,
+    1000000000000ull,
+    10000000000000ull,
+    100000000000000ull,
+    1000000000000000ull,
+    10000000000000000ull,
+    100000000000000000ull,
+    1000000000000000000ull,
+    10000000000000000000ull,
+};
+
+/// Counts the decimal digits of a value.
+/// @param value Value to be measured.
+/// @return Number of digits, 1 for 0.
+static size_t num_digits(size_t value) {
+  size_t digits = 1;
+  while (digits < TEXT_UINT_SIZE && value >= powers_of_ten[digits]) digits++;
+  return digits;
+}
+
+/// Writes a value whose number of digits is known, from its last two digits backwards.
+/// @param dest Destination, with room for the digits.
+/// @param value Value to be written.
+/// @param digits Number of digits of the value.
+static void write_digits(char* dest, size_t value, size_t digits) {
+  char* end = dest + digits;
+  while (value >= 100) {
+    end -= 2;
+    memcpy(end, digit_pairs + value % 100 * 2, 2);
+    value /= 100;
+  }
+
+  if (value >= 10) {
+    memcpy(end - 2, digit_pairs + value * 2, 2);
+  } else {
+    end[-1] = (char)('0' + value);
+  }
+}
+
+/// Writes the text of BLOCK_VALUES free seats if the next values are all 0.
+/// @param dest Destination, with room for 2 * BLOCK_VALUES characters.
+/// @param values Next BLOCK_VALUES values.
+/// @param separator Character written after each value.
+/// @return Whether the values were all 0 and written.
+static int write_free_block(char* dest, const unsigned int* values, char separator) {
+#ifdef __SSE2__
+  __m128i taken = _mm_or_si128(_mm_loadu_si128((const __m128i*)values), _mm_loadu_si128((const __m128i*)(values + 4)));
+  if (_mm_movemask_epi8(_mm_cmpeq_epi32(taken, _mm_setzero_si128())) != 0xFFFF) return 0;
+
+  // x86 is little-endian, so each 16-bit lane holds '0' followed by the separator
+  _mm_storeu_si128((__m128i*)dest, _mm_set1_epi16((short)((unsigned char)separator << 8 | '0')));
+#else
+  unsigned int taken = 0;
+  for (size_t i = 0; i < BLOCK_VALUES; i++) taken |= values[i];
+  if (taken != 0) return 0;
+
+  for (size_t i = 0; i < BLOCK_VALUES; i++) {
+    dest[2 * i] = '0';
+    dest[2 * i + 1] = separator;
+  }
+#endif
+  return 1;
+}
+
+size_t text_uint(char* dest, size_t value) {
+  size_t digits = num_digits(value);
+  write_digits(dest, value, digits);
+  return digits;
+}
+
+size_t text_uints(char* dest, size_t size, const unsigned int* values, size_t count, char separator, size_t* len) {
+  size_t pos = 0;
+  size_t i = 0;
+
+  // While a whole block of the widest values fits, only the end of the values is checked
+  while (count - i >= BLOCK_VALUES && size - pos >= BLOCK_TEXT) {
+    if (write_free_block(dest + pos, values + i, separator)) {
+      pos += 2 * BLOCK_VALUES;
+      i += BLOCK_VALUES;
+      continue;
+    }
+
+    for (size_t end = i + BLOCK_VALUES; i < end; i++) {
+      pos += text_uint(dest + pos, values[i]);
+      dest[pos++] = separator;
+    }
+  }
+
+  for (; i < count; i++) {
+    size_t digits = num_digits(values[i]);
+    if (size - pos < digits + 1) break;
+
+    write_digits(dest + pos, values[i], digits);
+    pos += digits;
+    dest[pos++] = separator;
+  }
+
+  *len = pos;
+  return i;
+}
@@ -0,0 +1,25 @@
+#ifndef SERVER_TEXT_FMT_H
+#define SERVER_TEXT_FMT_H
+
+#include <stddef.h>
+
+#define TEXT_UINT_SIZE 20  // Longest decimal text of a size_t
+
+/// Writes an unsigned integer in decimal, two digits at a time. The text is not NUL-terminated.
+/// @param dest Destination, with room for at least TEXT_UINT_SIZE characters.
+/// @param value Value to be written.
+/// @return Number of characters written.
+size_t text_uint(char* dest, size_t value);
+
+/// Writes reservation ids in decimal, each followed by a separator, stopping before the first that does not fit.
+/// @note Runs of free seats (0) are written 8 at a time with vector stores, the text is not NUL-terminated.
+/// @param dest Destination.
+/// @param size Number of characters available.
+/// @param values Values to be written.
+/// @param count Number of values.
+/// @param separator Character written after each value.
+/// @param len Set to the number of characters written.
+/// @return Number of values written.
+size_t text_uints(char* dest, size_t size, const unsigned int* values, size_t count, char separator, size_t* len);
+
+#endif  // SERVER_TEXT_FMT_H
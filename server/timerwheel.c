@@ -0,0 +1,122 @@
+#include "timerwheel.h"
+
+#include <stddef.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+void timer_wheel_init(struct TimerWheel* wheel, uint64_t now) {
+  wheel->now = now;
+  wheel->count = 0;
+
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (unsigned int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      wheel->slots[level][slot].prev = &wheel->slots[level][slot];
+      wheel->slots[level][slot].next = &wheel->slots[level][slot];
+    }
+  }
+}
+
+/// Links a timer into the slot its expiry falls in, relative to the current tick.
+static void place(struct TimerWheel* wheel, struct Timer* timer) {
+  uint64_t delta = timer->expires > wheel->now ? timer->expires - wheel->now : 0;
+  uint64_t expires = timer->expires > wheel->now ? timer->expires : wheel->now;
+
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * (level + 1)))) level++;
+
+  // Past the last level, the timer waits in the farthest slot and is placed again when it cascades
+  if (level == TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))) {
+    expires = wheel->now + (1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+  }
+
+  struct Timer* head = &wheel->slots[level][(expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+/// Unlinks a timer from its slot.
+static void unlink_timer(struct Timer* timer) {
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+}
+
+void timer_wheel_add(struct TimerWheel* wheel, struct Timer* timer, uint64_t delay) {
+  timer->expires = wheel->now + delay;
+  place(wheel, timer);
+  wheel->count++;
+}
+
+void timer_wheel_cancel(struct TimerWheel* wheel, struct Timer* timer) {
+  if (timer->prev == NULL) return;
+
+  unlink_timer(timer);
+  wheel->count--;
+}
+
+int timer_wheel_armed(const struct Timer* timer) { return timer->prev != NULL; }
+
+/// Moves the timers of the current slot of a level down to the levels below.
+/// @return Whether the level wrapped too, so the level above must cascade as well.
+static int cascade(struct TimerWheel* wheel, int level) {
+  unsigned int slot = (unsigned int)(wheel->now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK;
+  struct Timer* head = &wheel->slots[level][slot];
+  if (head->next == head) return slot == 0;
+
+  // Detach the list first, timers are placed again in other slots
+  struct Timer* timer = head->next;
+  head->prev->next = NULL;
+  head->prev = head;
+  head->next = head;
+
+  while (timer != NULL) {
+    struct Timer* next = timer->next;
+    place(wheel, timer);
+    timer = next;
+  }
+
+  return slot == 0;
+}
+
+void timer_wheel_advance(struct TimerWheel* wheel, uint64_t now) {
+  while (wheel->now <= now) {
+    // With nothing armed there is nothing to cascade or fire, so idle periods cost nothing
+    if (wheel->count == 0) {
+      wheel->now = now + 1;
+      return;
+    }
+
+    if ((wheel->now & SLOT_MASK) == 0) {
+      for (int level = 1; level < TIMER_WHEEL_LEVELS && cascade(wheel, level); level++) {
+      }
+    }
+
+    struct Timer* head = &wheel->slots[0][wheel->now & SLOT_MASK];
+    wheel->now++;
+
+    // Callbacks may arm timers, which always land past this slot now that the tick moved on
+    while (head->next != head) {
+      struct Timer* timer = head->next;
+      unlink_timer(timer);
+      wheel->count--;
+      timer->callback(timer);
+    }
+  }
+}
+
+int timer_wheel_timeout(const struct TimerWheel* wheel) {
+  if (wheel->count == 0) return -1;
+
+  for (unsigned int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+    uint64_t tick = wheel->now + i;
+    if (i > 0 && (tick & SLOT_MASK) == 0) return (int)i;
+
+    const struct Timer* head = &wheel->slots[0][tick & SLOT_MASK];
+    if (head->next != head) return (int)i;
+  }
+
+  return TIMER_WHEEL_SLOTS;
+}
@@ -0,0 +1,60 @@
+#ifndef SERVER_TIMER_WHEEL_H
+#define SERVER_TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4  // 64^4 ticks, over 4 hours with 1 ms ticks
+
+/// Timer armed on a wheel, usually embedded in what it times.
+struct Timer {
+  uint64_t expires;                      /// Tick it fires at.
+  void (*callback)(struct Timer* timer);  /// Called once it fires, may arm it again.
+  void* arg;                             /// Owner of the timer, for the callback.
+  struct Timer* prev;                    /// Neighbours in the slot, NULL if the timer is not armed.
+  struct Timer* next;
+};
+
+/// Hierarchical timer wheel: each level has 64 slots, each 64 times coarser than the level below. Timers cascade
+/// down a level whenever the level below wraps, so arming and cancelling are O(1) and a tick only touches one slot.
+/// @note Not thread safe, owned by a single thread.
+struct TimerWheel {
+  uint64_t now;    /// Next tick to be processed.
+  uint64_t count;  /// Number of armed timers.
+  struct Timer slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  /// Sentinels of the circular slot lists.
+};
+
+/// Initializes an empty wheel.
+/// @param wheel Wheel to be initialized.
+/// @param now Current tick.
+void timer_wheel_init(struct TimerWheel* wheel, uint64_t now);
+
+/// Arms a timer that is not armed.
+/// @param wheel Wheel to arm the timer on.
+/// @param timer Timer with its callback set.
+/// @param delay Ticks until it fires, from the next tick to be processed.
+void timer_wheel_add(struct TimerWheel* wheel, struct Timer* timer, uint64_t delay);
+
+/// Disarms a timer, doing nothing if it is not armed.
+/// @param wheel Wheel the timer is armed on.
+/// @param timer Timer to be disarmed.
+void timer_wheel_cancel(struct TimerWheel* wheel, struct Timer* timer);
+
+/// Checks whether a timer is armed.
+/// @param timer Timer to be checked.
+/// @return 1 if it is armed, 0 otherwise.
+int timer_wheel_armed(const struct Timer* timer);
+
+/// Fires every timer due up to a tick.
+/// @param wheel Wheel to advance.
+/// @param now Current tick, every tick up to it is processed.
+void timer_wheel_advance(struct TimerWheel* wheel, uint64_t now);
+
+/// Gets how long the owner may sleep without missing a timer.
+/// @note Exact within the next 64 ticks, otherwise it is the next cascade, when the wheel must be advanced again.
+/// @param wheel Wheel to be checked.
+/// @return Ticks until the wheel must be advanced, -1 if no timer is armed.
+int timer_wheel_timeout(const struct TimerWheel* wheel);
+
+#endif  // SERVER_TIMER_WHEEL_H
@@ -0,0 +1,369 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/api.h"
+#include "common/constants.h"
+#include "common/histogram.h"
+
+#define MAX_CLIENTS 64
+
+enum BenchOp { BENCH_CREATE, BENCH_RESERVE, BENCH_SHOW, BENCH_LIST, BENCH_OPS };
+
+static const char *op_names[BENCH_OPS] = {"CREATE", "RESERVE", "SHOW", "LIST"};
+
+/// Results sent back by every client process.
+struct ClientResult {
+  uint64_t failures[BENCH_OPS];
+  struct Histogram latency[BENCH_OPS];
+};
+
+/// Benchmark configuration.
+struct BenchConfig {
+  const char *server_pipe;  /// Register pipe of the server.
+  unsigned int clients;     /// Number of concurrent sessions.
+  unsigned int ops;         /// Operations issued by each session.
+  unsigned int events;      /// Number of pre-created events.
+  size_t rows;              /// Rows of each pre-created event.
+  size_t cols;              /// Columns of each pre-created event.
+  unsigned int mix[BENCH_OPS];  /// Relative weight of each operation.
+  double zipf;              /// Zipf exponent of the event popularity, 0 for uniform.
+  double conflict;          /// Probability that a reservation targets an already taken seat.
+  uint64_t seed;            /// Seed of the random generators.
+  unsigned int priority;    /// Priority declared by every session.
+};
+
+static struct BenchConfig config = {NULL, 4, 1000, 16, 10, 10, {1, 6, 2, 1}, 1.0, 0.1, 1, PRIORITY_HIGH};
+static pid_t bench_pid;  // Names the pipes, so concurrent runs do not share them
+static struct ClientResult result;
+static double *popularity = NULL;  // Cumulative distribution of the event popularity
+
+/// xorshift64* generator, one state per client so runs are reproducible.
+/// @param state Generator state.
+/// @return Uniform number in [0, 1).
+static double next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (double)((*state * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// Builds the cumulative Zipf distribution over the pre-created events.
+/// @return 0 if the distribution was built successfully, 1 otherwise.
+static int build_popularity() {
+  popularity = malloc(config.events * sizeof(double));
+  if (popularity == NULL) return 1;
+
+  double total = 0;
+  for (unsigned int i = 0; i < config.events; i++) {
+    total += 1.0 / pow((double)(i + 1), config.zipf);
+    popularity[i] = total;
+  }
+  for (unsigned int i = 0; i < config.events; i++) popularity[i] /= total;
+
+  return 0;
+}
+
+/// Picks a pre-created event following the popularity distribution.
+/// @param state Generator state.
+/// @return Id of the event, from 1 to config.events.
+static unsigned int pick_event(uint64_t *state) {
+  double u = next_random(state);
+  unsigned int low = 0, high = config.events - 1;
+
+  while (low < high) {
+    unsigned int mid = low + (high - low) / 2;
+    if (popularity[mid] < u) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low + 1;
+}
+
+/// Picks an operation following the configured mix.
+/// @param state Generator state.
+/// @return Operation to be issued.
+static enum BenchOp pick_op(uint64_t *state) {
+  unsigned int total = 0;
+  for (int i = 0; i < BENCH_OPS; i++) total += config.mix[i];
+
+  double u = next_random(state) * total;
+  for (int i = 0; i < BENCH_OPS; i++) {
+    if (u < config.mix[i]) return (enum BenchOp)i;
+    u -= config.mix[i];
+  }
+
+  return BENCH_RESERVE;
+}
+
+/// Opens a session with pipes named after the client.
+/// @param client Index of the client.
+/// @return 0 if the session was set up successfully, 1 otherwise.
+static int open_session(unsigned int client) {
+  char req_pipe[64], resp_pipe[64];
+  snprintf(req_pipe, sizeof(req_pipe), "../client/bench_req_%d_%u", (int)bench_pid, client);
+  snprintf(resp_pipe, sizeof(resp_pipe), "../client/bench_resp_%d_%u", (int)bench_pid, client);
+  return ems_setup_priority(req_pipe, resp_pipe, config.server_pipe, config.priority);
+}
+
+/// Creates the events every client works on.
+/// @return 0 if every event was created, 1 otherwise.
+static int create_events() {
+  if (open_session(MAX_CLIENTS)) return 1;
+
+  int ret = 0;
+  for (unsigned int i = 1; i <= config.events; i++) {
+    ret |= ems_create(i, config.rows, config.cols);
+  }
+
+  ems_quit();
+  return ret;
+}
+
+/// Body of a client process: issues the configured operation mix.
+/// @param client Index of the client.
+/// @param go_fd Pipe closed by the parent once every client is ready.
+/// @param result_fd Pipe to send the results through.
+/// @return Exit status of the process.
+static int run_client(unsigned int client, int go_fd, int result_fd) {
+  // The API traces every request on stdout
+  int null_fd = open("/dev/null", O_WRONLY);
+  if (null_fd != -1) dup2(null_fd, STDOUT_FILENO);
+
+  for (int i = 0; i < BENCH_OPS; i++) histogram_init(&result.latency[i]);
+  uint64_t state = config.seed * 0x9E3779B97F4A7C15ULL + client + 1;
+  size_t seats = config.rows * config.cols;
+  size_t next_seat = client;
+
+  if (open_session(client)) return 1;
+
+  char go;
+  while (read(go_fd, &go, 1) > 0)
+    ;
+
+  for (unsigned int i = 0; i < config.ops; i++) {
+    enum BenchOp op = pick_op(&state);
+    unsigned int event_id = pick_event(&state);
+    size_t xs[1], ys[1];
+    int ret = 0;
+
+    // Clients walk disjoint seat sequences unless they aim at the hot seat (1,1)
+    size_t seat = 0;
+    if (op == BENCH_RESERVE && next_random(&state) >= config.conflict) {
+      seat = next_seat % seats;
+      next_seat += config.clients;
+    }
+    xs[0] = seat / config.cols + 1;
+    ys[0] = seat % config.cols + 1;
+
+    uint64_t start = now_ns();
+    switch (op) {
+      case BENCH_CREATE:
+        ret = ems_create(1000000 + client * config.ops + i, config.rows, config.cols);
+        break;
+      case BENCH_RESERVE:
+        ret = ems_reserve(event_id, 1, xs, ys);
+        break;
+      case BENCH_SHOW:
+        ret = ems_show(null_fd, event_id);
+        break;
+      case BENCH_LIST:
+        ret = ems_list_events(null_fd);
+        break;
+      case BENCH_OPS:
+        break;
+    }
+    histogram_record(&result.latency[op], now_ns() - start);
+    if (ret != 0) result.failures[op]++;
+  }
+
+  ems_quit();
+
+  const char *data = (const char *)&result;
+  size_t left = sizeof(result);
+  while (left > 0) {
+    ssize_t written = write(result_fd, data, left);
+    if (written == -1) return 1;
+    data += written;
+    left -= (size_t)written;
+  }
+
+  return 0;
+}
+
+/// Reads the results of a client.
+/// @param fd Pipe to read from.
+/// @param client_result Where to store the results.
+/// @return 0 if the whole result was read, 1 otherwise.
+static int read_result(int fd, struct ClientResult *client_result) {
+  char *data = (char *)client_result;
+  size_t left = sizeof(struct ClientResult);
+  while (left > 0) {
+    ssize_t got = read(fd, data, left);
+    if (got <= 0) return 1;
+    data += got;
+    left -= (size_t)got;
+  }
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [-c clients] [-n ops per client] [-e events] [-r rows] [-k cols]\n"
+          "          [-m create:reserve:show:list] [-z zipf exponent] [-x conflict rate] [-s seed] [-p priority]\n"
+          "          <server pipe path>\n",
+          name);
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "c:n:e:r:k:m:z:x:s:p:")) != -1) {
+    switch (opt) {
+      case 'c':
+        config.clients = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'n':
+        config.ops = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'e':
+        config.events = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        config.rows = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        config.cols = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        if (sscanf(optarg, "%u:%u:%u:%u", &config.mix[BENCH_CREATE], &config.mix[BENCH_RESERVE],
+                   &config.mix[BENCH_SHOW], &config.mix[BENCH_LIST]) != 4) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'z':
+        config.zipf = strtod(optarg, NULL);
+        break;
+      case 'x':
+        config.conflict = strtod(optarg, NULL);
+        break;
+      case 's':
+        config.seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'p':
+        config.priority = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind != argc - 1 || config.clients == 0 || config.clients > MAX_CLIENTS || config.events == 0 ||
+      config.rows == 0 || config.cols == 0 || config.priority >= NUM_PRIORITIES) {
+    usage(argv[0]);
+    return 1;
+  }
+  config.server_pipe = argv[optind];
+  bench_pid = getpid();
+
+  if (build_popularity()) {
+    fprintf(stderr, "Failed to allocate the popularity distribution\n");
+    return 1;
+  }
+
+  pid_t setup = fork();
+  if (setup == 0) _exit(create_events());
+
+  int status;
+  if (setup == -1 || waitpid(setup, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Failed to create the benchmark events\n");
+    return 1;
+  }
+
+  int go[2];
+  if (pipe(go) != 0) {
+    fprintf(stderr, "[ERR]: pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int result_fds[MAX_CLIENTS];
+  pid_t pids[MAX_CLIENTS];
+  for (unsigned int i = 0; i < config.clients; i++) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      fprintf(stderr, "[ERR]: pipe failed: %s\n", strerror(errno));
+      return 1;
+    }
+
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      close(go[1]);
+      close(fds[0]);
+      _exit(run_client(i, go[0], fds[1]));
+    }
+
+    close(fds[1]);
+    result_fds[i] = fds[0];
+  }
+
+  // Every client sets up its session before the clock starts
+  sleep(1);
+  uint64_t start = now_ns();
+  close(go[1]);
+
+  struct ClientResult total;
+  memset(&total, 0, sizeof(total));
+  for (unsigned int i = 0; i < config.clients; i++) {
+    struct ClientResult client_result;
+    if (read_result(result_fds[i], &client_result) != 0) {
+      fprintf(stderr, "Client %u did not report its results\n", i);
+    } else {
+      for (int op = 0; op < BENCH_OPS; op++) {
+        total.failures[op] += client_result.failures[op];
+        histogram_merge(&total.latency[op], &client_result.latency[op]);
+      }
+    }
+    close(result_fds[i]);
+    waitpid(pids[i], NULL, 0);
+  }
+  double elapsed = (double)(now_ns() - start) / 1e9;
+
+  uint64_t ops = 0;
+  for (int op = 0; op < BENCH_OPS; op++) ops += total.latency[op].count;
+
+  printf("clients=%u ops=%llu elapsed=%.3fs throughput=%.1f ops/s\n", config.clients, (unsigned long long)ops, elapsed,
+         (double)ops / elapsed);
+  printf("%-8s %10s %9s %12s %10s %10s %10s %10s %10s\n", "op", "count", "failed", "ops/s", "mean_us", "p50_us",
+         "p99_us", "p999_us", "max_us");
+
+  for (int op = 0; op < BENCH_OPS; op++) {
+    struct Histogram *h = &total.latency[op];
+    if (h->count == 0) continue;
+
+    printf("%-8s %10llu %9llu %12.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", op_names[op], (unsigned long long)h->count,
+           (unsigned long long)total.failures[op], (double)h->count / elapsed,
+           (double)h->sum / (double)h->count / 1e3, (double)histogram_percentile(h, 0.50) / 1e3,
+           (double)histogram_percentile(h, 0.99) / 1e3, (double)histogram_percentile(h, 0.999) / 1e3,
+           (double)h->max / 1e3);
+  }
+
+  free(popularity);
+  return 0;
+}
@@ -0,0 +1,341 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/histogram.h"
+#include "server/lockstats.h"
+#include "server/operations.h"
+#include "server/seats.h"
+
+#define MAX_THREADS 256
+#define RENDER_BUFFER_SIZE (1 << 24)  // Fits a shown venue of a million seats
+
+enum BenchOp { BENCH_CREATE, BENCH_RESERVE, BENCH_SHOW, BENCH_LIST };
+
+static const char *op_names[] = {"create", "reserve", "show", "list"};
+
+/// A benchmarked operation and the parameters it is run with.
+struct BenchCase {
+  enum BenchOp op;   /// Operation to be timed.
+  size_t rows;       /// Rows of the events.
+  size_t cols;       /// Columns of the events.
+  size_t seats;      /// Seats per reservation, or reserved per row of a shown venue.
+  double conflict;   /// Fraction of the reservations that hit a taken seat.
+  size_t events;     /// Events present before the run, 0 to size them from the workload.
+  int spread;        /// Seats of a reservation are spread over the whole venue instead of side by side.
+  unsigned int max_ops;  /// Operations per thread at most, whatever -n asks for, 0 for no cap.
+};
+
+static const struct BenchCase cases[] = {
+    {BENCH_CREATE, 10, 10, 0, 0, 0, 0, 0},
+    {BENCH_RESERVE, 32, 32, 1, 0, 0, 0, 0},
+    {BENCH_RESERVE, 32, 32, 4, 0, 0, 0, 0},
+    {BENCH_RESERVE, 32, 32, 16, 0, 0, 0, 0},
+    {BENCH_RESERVE, 32, 32, 4, 0.5, 0, 0, 0},
+    {BENCH_RESERVE, 32, 32, 16, 0, 0, 1, 0},
+    {BENCH_RESERVE, 724, 724, 16, 0, 0, 1, 50},
+    {BENCH_RESERVE, 1000, 1000, 16, 0, 0, 1, 50},
+    {BENCH_SHOW, 10, 10, 10, 0, 1, 0, 0},
+    {BENCH_SHOW, 32, 32, 32, 0, 1, 0, 0},
+    {BENCH_SHOW, 100, 100, 100, 0, 1, 0, 0},
+    {BENCH_SHOW, 724, 724, 724, 0, 1, 0, 0},
+    {BENCH_SHOW, 1000, 1000, 1000, 0, 1, 0, 200},
+    {BENCH_SHOW, 724, 724, 0, 0, 1, 0, 0},
+    {BENCH_SHOW, 1000, 1000, 0, 0, 1, 0, 200},
+    {BENCH_LIST, 1, 1, 0, 0, 10, 0, 0},
+    {BENCH_LIST, 1, 1, 0, 0, 100, 0, 0},
+    {BENCH_LIST, 1, 1, 0, 0, 1000, 0, 0},
+};
+
+/// State of a benchmark thread.
+struct Worker {
+  pthread_t thread;            /// Thread running the worker.
+  unsigned int index;          /// Index of the worker.
+  unsigned int threads;        /// Number of workers in the run.
+  const struct BenchCase *c;   /// Case being run.
+  uint64_t failures;           /// Operations that returned an error.
+  struct Histogram latency;    /// Latency of every operation, in nanoseconds.
+};
+
+static unsigned int ops_per_thread = 2000;
+static size_t reserve_events = 1;  // Events shared by the reservation workload
+static pthread_barrier_t start_barrier;
+
+/// Gets the number of operations each thread runs for a case.
+static unsigned int case_ops(const struct BenchCase *c) {
+  return c->max_ops != 0 && c->max_ops < ops_per_thread ? c->max_ops : ops_per_thread;
+}
+
+static uint64_t now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// xorshift64* generator.
+/// @param state Generator state.
+/// @return Uniform number in [0, 1).
+static double next_random(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (double)((*state * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+static void *run_worker(void *arg) {
+  struct Worker *worker = arg;
+  const struct BenchCase *c = worker->c;
+  uint64_t state = 0x9E3779B97F4A7C15ULL * (worker->index + 1);
+  size_t xs[64], ys[64];
+
+  char *buffer = malloc(RENDER_BUFFER_SIZE);
+  if (buffer == NULL) {
+    fprintf(stderr, "Failed to allocate render buffer\n");
+    return NULL;
+  }
+
+  pthread_barrier_wait(&start_barrier);
+
+  for (unsigned int i = 0; i < case_ops(c); i++) {
+    unsigned int event_id = 1;
+    int ret = 0;
+
+    if (c->op == BENCH_RESERVE) {
+      // Workers take disjoint slots of c->seats seats, seat 0 of every event is taken beforehand
+      event_id = (unsigned int)(i % reserve_events) + 1;
+      size_t slot = (i / reserve_events) * worker->threads + worker->index;
+      size_t stride = (c->rows * c->cols - 1) / c->seats;
+      for (size_t j = 0; j < c->seats; j++) {
+        size_t seat = c->spread ? j * stride + slot + 1 : slot * c->seats + j + 1;
+        xs[j] = seat / c->cols + 1;
+        ys[j] = seat % c->cols + 1;
+      }
+      if (c->conflict > 0 && next_random(&state) < c->conflict) {
+        xs[c->seats - 1] = 1;
+        ys[c->seats - 1] = 1;
+      }
+    }
+
+    uint64_t start = now_ns();
+    switch (c->op) {
+      case BENCH_CREATE:
+        ret = ems_create(i * worker->threads + worker->index + 1, c->rows, c->cols);
+        break;
+      case BENCH_RESERVE:
+        ret = ems_reserve(event_id, c->seats, xs, ys);
+        break;
+      case BENCH_SHOW:
+        ret = ems_show(STDOUT_FILENO, event_id, buffer, RENDER_BUFFER_SIZE);
+        break;
+      case BENCH_LIST:
+        ret = ems_list_events(STDOUT_FILENO, buffer, RENDER_BUFFER_SIZE);
+        break;
+    }
+    histogram_record(&worker->latency, now_ns() - start);
+    if (ret != 0) worker->failures++;
+  }
+
+  free(buffer);
+  return NULL;
+}
+
+/// Creates the events a case works on.
+/// @param c Case to be set up.
+/// @param max_threads Largest number of threads the case is run with.
+/// @return 0 if the state was set up successfully, 1 otherwise.
+static int setup_case(const struct BenchCase *c, unsigned int max_threads) {
+  size_t events = c->events;
+
+  if (c->op == BENCH_RESERVE) {
+    // Every round of an event gives each thread its own slot, sized for the largest run so that
+    // the contention per event is the same for every thread count
+    size_t rounds = (c->rows * c->cols - 1) / c->seats / max_threads;
+    if (rounds == 0) return 1;
+    events = (case_ops(c) + rounds - 1) / rounds;
+    reserve_events = events;
+  }
+
+  for (size_t i = 1; i <= events; i++) {
+    if (ems_create((unsigned int)i, c->rows, c->cols)) return 1;
+
+    size_t x = 1, y = 1;
+    if (c->op == BENCH_RESERVE && ems_reserve((unsigned int)i, 1, &x, &y)) return 1;
+  }
+
+  // Shown venues hold a reservation per row, so full rows render every id and empty ones the free seats. Rows are
+  // taken as best blocks, which do not scan the venue, so large venues are set up quickly
+  if (c->op == BENCH_SHOW && c->seats > 0) {
+    size_t row, col;
+    for (size_t i = 0; i < c->rows; i++) {
+      if (ems_reserve_best(1, c->seats, &row, &col)) return 1;
+    }
+  }
+
+  return 0;
+}
+
+/// Formats the parameters of a case.
+static void describe_case(const struct BenchCase *c, char *buffer, size_t size) {
+  switch (c->op) {
+    case BENCH_CREATE:
+      snprintf(buffer, size, "venue=%zux%zu", c->rows, c->cols);
+      break;
+    case BENCH_RESERVE:
+      if (c->spread) {
+        snprintf(buffer, size, "venue=%zux%zu seats=%zu spread", c->rows, c->cols, c->seats);
+      } else {
+        snprintf(buffer, size, "seats=%zu conflict=%.2f", c->seats, c->conflict);
+      }
+      break;
+    case BENCH_SHOW:
+      snprintf(buffer, size, "venue=%zux%zu%s", c->rows, c->cols, c->seats == 0 ? " empty" : "");
+      break;
+    case BENCH_LIST:
+      snprintf(buffer, size, "events=%zu", c->events);
+      break;
+  }
+}
+
+/// Runs a case with the given number of threads and prints one result row.
+/// @return 0 if the case ran successfully, 1 otherwise.
+static int run_case(const struct BenchCase *c, unsigned int threads, unsigned int max_threads, int json, int first) {
+  static struct Worker workers[MAX_THREADS];
+
+  if (ems_init(0) || setup_case(c, max_threads)) {
+    fprintf(stderr, "Failed to set up %s\n", op_names[c->op]);
+    return 1;
+  }
+
+  pthread_barrier_init(&start_barrier, NULL, threads + 1);
+  for (unsigned int i = 0; i < threads; i++) {
+    workers[i].index = i;
+    workers[i].threads = threads;
+    workers[i].c = c;
+    workers[i].failures = 0;
+    histogram_init(&workers[i].latency);
+    if (pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]) != 0) {
+      fprintf(stderr, "Failed to create thread\n");
+      return 1;
+    }
+  }
+
+  // The workers cannot start before this thread reaches the barrier
+  uint64_t start = now_ns();
+  pthread_barrier_wait(&start_barrier);
+
+  static struct Histogram total;
+  histogram_init(&total);
+  uint64_t failures = 0;
+  for (unsigned int i = 0; i < threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+    histogram_merge(&total, &workers[i].latency);
+    failures += workers[i].failures;
+  }
+  double seconds = (double)(now_ns() - start) / 1e9;
+
+  pthread_barrier_destroy(&start_barrier);
+  ems_terminate();
+
+  char params[64];
+  describe_case(c, params, sizeof(params));
+  double mean = total.count == 0 ? 0 : (double)total.sum / (double)total.count;
+
+  if (json) {
+    printf("%s  {\"op\": \"%s\", \"params\": \"%s\", \"threads\": %u, \"ops\": %llu, \"failures\": %llu, "
+           "\"seconds\": %.6f, \"ops_per_sec\": %.1f, \"mean_ns\": %.1f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+           "\"p999_ns\": %llu, \"max_ns\": %llu}",
+           first ? "" : ",\n", op_names[c->op], params, threads, (unsigned long long)total.count,
+           (unsigned long long)failures, seconds, (double)total.count / seconds, mean,
+           (unsigned long long)histogram_percentile(&total, 0.50), (unsigned long long)histogram_percentile(&total, 0.99),
+           (unsigned long long)histogram_percentile(&total, 0.999), (unsigned long long)total.max);
+  } else {
+    printf("%s,%s,%u,%llu,%llu,%.6f,%.1f,%.1f,%llu,%llu,%llu,%llu\n", op_names[c->op], params, threads,
+           (unsigned long long)total.count, (unsigned long long)failures, seconds, (double)total.count / seconds, mean,
+           (unsigned long long)histogram_percentile(&total, 0.50), (unsigned long long)histogram_percentile(&total, 0.99),
+           (unsigned long long)histogram_percentile(&total, 0.999), (unsigned long long)total.max);
+  }
+  fflush(stdout);
+
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [-t max threads] [-n ops per thread] [-o create|reserve|show|list] [-j] [-s] [-v]\n"
+          "Runs every case with 1, 2, 4, ... up to max threads and prints CSV, or JSON with -j.\n"
+          "Large venues are backed by huge pages when the system has them, by regular pages only with -s.\n"
+          "Errors of the operations themselves, and the lock stats, are only shown with -v.\n",
+          name);
+}
+
+int main(int argc, char *argv[]) {
+  unsigned int max_threads = 4;
+  const char *only = NULL;
+  int json = 0, verbose = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:o:jsv")) != -1) {
+    switch (opt) {
+      case 't':
+        max_threads = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'n':
+        ops_per_thread = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'o':
+        only = optarg;
+        break;
+      case 'j':
+        json = 1;
+        break;
+      case 's':
+        seat_map_use_huge_pages(0);
+        break;
+      case 'v':
+        verbose = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind != argc || max_threads == 0 || max_threads > MAX_THREADS || ops_per_thread == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Conflicting reservations log every failure, which would dominate their latency
+  if (!verbose) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd != -1) dup2(null_fd, STDERR_FILENO);
+  }
+
+  if (json) {
+    printf("[\n");
+  } else {
+    printf("op,params,threads,ops,failures,seconds,ops_per_sec,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n");
+  }
+
+  int first = 1;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    if (only != NULL && strcmp(only, op_names[cases[i].op]) != 0) continue;
+
+    for (unsigned int threads = 1;; threads = threads * 2 > max_threads ? max_threads : threads * 2) {
+      if (run_case(&cases[i], threads, max_threads, json, first)) return 1;
+      first = 0;
+      if (threads == max_threads) break;
+    }
+  }
+
+  if (json) printf("\n]\n");
+
+  // Only does something when built with LOCK_STATS
+  if (verbose) lock_stats_dump(STDERR_FILENO);
+  return 0;
+}
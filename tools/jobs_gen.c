@@ -0,0 +1,434 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HOT_EVENT_ID 1      // Shared by every job file to create contention
+#define MISSING_EVENT_ID 0  // Never created, used to exercise failures
+#define SHOW_MAX 1013       // Longest reply body the server sends for SHOW and LIST
+#define OUT_BUFFER_SIZE (1 << 20)
+
+enum GenOp { GEN_CREATE, GEN_RESERVE, GEN_SHOW, GEN_LIST, GEN_AVAILABILITY, GEN_FORK, GEN_OPS };
+
+/// Model of an event, mirroring the state kept by the server.
+struct GenEvent {
+  unsigned int id;            /// Event id.
+  unsigned int reservations;  /// Last reservation id handed out.
+  size_t rows;                /// Number of rows.
+  size_t cols;                /// Number of columns.
+  size_t free_seats;          /// Number of seats not reserved.
+  unsigned int *seats;        /// rows * cols reservation ids, 0 for free seats.
+};
+
+/// Generator configuration.
+struct GenConfig {
+  const char *prefix;         /// Path prefix of the generated files.
+  unsigned int files;         /// Number of job files, one per concurrent client.
+  unsigned long lines;        /// Commands per job file.
+  unsigned int events;        /// Events created by each file before the workload.
+  unsigned int max_events;    /// Events per file after which CREATE only hits existing ids.
+  size_t rows;                /// Largest number of rows of a venue.
+  size_t cols;                /// Largest number of columns of a venue.
+  size_t max_seats;           /// Largest number of seats of a RESERVE.
+  unsigned int mix[GEN_OPS];  /// Relative weight of each command.
+  double hot;                 /// Fraction of the reservations aimed at the shared hot event.
+  double wait;                /// Probability of a WAIT after each command.
+  unsigned int max_delay;     /// Largest WAIT delay.
+  double barrier;             /// Probability of a BARRIER after each command.
+  uint64_t seed;              /// Seed of the random generator.
+};
+
+static struct GenConfig config = {NULL, 1, 1000, 8, 1024, 10, 10, 4, {1, 10, 4, 1, 2, 1}, 0.1, 0, 0, 0, 1};
+
+/// State of the job file being generated.
+struct GenFile {
+  unsigned int index;         /// Index of the file.
+  uint64_t rng;               /// Random generator state.
+  FILE *jobs;                 /// Commands.
+  FILE *out;                  /// Expected output of the client.
+  struct GenEvent *events;    /// Events known to this file, in creation order.
+  size_t num_events;          /// Number of known events.
+  size_t capacity;            /// Allocated size of events.
+  unsigned int next_id;       /// Next id of a private event.
+};
+
+/// xorshift64* generator.
+/// @param state Generator state.
+/// @return Uniform number in [0, 2^64).
+static uint64_t next_u64(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/// @return Uniform number in [0, 1).
+static double next_double(uint64_t *state) { return (double)(next_u64(state) >> 11) / 9007199254740992.0; }
+
+/// @return Uniform number in [1, max].
+static size_t next_between(uint64_t *state, size_t max) { return (size_t)(next_u64(state) % max) + 1; }
+
+static size_t digits(size_t value) {
+  size_t count = 1;
+  while (value >= 10) {
+    value /= 10;
+    count++;
+  }
+  return count;
+}
+
+/// Makes room for one more event in the model.
+/// @return 0 if there is room, 1 on allocation failure.
+static int grow_events(struct GenFile *file) {
+  if (file->num_events < file->capacity) return 0;
+
+  size_t capacity = file->capacity == 0 ? 16 : file->capacity * 2;
+  struct GenEvent *events = realloc(file->events, capacity * sizeof(struct GenEvent));
+  if (events == NULL) return 1;
+
+  file->events = events;
+  file->capacity = capacity;
+  return 0;
+}
+
+/// Adds an event to the model.
+/// @param from Event whose seats are copied, NULL for an empty venue.
+/// @return 0 if the event was added, 1 on allocation failure.
+static int add_event(struct GenFile *file, unsigned int id, size_t rows, size_t cols, const struct GenEvent *from) {
+  if (grow_events(file)) return 1;
+
+  struct GenEvent *event = &file->events[file->num_events];
+  event->seats = calloc(rows * cols, sizeof(unsigned int));
+  if (event->seats == NULL) return 1;
+
+  event->id = id;
+  event->rows = rows;
+  event->cols = cols;
+  event->reservations = 0;
+  event->free_seats = rows * cols;
+  if (from != NULL) {
+    memcpy(event->seats, from->seats, rows * cols * sizeof(unsigned int));
+    event->reservations = from->reservations;
+    event->free_seats = from->free_seats;
+  }
+
+  file->num_events++;
+  return 0;
+}
+
+/// Picks an event this file may query. The hot event is shared with the
+/// other files, so its state is only predictable when there is a single file.
+/// @return The event, NULL if there is none.
+static struct GenEvent *pick_event(struct GenFile *file) {
+  size_t first = config.files > 1 ? 1 : 0;
+  if (file->num_events <= first) return NULL;
+  return &file->events[first + next_u64(&file->rng) % (file->num_events - first)];
+}
+
+static int gen_create(struct GenFile *file) {
+  size_t rows = next_between(&file->rng, config.rows);
+  size_t cols = next_between(&file->rng, config.cols);
+
+  // Once the file owns enough events, CREATE keeps exercising the duplicate check
+  if (file->num_events > config.max_events) {
+    struct GenEvent *event = pick_event(file);
+    fprintf(file->jobs, "CREATE %u %zu %zu\n", event == NULL ? HOT_EVENT_ID : event->id, rows, cols);
+    return 0;
+  }
+
+  unsigned int id = file->next_id;
+  file->next_id += config.files;
+  fprintf(file->jobs, "CREATE %u %zu %zu\n", id, rows, cols);
+  return add_event(file, id, rows, cols, NULL);
+}
+
+static void gen_reserve(struct GenFile *file) {
+  int hot = next_double(&file->rng) < config.hot;
+  struct GenEvent *event = hot ? &file->events[0] : pick_event(file);
+  if (event == NULL) event = &file->events[0];
+
+  size_t num_seats = next_between(&file->rng, config.max_seats);
+  size_t xs[64], ys[64];
+  if (num_seats > sizeof(xs) / sizeof(xs[0])) num_seats = sizeof(xs) / sizeof(xs[0]);
+
+  int valid = 1;
+  fprintf(file->jobs, "RESERVE %u [", event->id);
+  for (size_t i = 0; i < num_seats; i++) {
+    if (hot) {
+      // Every file fights over the first seats of the hot event
+      xs[i] = 1;
+      ys[i] = next_between(&file->rng, event->cols < 4 ? event->cols : 4);
+    } else {
+      xs[i] = next_between(&file->rng, event->rows);
+      ys[i] = next_between(&file->rng, event->cols);
+      if (next_double(&file->rng) < 0.01) xs[i] = event->rows + 1;
+    }
+
+    if (xs[i] > event->rows || event->seats[(xs[i] - 1) * event->cols + ys[i] - 1] != 0) valid = 0;
+    fprintf(file->jobs, "%s(%zu,%zu)", i == 0 ? "" : " ", xs[i], ys[i]);
+  }
+  fprintf(file->jobs, "]\n");
+
+  if (!valid) return;
+
+  // Seats listed twice are taken once, like the server does
+  unsigned int reservation_id = ++event->reservations;
+  for (size_t i = 0; i < num_seats; i++) {
+    unsigned int *seat = &event->seats[(xs[i] - 1) * event->cols + ys[i] - 1];
+    if (*seat == reservation_id) continue;
+    *seat = reservation_id;
+    event->free_seats--;
+  }
+}
+
+static void gen_show(struct GenFile *file) {
+  struct GenEvent *event = next_double(&file->rng) < 0.02 ? NULL : pick_event(file);
+  if (event == NULL) {
+    fprintf(file->jobs, "SHOW %u\n", MISSING_EVENT_ID);
+    fprintf(file->out, "1|\n");
+    return;
+  }
+
+  fprintf(file->jobs, "SHOW %u\n", event->id);
+
+  size_t seats = event->rows * event->cols;
+  size_t len = digits(event->rows) + digits(event->cols) + 2;
+  for (size_t i = 0; i < seats && len <= SHOW_MAX; i++) len += digits(event->seats[i]) + 1;
+
+  if (len > SHOW_MAX) {
+    fprintf(file->out, "1|\n");
+    return;
+  }
+
+  fprintf(file->out, "0|%zu|%zu|", event->rows, event->cols);
+  for (size_t i = 0; i < seats; i++) fprintf(file->out, "%u ", event->seats[i]);
+  fprintf(file->out, "\n");
+}
+
+static void gen_list(struct GenFile *file) {
+  // Every file shares the event list, so it is only predictable with a single file
+  if (config.files > 1) {
+    gen_show(file);
+    return;
+  }
+
+  fprintf(file->jobs, "LIST\n");
+
+  size_t len = digits(file->num_events) + 1;
+  for (size_t i = 0; i < file->num_events && len <= SHOW_MAX; i++) len += digits(file->events[i].id) + 1;
+
+  if (len > SHOW_MAX) {
+    fprintf(file->out, "1|\n");
+    return;
+  }
+
+  fprintf(file->out, "0|%zu|", file->num_events);
+  for (size_t i = 0; i < file->num_events; i++) fprintf(file->out, "%u ", file->events[i].id);
+  fprintf(file->out, "\n");
+}
+
+static void gen_availability(struct GenFile *file) {
+  struct GenEvent *event = pick_event(file);
+  if (event == NULL) {
+    gen_show(file);
+    return;
+  }
+
+  if (next_double(&file->rng) < 0.3) {
+    fprintf(file->jobs, "SOLD_OUT %u\n", event->id);
+    fprintf(file->out, event->free_seats == 0 ? "Sold out\n" : "Available\n");
+    return;
+  }
+
+  if (next_double(&file->rng) < 0.5) {
+    fprintf(file->jobs, "AVAILABILITY %u\n", event->id);
+    fprintf(file->out, "%zu/%zu\n", event->free_seats, event->rows * event->cols);
+    return;
+  }
+
+  size_t row = next_between(&file->rng, event->rows);
+  size_t free_seats = 0;
+  for (size_t col = 0; col < event->cols; col++) free_seats += event->seats[(row - 1) * event->cols + col] == 0;
+
+  fprintf(file->jobs, "AVAILABILITY %u %zu\n", event->id, row);
+  fprintf(file->out, "%zu/%zu\n", free_seats, event->cols);
+}
+
+static int gen_fork(struct GenFile *file) {
+  // Grow first so the source event does not move while being copied
+  if (grow_events(file)) return 1;
+
+  struct GenEvent *event = pick_event(file);
+  if (event == NULL || file->num_events > config.max_events) {
+    gen_show(file);
+    return 0;
+  }
+
+  unsigned int id = file->next_id;
+  file->next_id += config.files;
+  fprintf(file->jobs, "FORK %u %u\n", event->id, id);
+  return add_event(file, id, event->rows, event->cols, event);
+}
+
+/// Picks a command following the configured mix.
+static enum GenOp pick_op(struct GenFile *file) {
+  unsigned int total = 0;
+  for (int i = 0; i < GEN_OPS; i++) total += config.mix[i];
+
+  double u = next_double(&file->rng) * total;
+  for (int i = 0; i < GEN_OPS; i++) {
+    if (u < config.mix[i]) return (enum GenOp)i;
+    u -= config.mix[i];
+  }
+
+  return GEN_RESERVE;
+}
+
+/// Generates a job file and its expected output.
+/// @param file File to be generated, with its streams open.
+/// @return 0 if the file was generated, 1 on allocation failure.
+static int generate(struct GenFile *file) {
+  // Every file creates the hot event, only the first CREATE to reach the server succeeds
+  fprintf(file->jobs, "CREATE %u %zu %zu\n", HOT_EVENT_ID, config.rows, config.cols);
+  if (add_event(file, HOT_EVENT_ID, config.rows, config.cols, NULL)) return 1;
+
+  for (unsigned int i = 0; i < config.events; i++) {
+    if (gen_create(file)) return 1;
+  }
+
+  for (unsigned long line = 0; line < config.lines; line++) {
+    int ret = 0;
+
+    switch (pick_op(file)) {
+      case GEN_CREATE:
+        ret = gen_create(file);
+        break;
+      case GEN_RESERVE:
+        gen_reserve(file);
+        break;
+      case GEN_SHOW:
+        gen_show(file);
+        break;
+      case GEN_LIST:
+        gen_list(file);
+        break;
+      case GEN_AVAILABILITY:
+        gen_availability(file);
+        break;
+      case GEN_FORK:
+        ret = gen_fork(file);
+        break;
+      case GEN_OPS:
+        break;
+    }
+    if (ret != 0) return 1;
+
+    if (config.wait > 0 && next_double(&file->rng) < config.wait) {
+      fprintf(file->jobs, "WAIT %llu\n",
+              config.max_delay == 0 ? 0ULL : (unsigned long long)next_between(&file->rng, config.max_delay));
+    }
+    if (config.barrier > 0 && next_double(&file->rng) < config.barrier) fprintf(file->jobs, "BARRIER\n");
+  }
+
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [-f files] [-l lines per file] [-e initial events] [-E max events] [-r rows] [-k cols]\n"
+          "          [-n max seats per reserve] [-m create:reserve:show:list:availability:fork] [-x hot rate]\n"
+          "          [-w wait rate] [-W max wait delay] [-b barrier rate] [-s seed] <output prefix>\n"
+          "Writes <prefix>_<i>.jobs and the output the client must produce, <prefix>_<i>.expected.out\n",
+          name);
+}
+
+int main(int argc, char *argv[]) {
+  int opt;
+  while ((opt = getopt(argc, argv, "f:l:e:E:r:k:n:m:x:w:W:b:s:")) != -1) {
+    switch (opt) {
+      case 'f':
+        config.files = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'l':
+        config.lines = strtoul(optarg, NULL, 10);
+        break;
+      case 'e':
+        config.events = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'E':
+        config.max_events = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        config.rows = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        config.cols = strtoul(optarg, NULL, 10);
+        break;
+      case 'n':
+        config.max_seats = strtoul(optarg, NULL, 10);
+        break;
+      case 'm':
+        if (sscanf(optarg, "%u:%u:%u:%u:%u:%u", &config.mix[GEN_CREATE], &config.mix[GEN_RESERVE],
+                   &config.mix[GEN_SHOW], &config.mix[GEN_LIST], &config.mix[GEN_AVAILABILITY],
+                   &config.mix[GEN_FORK]) != 6) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'x':
+        config.hot = strtod(optarg, NULL);
+        break;
+      case 'w':
+        config.wait = strtod(optarg, NULL);
+        break;
+      case 'W':
+        config.max_delay = (unsigned int)strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        config.barrier = strtod(optarg, NULL);
+        break;
+      case 's':
+        config.seed = strtoull(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind != argc - 1 || config.files == 0 || config.rows == 0 || config.cols == 0 || config.max_seats == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+  config.prefix = argv[optind];
+
+  for (unsigned int i = 0; i < config.files; i++) {
+    char jobs_path[512], out_path[512];
+    snprintf(jobs_path, sizeof(jobs_path), "%s_%u.jobs", config.prefix, i);
+    snprintf(out_path, sizeof(out_path), "%s_%u.expected.out", config.prefix, i);
+
+    struct GenFile file = {i, config.seed * 0x9E3779B97F4A7C15ULL + i + 1, NULL, NULL, NULL, 0, 0, 2 + i};
+    file.jobs = fopen(jobs_path, "w");
+    file.out = fopen(out_path, "w");
+    if (file.jobs == NULL || file.out == NULL) {
+      fprintf(stderr, "Failed to open output files. Path: %s\n", jobs_path);
+      return 1;
+    }
+    setvbuf(file.jobs, NULL, _IOFBF, OUT_BUFFER_SIZE);
+    setvbuf(file.out, NULL, _IOFBF, OUT_BUFFER_SIZE);
+
+    int ret = generate(&file);
+
+    for (size_t j = 0; j < file.num_events; j++) free(file.events[j].seats);
+    free(file.events);
+    if (fclose(file.jobs) != 0 || fclose(file.out) != 0) ret = 1;
+
+    if (ret != 0) {
+      fprintf(stderr, "Failed to generate %s\n", jobs_path);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/trace.h"
+
+/// Spans of a thread that are still open while its records are read.
+struct ThreadState {
+  int in_request;          /// Whether a worker started a request it did not reply to yet.
+  uint64_t request_start;  /// When the worker started it.
+  uint64_t request_queued; /// Time it waited in its queue.
+  int in_lookup;           /// Whether a lookup started and did not end yet.
+  uint64_t lookup_start;   /// When the lookup started.
+  int sending;             /// Whether the client sent a request it did not get the reply to yet.
+  uint64_t send_start;     /// When the request was sent.
+  unsigned int send_code;  /// Operation code of the request.
+};
+
+static struct ThreadState *threads = NULL;
+static size_t num_threads = 0;
+static int first_event = 1;
+
+/// Gets the name of an operation from its code on the wire.
+static const char *op_name(unsigned int code) {
+  static const char *names[] = {"CREATE", "RESERVE",  "SHOW",         "LIST",     "SUBSCRIBE", "RESERVE_BEST", "TEMPLATE",
+                                "CREATE_BULK", "FORK", "LIST_PAGE", "AVAILABILITY", "SOLD_OUT", "STATS", "WAIT", "HOLD", "CONFIRM",
+                                "RELEASE", "GET_RESERVATION", "CANCEL", "RESERVE_MULTI"};
+  if (code < 3 || code - 3 >= sizeof(names) / sizeof(names[0])) return "OTHER";
+  return names[code - 3];
+}
+
+/// Gets the state of a thread, growing the table if needed.
+/// @return State of the thread, NULL on allocation failure.
+static struct ThreadState *thread_state(uint32_t thread) {
+  if (thread >= num_threads) {
+    size_t size = (size_t)thread + 1;
+    struct ThreadState *grown = realloc(threads, size * sizeof(struct ThreadState));
+    if (grown == NULL) return NULL;
+
+    memset(grown + num_threads, 0, (size - num_threads) * sizeof(struct ThreadState));
+    threads = grown;
+    num_threads = size;
+  }
+
+  return &threads[thread];
+}
+
+/// Starts a Chrome trace event, leaving the object open for its args.
+static void begin_event(const char *name, const char *category, const char *phase, uint32_t pid, uint32_t thread,
+                        uint64_t timestamp) {
+  printf("%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"pid\":%u,\"tid\":%u,\"ts\":%llu.%03u", first_event ? "" : ",",
+         name, category, phase, pid, thread, (unsigned long long)(timestamp / 1000), (unsigned int)(timestamp % 1000));
+  first_event = 0;
+}
+
+/// Writes a complete event, a span with a duration.
+static void span(const char *name, const char *category, uint32_t pid, uint32_t thread, uint64_t start, uint64_t end) {
+  begin_event(name, category, "X", pid, thread, start);
+  printf(",\"dur\":%llu.%03u", (unsigned long long)((end - start) / 1000), (unsigned int)((end - start) % 1000));
+}
+
+/// Writes an instant event, scoped to its thread.
+static void instant(const char *name, const char *category, uint32_t pid, uint32_t thread, uint64_t timestamp) {
+  begin_event(name, category, "i", pid, thread, timestamp);
+  printf(",\"s\":\"t\"");
+}
+
+/// Converts a record, pairing it with the earlier records of its thread.
+static void convert(const struct TraceRecord *record, uint32_t pid) {
+  struct ThreadState *state = thread_state(record->thread);
+  if (state == NULL) return;
+
+  switch ((enum TraceType)record->type) {
+    case TRACE_SESSION:
+      instant("session", "session", pid, record->thread, record->timestamp);
+      printf(",\"args\":{\"session\":%llu}}", (unsigned long long)record->arg);
+      break;
+
+    case TRACE_REQUEST:
+      state->in_request = 1;
+      state->request_start = record->timestamp;
+      state->request_queued = record->arg;
+      break;
+
+    case TRACE_REPLY:
+      if (!state->in_request) break;
+      span(op_name(record->code), "server", pid, record->thread, state->request_start, record->timestamp);
+      printf(",\"args\":{\"queued_ns\":%llu,\"ret\":%d}}", (unsigned long long)state->request_queued,
+             (int)record->arg);
+      state->in_request = 0;
+      break;
+
+    case TRACE_LOOKUP_BEGIN:
+      state->in_lookup = 1;
+      state->lookup_start = record->timestamp;
+      break;
+
+    case TRACE_LOOKUP_END:
+      if (!state->in_lookup) break;
+      span("lookup", "server", pid, record->thread, state->lookup_start, record->timestamp);
+      printf(",\"args\":{\"event\":%llu,\"found\":%u}}", (unsigned long long)record->arg, record->code);
+      state->in_lookup = 0;
+      break;
+
+    case TRACE_LOCK:
+      instant(record->code ? "lock event" : "lock list", "server", pid, record->thread, record->timestamp);
+      printf(",\"args\":{\"event\":%llu}}", (unsigned long long)record->arg);
+      break;
+
+    case TRACE_SEND:
+      state->sending = 1;
+      state->send_start = record->timestamp;
+      state->send_code = record->code;
+      break;
+
+    case TRACE_RECEIVE:
+      if (!state->sending) break;
+      span(op_name(state->send_code), "client", pid, record->thread, state->send_start, record->timestamp);
+      printf(",\"args\":{\"ret\":%d}}", (int)record->arg);
+      state->sending = 0;
+      break;
+
+    case TRACE_DROPPED:
+      instant("dropped", "trace", pid, record->thread, record->timestamp);
+      printf(",\"args\":{\"records\":%llu}}", (unsigned long long)record->arg);
+      break;
+
+    case NUM_TRACE_TYPES:
+    default:
+      break;
+  }
+}
+
+/// Converts a trace file.
+/// @param path Path of the file.
+/// @return 0 if the file was converted, 1 otherwise.
+static int convert_file(const char *path) {
+  FILE *in = fopen(path, "rb");
+  if (in == NULL) {
+    perror(path);
+    return 1;
+  }
+
+  struct TraceHeader header;
+  if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != TRACE_VERSION) {
+    fprintf(stderr, "%s: not a trace file\n", path);
+    fclose(in);
+    return 1;
+  }
+
+  // Thread numbers restart in every process
+  memset(threads, 0, num_threads * sizeof(struct ThreadState));
+
+  begin_event("process_name", "", "M", header.pid, 0, 0);
+  printf(",\"args\":{\"name\":\"%s\"}}", path);
+
+  struct TraceRecord record;
+  while (fread(&record, sizeof(record), 1, in) == 1) convert(&record, header.pid);
+
+  fclose(in);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr,
+            "Usage: %s <trace file>...\n"
+            "Writes the trace files of a run (EMS_TRACE=<prefix>, one file per process) as Chrome trace JSON\n",
+            argv[0]);
+    return 1;
+  }
+
+  int ret = 0;
+  printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (int i = 1; i < argc; i++) ret |= convert_file(argv[i]);
+  printf("\n]}\n");
+
+  free(threads);
+  return ret;
+}